@@ -454,6 +454,16 @@ selftest_pass() {
     test_yaml_regexp "/tests/0/skip-reason" '.*skip.*'
 }
 
+@test "selftest_skip_init_per_thread" {
+    declare -A yamldump
+    sandstone_selftest -e selftest_skip_init_per_thread
+    [[ "$status" -eq 0 ]]
+    test_yaml_regexp "/exit" pass
+    test_yaml_regexp "/tests/0/test" selftest_skip_init_per_thread
+    test_yaml_regexp "/tests/0/result" skip
+    test_yaml_regexp "/tests/0/skip-category" Runtime
+}
+
 @test "selftest_skip_cleanup" {
     declare -A yamldump
     sandstone_selftest -e selftest_skip_cleanup
@@ -583,6 +593,16 @@ selftest_log_skip_init_socket_common() {
     test_yaml_numeric "/tests/0/test-runtime" 'value >= 250'
 }
 
+@test "selftest_timedpass --oversubscribe" {
+    declare -A yamldump
+    sandstone_selftest -vv -e selftest_timedpass -t 250 --oversubscribe=3
+    [[ "$status" -eq 0 ]]
+    test_yaml_regexp "/exit" pass
+    test_yaml_regexp "/tests/0/result" pass
+    test_yaml_regexp "/tests/0/threads/0/thread" main
+    test_yaml_regexp "/tests/0/threads/0/messages/0/text" 'I> Oversubscribed: 3 threads per CPU, .* context switches/s.*'
+}
+
 @test "selftest_timedpass -t 1150" {
     # With over 800 ms, we should see fracturing
     declare -A yamldump
@@ -1086,6 +1106,18 @@ test_list_file_ignores_beta() {
     test_yaml_regexp "/tests/0/threads/0/messages/$i/text" 'E> Init function failed.*'
 }
 
+@test "selftest_failinit_per_thread" {
+    declare -A yamldump
+    sandstone_selftest -vvv -e selftest_failinit_per_thread
+    [[ "$status" -eq 1 ]]
+    test_yaml_regexp "/exit" fail
+    test_yaml_regexp "/tests/0/result" fail
+    test_yaml_regexp "/tests/0/threads/$MAX_PROC/state" failed
+    i=$((-1 + yamldump[/tests/0/threads/$MAX_PROC/messages@len]))
+    test_yaml_regexp "/tests/0/threads/$MAX_PROC/messages/$i/level" error
+    test_yaml_regexp "/tests/0/threads/$MAX_PROC/messages/$i/text" 'E> Per-thread init function failed.*'
+}
+
 @test "selftest_logerror_init" {
     declare -A yamldump
     sandstone_selftest -e selftest_logerror_init
@@ -34,6 +34,10 @@
 #define _tile_dpbssd(dst,src1,src2)                                     \
       _tile_int8_dp_internal (tdpbssd, dst, src1, src2)
 
+#define _tile_dpbf16ps(dst,src1,src2)                                   \
+  __asm__ volatile                                                      \
+  ("{tdpbf16ps\t%%tmm"#src2", %%tmm"#src1", %%tmm"#dst"|tdpbf16ps\t%%tmm"#dst", %%tmm"#src1", %%tmm"#src2"}" ::)
+
 #define _tile_loadd(dst,base,stride)                                    \
   __asm__ volatile                                                      \
   ("{tileloadd\t(%0,%1,1), %%tmm"#dst"|tileloadd\t%%tmm"#dst", [%0+%1*1]}" \
@@ -6,7 +6,14 @@
 #ifndef FREQUENCY_MANAGER_HPP
 #define FREQUENCY_MANAGER_HPP
 
-#include <unordered_set>
+#include <algorithm>
+#include <vector>
+
+#include <fcntl.h>
+#include <math.h>
+#include <pthread.h>
+#include <unistd.h>
+
 #define BASE_CORE_FREQ_PATH    "/sys/devices/system/cpu/cpu"
 #define BASE_UNCORE_FREQ_PATH  "/sys/devices/system/cpu/intel_uncore_frequency/package_0"
 #define SCALING_GOVERNOR       "/cpufreq/scaling_governor"
@@ -14,15 +21,42 @@
 
 class FrequencyManager
 {
-private:
+public:
+    struct Transition
+    {
+        int frequency = 0;          // requested frequency, in kHz
+        Duration latency = {};      // time until the slowest CPU or domain reported it
+        int unsettled = 0;          // number of CPUs or domains that never reached it
+        bool verified = false;      // false if we couldn't read back the effective frequency
+    };
 
+private:
 #ifdef __linux__
+    // how long to wait for the new frequency to be observed before starting
+    // the test anyway, and the error we tolerate in the observed value
+    static constexpr Duration SettleTimeout = std::chrono::milliseconds(50);
+    static constexpr Duration SettleSampleWindow = std::chrono::microseconds(500);
+    static constexpr double SettleTolerance = 0.05;
+
+    struct CoreTransitionThread
+    {
+        FrequencyManager *self;
+        pthread_t thread;
+        int cpu;
+        int frequency;
+        int saved_errno;
+        bool started;
+        Duration latency;
+        enum { Unverified, Settled, Unsettled } state;
+    };
+
     // core-frequency variables
     int max_core_frequency_supported = 0;
     int min_core_frequency_supported = 0;
     std::vector<std::string> per_cpu_initial_scaling_governor;
     std::vector<std::string> per_cpu_initial_scaling_setspeed;
-    int current_set_frequency = 0;
+    std::vector<int> per_cpu_scaling_setspeed_fd;
+    std::vector<int> current_core_frequency;                // current scaling_setspeed for each socket
     std::vector<int> core_frequency_levels;
     int core_frequency_level_idx = 0;
     int total_core_frequency_levels = 0;
@@ -30,10 +64,28 @@ private:
     // uncore-frequency variables
     std::vector<std::pair<int, int>> initial_uncore_frequency;  // initial (min, max) un-core pair for each socket
     std::vector<std::vector<int>> uncore_frequency_levels;  // frequency levels for each socket
-    uint16_t total_sockets = 0;
+    std::vector<std::pair<int, int>> uncore_frequency_fds;  // (min, max) file descriptors for each socket
+    std::vector<int> current_uncore_max_frequency;          // current max_freq_khz limit for each socket
     int uncore_frequency_level_idx = 0;
     int total_uncore_frequency_levels = 0;
 
+    // socket topology, shared by both
+    std::vector<int> cpu_socket;        // socket index for each CPU
+    uint16_t total_sockets = 0;
+
+    // in schmoo mode, each socket runs at a different level in the same fracture
+    bool schmoo = false;
+
+    int level_for_socket(int level_idx, size_t socket, int total_levels) const
+    {
+        // spread the sockets evenly over the levels, so that after
+        // total_levels / total_sockets fractures every level has been visited
+        // by at least one socket and after total_levels, all by every socket
+        if (schmoo)
+            level_idx += socket * total_levels / total_sockets;
+        return level_idx % total_levels;
+    }
+
     std::string read_file(const std::string &file_path)
     {
         /* Read first line of given file */
@@ -78,6 +130,87 @@ private:
         return frequency;
     }
 
+    int open_frequency_file(const std::string &file_path)
+    {
+        int fd = open(file_path.c_str(), O_RDWR | O_CLOEXEC);
+        if (fd < 0) {
+            fprintf(stderr, "%s: cannot open file \"%s\" for writing. Make sure the user is root: %m\n", program_invocation_name, file_path.c_str());
+            exit(EXIT_NOPERMISSION);
+        }
+        return fd;
+    }
+
+    static bool write_frequency_fd(int fd, int frequency)
+    {
+        // sysfs attributes ignore the file offset, so the descriptor can be reused
+        char buf[16];
+        int len = snprintf(buf, sizeof(buf), "%d", frequency);
+        return pwrite(fd, buf, len, 0) == len;
+    }
+
+    static int read_frequency_fd(int fd)
+    {
+        char buf[16];
+        ssize_t len = pread(fd, buf, sizeof(buf) - 1, 0);
+        if (len <= 0)
+            return 0;
+        buf[len] = '\0';
+        return atoi(buf);
+    }
+
+    static bool frequency_matches(double actual_khz, int target_khz)
+    {
+        return fabs(actual_khz - target_khz) <= target_khz * SettleTolerance;
+    }
+
+    static void *core_transition_thread(void *ptr)
+    {
+        // Runs pinned to the CPU whose frequency is changing: the sysfs write
+        // doesn't need an IPI and the CPU is kept busy so APERF/MPERF advance.
+        auto t = static_cast<CoreTransitionThread *>(ptr);
+        pin_to_logical_processor(LogicalProcessor(cpu_info[t->cpu].cpu_number));
+        core_transition(t);
+        return nullptr;
+    }
+
+    static void core_transition(CoreTransitionThread *t)
+    {
+        int target = t->frequency;
+        MonotonicTimePoint start = MonotonicTimePoint::clock::now();
+        if (!write_frequency_fd(t->self->per_cpu_scaling_setspeed_fd[t->cpu], target)) {
+            t->saved_errno = errno;
+            return;
+        }
+
+        MonotonicTimePoint deadline = start + SettleTimeout;
+        MonotonicTimePoint now;
+        do {
+            CPUTimeFreqStamp before, after;
+            before.Snapshot(t->cpu);
+            MonotonicTimePoint sample_end = MonotonicTimePoint::clock::now() + SettleSampleWindow;
+            do {
+                now = MonotonicTimePoint::clock::now();
+            } while (now < sample_end);
+            after.Snapshot(t->cpu);
+
+            double mhz = CPUTimeFreqStamp::EffectiveFrequencyMHz(before, after);
+            if (isnan(mhz)) {
+                // no access to the MSRs
+                t->state = CoreTransitionThread::Unverified;
+                t->latency = now - start;
+                return;
+            }
+            if (frequency_matches(mhz * 1000, target)) {
+                t->state = CoreTransitionThread::Settled;
+                t->latency = now - start;
+                return;
+            }
+        } while (now < deadline);
+
+        t->state = CoreTransitionThread::Unsettled;
+        t->latency = now - start;
+    }
+
     void populate_frequency_levels(auto &min_max_frequency, bool is_core, int total_frequency_levels)
     {
         std::vector<int> tmp_frequency_levels;
@@ -136,14 +269,19 @@ private:
 
     void calculate_total_sockets()
     {
-        std::unordered_set<int> found_socket_ids;
+        if (total_sockets)
+            return;         // already done
+
+        std::vector<int> socket_ids;
+        for (size_t cpu = 0; cpu < num_cpus(); cpu++)
+            socket_ids.push_back(cpu_info[cpu].package_id);
+        std::sort(socket_ids.begin(), socket_ids.end());
+        socket_ids.erase(std::unique(socket_ids.begin(), socket_ids.end()), socket_ids.end());
+        total_sockets = socket_ids.size();
 
         for (size_t cpu = 0; cpu < num_cpus(); cpu++) {
-            int socket_id = cpu_info[cpu].package_id;
-            if (found_socket_ids.count(socket_id) == 0) {
-                total_sockets++;
-                found_socket_ids.insert(socket_id);
-            }
+            auto it = std::lower_bound(socket_ids.begin(), socket_ids.end(), cpu_info[cpu].package_id);
+            cpu_socket.push_back(it - socket_ids.begin());
         }
     }
 
@@ -153,6 +291,59 @@ private:
 public:
     FrequencyManager() {}
 
+    void enable_schmoo_mode()
+    {
+#ifdef __linux__
+        schmoo = true;
+#endif
+    }
+
+    bool schmoo_mode() const
+    {
+#ifdef __linux__
+        return schmoo;
+#else
+        return false;
+#endif
+    }
+
+    int socket_count() const
+    {
+#ifdef __linux__
+        return total_sockets;
+#else
+        return 1;
+#endif
+    }
+
+    int socket_of_cpu(int cpu) const
+    {
+#ifdef __linux__
+        return cpu_socket[cpu];
+#else
+        return 0;
+#endif
+    }
+
+    // current frequencies for a socket in kHz, or 0 if not being varied
+    int core_frequency(int socket) const
+    {
+#ifdef __linux__
+        if (size_t(socket) < current_core_frequency.size())
+            return current_core_frequency[socket];
+#endif
+        return 0;
+    }
+
+    int uncore_frequency(int socket) const
+    {
+#ifdef __linux__
+        if (size_t(socket) < current_uncore_max_frequency.size())
+            return current_uncore_max_frequency[socket];
+#endif
+        return 0;
+    }
+
     void initial_core_frequency_setup()
     {
 #ifdef __linux__
@@ -172,6 +363,9 @@ public:
         std::pair<int, int> min_max_frequency(min_core_frequency_supported, max_core_frequency_supported);
         populate_frequency_levels(min_max_frequency, true, total_core_frequency_levels);
 
+        calculate_total_sockets();
+        current_core_frequency.resize(total_sockets);
+
         // save states
         for (int cpu = 0; cpu < num_cpus(); cpu++) {
             //save scaling governor for every cpu
@@ -188,6 +382,9 @@ public:
 
             //change scaling_governor to userspace in order to set the cores to different frequencies
             write_file(scaling_governor_path, "userspace");
+
+            //keep scaling_setspeed open, as we write to it before every fracture
+            per_cpu_scaling_setspeed_fd.push_back(open_frequency_file(initial_scaling_setspeed_frequency_path));
         }
 #endif 
     }
@@ -213,41 +410,114 @@ public:
             total_uncore_frequency_levels = std::min(8, (max_min_frequency.second - max_min_frequency.first) / 100000);
 
             populate_frequency_levels(max_min_frequency, false, total_uncore_frequency_levels);
+            current_uncore_max_frequency.push_back(max_min_frequency.second);
             initial_uncore_frequency.push_back(std::move(max_min_frequency));
+            uncore_frequency_fds.emplace_back(open_frequency_file(min_freq_file), open_frequency_file(max_freq_file));
         }
 #endif
     }
 
-    void change_core_frequency()
+    Transition change_core_frequency()
     {
+        Transition result;
 #ifdef __linux__
-        current_set_frequency = core_frequency_levels[core_frequency_level_idx++ % total_core_frequency_levels];
-        
+        int level_idx = core_frequency_level_idx++;
+        for (size_t socket = 0; socket < total_sockets; socket++) {
+            int level = level_for_socket(level_idx, socket, total_core_frequency_levels);
+            current_core_frequency[socket] = core_frequency_levels[level];
+        }
+        result.frequency = current_core_frequency[0];
+
+        // write to all CPUs in parallel and wait for each to settle
+        std::vector<CoreTransitionThread> threads(num_cpus());
         for (int cpu = 0; cpu < num_cpus(); cpu++) {
-            std::string scaling_setspeed = BASE_CORE_FREQ_PATH;
-            scaling_setspeed += std::to_string(cpu_info[cpu].cpu_number);
-            scaling_setspeed += SCALING_SETSPEED;
-            write_file(scaling_setspeed, std::to_string(current_set_frequency));
+            threads[cpu] = { .self = this, .cpu = cpu, .frequency = current_core_frequency[cpu_socket[cpu]],
+                             .saved_errno = 0, .started = false, .latency = {},
+                             .state = CoreTransitionThread::Unverified };
+            int ret = pthread_create(&threads[cpu].thread, nullptr, core_transition_thread, &threads[cpu]);
+            if (ret == 0) {
+                threads[cpu].started = true;
+            } else {
+                // out of threads: change this CPU from here instead, without
+                // pinning (the settle check may then see an idle CPU)
+                core_transition(&threads[cpu]);
+            }
+        }
+
+        for (CoreTransitionThread &t : threads) {
+            if (t.started)
+                pthread_join(t.thread, nullptr);
+        }
+
+        for (const CoreTransitionThread &t : threads) {
+            if (t.saved_errno) {
+                errno = t.saved_errno;
+                fprintf(stderr, "%s: cannot write \"%d\" to scaling_setspeed of CPU %d. Make sure the user is root: %m\n",
+                        program_invocation_name, t.frequency, cpu_info[t.cpu].cpu_number);
+                exit(EXIT_NOPERMISSION);
+            }
+            if (t.state == CoreTransitionThread::Unverified)
+                continue;
+            result.verified = true;
+            result.latency = std::max(result.latency, t.latency);
+            if (t.state == CoreTransitionThread::Unsettled)
+                ++result.unsettled;
         }
 #endif
+        return result;
     }
 
-    void change_uncore_frequency()
+    Transition change_uncore_frequency()
     {
+        Transition result;
 #ifdef __linux__
+        int level_idx = uncore_frequency_level_idx++;
+        MonotonicTimePoint start = MonotonicTimePoint::clock::now();
         for (size_t socket = 0; socket < total_sockets; socket++) {
-            std::pair<int, int> max_min_frequency;
-            std::string uncore_frequency_path = BASE_UNCORE_FREQ_PATH;
-            uncore_frequency_path += std::to_string(socket);
+            int level = level_for_socket(level_idx, socket, total_uncore_frequency_levels);
+            int frequency = uncore_frequency_levels[socket][level];
+            auto [min_fd, max_fd] = uncore_frequency_fds[socket];
+
+            // the driver rejects min > max, so order the writes accordingly
+            bool ok;
+            if (frequency >= current_uncore_max_frequency[socket])
+                ok = write_frequency_fd(max_fd, frequency) && write_frequency_fd(min_fd, frequency);
+            else
+                ok = write_frequency_fd(min_fd, frequency) && write_frequency_fd(max_fd, frequency);
+            if (!ok) {
+                fprintf(stderr, "%s: cannot write \"%d\" to the uncore frequency limits of socket %zu. Make sure the user is root: %m\n",
+                        program_invocation_name, frequency, socket);
+                exit(EXIT_NOPERMISSION);
+            }
+            current_uncore_max_frequency[socket] = frequency;
+        }
 
-            std::string min_freq_file = uncore_frequency_path + "_die_00/min_freq_khz";
-            std::string frequency_to_write = std::to_string(uncore_frequency_levels[socket][uncore_frequency_level_idx++ % total_uncore_frequency_levels]);
-            write_file(min_freq_file, frequency_to_write);
+        // all sockets are usually set to the same level, so report the first
+        result.frequency = current_uncore_max_frequency[0];
 
-            std::string max_freq_file = uncore_frequency_path + "_die_00/max_freq_khz";
-            write_file(max_freq_file, frequency_to_write);
+        // verify using current_freq_khz, if this kernel has it
+        for (size_t socket = 0; socket < total_sockets; socket++) {
+            std::string current_freq_file = BASE_UNCORE_FREQ_PATH + std::to_string(socket) + "_die_00/current_freq_khz";
+            int fd = open(current_freq_file.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0)
+                continue;
+
+            int frequency = current_uncore_max_frequency[socket];
+            MonotonicTimePoint deadline = start + SettleTimeout;
+            MonotonicTimePoint now;
+            bool settled;
+            while (!(settled = frequency_matches(read_frequency_fd(fd), frequency))
+                   && (now = MonotonicTimePoint::clock::now()) < deadline)
+                usleep(std::chrono::duration_cast<std::chrono::microseconds>(SettleSampleWindow).count());
+            close(fd);
+
+            result.verified = true;
+            result.latency = std::max(result.latency, MonotonicTimePoint::clock::now() - start);
+            if (!settled)
+                ++result.unsettled;
         }
 #endif
+        return result;
     }
 
     void restore_core_frequency_initial_state()
@@ -266,6 +536,10 @@ public:
             scaling_setspeed_path += SCALING_SETSPEED;
             write_file(scaling_setspeed_path, per_cpu_initial_scaling_setspeed[cpu]);
         }
+
+        for (int fd : per_cpu_scaling_setspeed_fd)
+            close(fd);
+        per_cpu_scaling_setspeed_fd.clear();
 #endif
     }
 
@@ -273,18 +547,23 @@ public:
     {
 #ifdef __linux__
         for (size_t socket = 0; socket < total_sockets; socket++) {
-            std::pair<int, int> max_min_frequency;
-            std::string uncore_frequency_path = BASE_UNCORE_FREQ_PATH;
-            uncore_frequency_path += std::to_string(socket);
-
-            std::string min_freq_file = uncore_frequency_path + "_die_00/min_freq_khz";
-            std::string frequency_to_write = std::to_string(initial_uncore_frequency[socket].first);
-            write_file(min_freq_file, frequency_to_write);
-
-            frequency_to_write = std::to_string(initial_uncore_frequency[socket].second);
-            std::string max_freq_file = uncore_frequency_path + "_die_00/max_freq_khz";
-            write_file(max_freq_file, frequency_to_write);
+            auto [min_fd, max_fd] = uncore_frequency_fds[socket];
+            auto [min_frequency, max_frequency] = initial_uncore_frequency[socket];
+
+            // the driver rejects min > max, so order the writes accordingly
+            bool ok;
+            if (min_frequency < current_uncore_max_frequency[socket])
+                ok = write_frequency_fd(min_fd, min_frequency) && write_frequency_fd(max_fd, max_frequency);
+            else
+                ok = write_frequency_fd(max_fd, max_frequency) && write_frequency_fd(min_fd, min_frequency);
+            if (!ok)
+                fprintf(stderr, "%s: cannot restore the uncore frequency limits of socket %zu: %m\n",
+                        program_invocation_name, socket);
+
+            close(min_fd);
+            close(max_fd);
         }
+        uncore_frequency_fds.clear();
 #endif
     }
 
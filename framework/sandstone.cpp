@@ -11,10 +11,12 @@
 #endif
 
 #include <algorithm>
+#include <bit>
 #include <chrono>
 #include <new>
 #include <map>
 #include <numeric>
+#include <tuple>
 #include <utility>
 #include <vector>
 
@@ -36,6 +38,7 @@
 #  include <poll.h>
 #endif
 #include <pthread.h>
+#include <sched.h>
 #include <signal.h>
 #include <stdint.h>
 #if __has_include(<sys/auxv.h>)         // FreeBSD and Linux
@@ -142,6 +145,7 @@ enum {
     on_crash_option,
     on_hang_option,
     output_format_option,
+    oversubscribe_option,
     quality_option,
     quick_run_option,
     raw_list_tests,
@@ -153,6 +157,8 @@ enum {
     selftest_option,
 #endif
     service_option,
+    service_cgroup_weight_option,
+    service_idle_cpus_option,
     shortened_runtime_option,
     strict_runtime_option,
     syslog_runtime_option,
@@ -168,6 +174,7 @@ enum {
     ud_on_failure_option,
     use_builtin_test_list_option,
     vary_frequency,
+    vary_frequency_schmoo,
     vary_uncore_frequency,
     version_option,
     weighted_testrun_option,
@@ -556,7 +563,8 @@ inline void test_the_test_data<true>::test_tests_finish(const struct test *the_t
 
     // check the overall time
     if (sApp->shmem->current_test_endtime != MonotonicTimePoint::max() && the_test->desired_duration >= 0) {
-        Duration expected_runtime = sApp->shmem->current_test_endtime - sApp->current_test_starttime;
+        Duration expected_runtime = sApp->shmem->current_test_endtime - sApp->current_test_starttime
+                + sApp->init_per_thread_time;
         Duration min_expected_runtime = expected_runtime - expected_runtime / 4;
         Duration max_expected_runtime = expected_runtime + expected_runtime / 4;
         Duration actual_runtime = now - sApp->current_test_starttime;
@@ -673,6 +681,10 @@ static ShortDuration test_duration(const struct test *test)
     if (target_duration <= 0s)
         target_duration = SandstoneApplication::DefaultTestDuration;
 
+    /* the background scan runs shorter tests if the system is under some pressure */
+    if (sApp->service_background_scan)
+        target_duration = duration_cast<ShortDuration>(target_duration * sApp->background_scan.duration_scale);
+
     /* if --force-test-time specified, ignore the test-specified time limits */
     if (sApp->force_test_time)
         return target_duration;
@@ -734,6 +746,15 @@ static bool max_loop_count_exceeded(const struct test *the_test)
     return false;
 }
 
+static MonotonicTimePoint current_test_deadline()
+{
+    // the time spent in test_init_per_thread() doesn't count towards the duration
+    MonotonicTimePoint deadline = sApp->shmem->current_test_endtime;
+    if (deadline != MonotonicTimePoint::max())
+        deadline += sApp->init_per_thread_time;
+    return deadline;
+}
+
 extern "C" void test_loop_iterate() noexcept;    // see below
 
 /* returns 1 if the test should keep running, useful for a while () loop */
@@ -746,7 +767,27 @@ int test_time_condition(const struct test *the_test) noexcept
     if (max_loop_count_exceeded(the_test))
         return 0;  // end the test if max loop count exceeded
 
-    return !wallclock_deadline_has_expired(sApp->shmem->current_test_endtime);
+    // let the companion threads run while the test's state is live
+    if (sApp->shmem->oversubscription > 1)
+        sched_yield();
+
+    return !wallclock_deadline_has_expired(current_test_deadline());
+}
+
+unsigned test_loop_auto_calibrate(uint64_t iterations, Duration elapsed, unsigned min_n, unsigned max_n) noexcept
+{
+    // aim for the middle of what test_the_test accepts
+    static constexpr Duration TargetLoopDuration = test_the_test_data<true>::TargetLoopDuration;
+    static constexpr Duration CalibrationDuration = TargetLoopDuration / 4;
+    if (elapsed < CalibrationDuration)
+        return 0;
+
+    // round down, so each loop takes between half and all of the target
+    uint64_t wanted = iterations * TargetLoopDuration.count() / elapsed.count();
+    unsigned n = wanted >= max_n ? max_n : std::max(min_n, unsigned(std::bit_floor(wanted)));
+    log_message(thread_num, SANDSTONE_LOG_DEBUG "TEST_LOOP_AUTO granularity: %u (%s per iteration)",
+                n, format_duration(elapsed / iterations).c_str());
+    return n;
 }
 
 // Creates a string containing all socket temperatures like: "P0:30oC P2:45oC"
@@ -926,6 +967,13 @@ static uintptr_t thread_runner(int thread_number)
     pin_to_logical_processor(LogicalProcessor(cpu_info[thread_number].cpu_number), current_test->id);
 
     PerThreadData::Test *this_thread = sApp->test_thread_data(thread_number);
+    ThreadState init_state = this_thread->thread_state.load(std::memory_order_relaxed);
+    if (init_state == thread_failed || init_state == thread_skipped) {
+        // test_init_per_thread() failed or skipped on this thread
+        slice_coordinator_thread_finished();
+        return EXIT_FAILURE;
+    }
+
     random_init_thread(thread_number);
     int ret = EXIT_FAILURE;
 
@@ -946,6 +994,7 @@ static uintptr_t thread_runner(int thread_number)
             logging_mark_thread_failed(thread_number);
         }
         test_end(new_state);
+        slice_coordinator_thread_finished();
     });
 
     // indicate to SIGQUIT handler that we're running
@@ -978,11 +1027,52 @@ static uintptr_t thread_runner(int thread_number)
     return ret;
 }
 
+static uintptr_t init_per_thread_runner(int thread_number)
+{
+    pin_to_logical_processor(LogicalProcessor(cpu_info[thread_number].cpu_number), current_test->id);
+
+    PerThreadData::Test *this_thread = sApp->test_thread_data(thread_number);
+    random_init_thread(thread_number);
+    int ret = EXIT_FAILURE;
+
+    auto cleanup = scopeExit([&] {
+        // on success, leave the state for thread_runner() to update
+        ThreadState new_state = thread_not_started;
+        if (this_thread->has_failed() || ret > EXIT_SUCCESS)
+            new_state = thread_failed;
+        else if (ret < EXIT_SUCCESS)
+            new_state = thread_skipped;
+        this_thread->thread_state.store(new_state, std::memory_order_relaxed);
+
+        if (new_state == thread_failed) {
+            if (ret > EXIT_SUCCESS)
+                log_error("Per-thread init function failed with code %i", ret);
+            logging_mark_thread_failed(thread_number);
+        } else if (new_state == thread_skipped && ret != EXIT_SKIP) {
+            log_skip(RuntimeSkipCategory, "Unexpected OS error in per-thread init: %s", strerror(-ret));
+        }
+        slice_coordinator_thread_finished();
+    });
+
+    this_thread->thread_state.store(thread_running, std::memory_order_relaxed);
+    try {
+        ret = current_test->test_init_per_thread(const_cast<struct test *>(current_test), thread_number);
+    } catch (std::exception &e) {
+        log_error("Caught C++ exception: \"%s\" (type '%s')", e.what(), typeid(e).name());
+    }
+    return ret;
+}
+
 int num_cpus()
 {
     return sApp->thread_count;
 }
 
+int num_cpus_total()
+{
+    return sApp->shmem->total_cpu_count;
+}
+
 int num_packages() {
     return Topology::topology().packages.size();
 }
@@ -1401,9 +1491,23 @@ Common command-line options are:
  -o, --output-log <FILE>
      Place all logging information in <FILE>.  By default, a file name is
      auto-generated by the program.  Use -o /dev/null to suppress creation of any file.
+ --oversubscribe <NUMBER>
+     Run <NUMBER> threads on each logical processor instead of one: the test's
+     thread and companion threads that keep different contents in the vector
+     and AMX registers, to stress the saving and restoring of register state
+     across context switches.  The default is 1 (no oversubscription).
  -s <STATE>, --rng-state=<STATE>
      Specify the random generator state to reload. The seed is in the form:
        Engine:engine-specific-data
+ --service-cgroup-weight <WEIGHT>
+     In service (background scan) mode, run the tests in a child cgroup with
+     the given cpu.weight (1 to 10000), so other workloads on the host take
+     precedence. Requires cgroup v2 and permission to delegate the cpu
+     controller.
+ --service-idle-cpus
+     In service (background scan) mode, if the system as a whole is not idle,
+     run shorter tests on only the logical processors that are, preferring
+     those that have not been tested for the longest time.
  -v, -q, --verbose, --quiet
      Set logging output verbosity level.  Default is quiet.
  --version
@@ -1453,44 +1557,53 @@ static void restart_init(int iterations)
 {
 }
 
+template <SandstoneTestThread::RunnerFunction *Runner>
 static void run_threads_in_parallel(const struct test *test)
 {
     SandstoneTestThread thr[num_cpus()];    // NOLINT: -Wvla
     int i;
 
+    slice_coordinator_start(num_cpus(), 0);
     for (i = 0; i < num_cpus(); i++) {
-        thr[i].start(thread_runner, i);
+        thr[i].start(Runner, i);
     }
     /* wait for threads to end */
     for (i = 0; i < num_cpus(); i++) {
         thr[i].join();
     }
+    slice_coordinator_finish();
 }
 
+template <SandstoneTestThread::RunnerFunction *Runner>
 static void run_threads_sequentially(const struct test *test)
 {
     // we still start one thread, in case the test uses report_fail_msg()
     // (which uses pthread_cancel())
     SandstoneTestThread thread;
     thread.start([](int cpu) {
-        for ( ; cpu != num_cpus(); thread_num = ++cpu)
-            thread_runner(cpu);
+        for ( ; cpu != num_cpus(); thread_num = ++cpu) {
+            // each thread is a slice of its own
+            slice_coordinator_start(1, cpu);
+            Runner(cpu);
+            slice_coordinator_finish();
+        }
         return uintptr_t(cpu);
     }, 0);
     thread.join();
 }
 
+template <SandstoneTestThread::RunnerFunction *Runner = thread_runner>
 static void run_threads(const struct test *test)
 {
     current_test = test;
 
     switch (test->flags & test_schedule_mask) {
     default:
-        run_threads_in_parallel(test);
+        run_threads_in_parallel<Runner>(test);
         break;
 
     case test_schedule_sequential:
-        run_threads_sequentially(test);
+        run_threads_sequentially<Runner>(test);
         break;
     }
 
@@ -1542,6 +1655,38 @@ struct ChildrenList
 };
 } // unnamed namespace
 
+static bool background_scan_uses_pressure()
+{
+    return sApp->service_background_scan && sApp->background_scan.pressure
+            && sApp->background_scan.pressure->works();
+}
+
+static float background_scan_pressure_ratio()
+{
+    // relax the limits as time passes without a test, like the loadavg threshold
+    SandstoneBackgroundScan &bs = sApp->background_scan;
+    float scale = std::max(1.0f, bs.load_idle_threshold / bs.load_idle_threshold_init);
+    return PressureMonitor::pressure_ratio(bs.pressure->sample(), num_cpus(), scale);
+}
+
+static void background_scan_check_pressure()
+{
+    float ratio = background_scan_pressure_ratio();
+    if (PressureMonitor::verdict(ratio) != PressureMonitor::Abort)
+        return;
+
+    MonotonicTimePoint now = MonotonicTimePoint::clock::now();
+    if (sApp->shmem->current_test_endtime <= now)
+        return;                 // already stopping
+
+    // make the test end at its next test_time_condition() check and don't
+    // start another fracture
+    logging_printf(LOG_LEVEL_VERBOSE(2), "# Background scan: system is under pressure "
+                                         "(%.2f of the limit), stopping the test early\n", ratio);
+    sApp->shmem->current_test_endtime = now;
+    sApp->current_test_duration = {};
+}
+
 static void wait_for_children(ChildrenList &children, int *tc, const struct test *test)
 {
     Duration remaining = test_timeout(sApp->current_test_duration);
@@ -1693,12 +1838,17 @@ static void wait_for_children(ChildrenList &children, int *tc, const struct test
             }
         }
     };
-    auto wait_for_all_children = [&](Duration remaining) {
+    auto wait_for_all_children = [&](Duration remaining, bool monitor_pressure = false) {
         MonotonicTimePoint deadline = steady_clock::now() + remaining;
         for ( ; children_left && remaining > 0s; remaining = deadline - steady_clock::now()) {
+            if (monitor_pressure)
+                remaining = std::min(remaining, SandstoneBackgroundScanConstants::PressurePollInterval);
             int ret = single_wait(ceil<milliseconds>(remaining));
-            if (ret == 0)
+            if (ret == 0) {
+                if (monitor_pressure)
+                    background_scan_check_pressure();
                 continue;
+            }
 
             for (ChildExitStatus &result : children.results)
                 result = { TestResult::Interrupted };
@@ -1718,7 +1868,7 @@ static void wait_for_children(ChildrenList &children, int *tc, const struct test
     };
 
     /* first wait set : normal exit */
-    wait_for_all_children(remaining);
+    wait_for_all_children(remaining, background_scan_uses_pressure());
     if (children_left == 0)
         return;
 
@@ -1793,7 +1943,16 @@ static TestResult child_run(/*nonconst*/ struct test *test, int child_number)
             break;
         }
 
+        sApp->init_per_thread_time = {};
+        if (test->test_init_per_thread) {
+            MonotonicTimePoint start = MonotonicTimePoint::clock::now();
+            run_threads<init_per_thread_runner>(test);
+            sApp->init_per_thread_time = MonotonicTimePoint::clock::now() - start;
+        }
+
+        oversubscription_start();
         run_threads(test);
+        oversubscription_finish();
 
         if (sApp->shmem->use_strict_runtime && wallclock_deadline_has_expired(sApp->endtime)){
             // skip cleanup on the last test when using strict runtime
@@ -2059,6 +2218,11 @@ static void run_one_test_children(ChildrenList &children, int *tc, const struct
             children.add(spawn_child(test, i));
     }
 
+    if (sApp->service_background_scan && sApp->background_scan.cgroup_weight) {
+        for (pid_t child : children.handles)
+            sApp->background_scan.pressure->move_to_test_cgroup(child);
+    }
+
     /* wait for the children */
     wait_for_children(children, tc, test);
 }
@@ -2222,6 +2386,70 @@ static void analyze_test_failures(int tc, const struct test *test, int fail_coun
     }
 }
 
+static void print_frequency_transition(const char *domain, const FrequencyManager::Transition &t,
+                                       int (FrequencyManager::*per_socket)(int) const)
+{
+    // in schmoo mode, list the frequency of each socket
+    std::string frequency = std::to_string(t.frequency / 1000);
+    if (sApp->frequency_manager.schmoo_mode()) {
+        for (int socket = 1; socket < sApp->frequency_manager.socket_count(); ++socket)
+            frequency += '/' + std::to_string((sApp->frequency_manager.*per_socket)(socket) / 1000);
+    }
+
+    if (!t.verified) {
+        logging_printf(LOG_LEVEL_VERBOSE(1), "# %s frequency set to %s MHz (could not verify)\n",
+                       domain, frequency.c_str());
+    } else if (t.unsettled) {
+        logging_printf(LOG_LEVEL_VERBOSE(1), "# %s frequency set to %s MHz, but %d did not settle in %s\n",
+                       domain, frequency.c_str(), t.unsettled, format_duration(t.latency).c_str());
+    } else {
+        logging_printf(LOG_LEVEL_VERBOSE(1), "# %s frequency set to %s MHz, transition took %s\n",
+                       domain, frequency.c_str(), format_duration(t.latency).c_str());
+    }
+}
+
+namespace {
+struct SchmooResult
+{
+    int fractures = 0;
+    int failures = 0;
+};
+// (socket, core kHz, uncore kHz)
+using SchmooResults = std::map<std::tuple<int, int, int>, SchmooResult>;
+}
+
+static void record_schmoo_fracture(SchmooResults &results, TestResult state)
+{
+    const FrequencyManager &fm = sApp->frequency_manager;
+    std::vector<bool> socket_failed(fm.socket_count(), false);
+    bool any_thread_failed = false;
+    for_each_test_thread([&](PerThreadData::Test *data, int i) {
+        if (data->has_failed()) {
+            socket_failed[fm.socket_of_cpu(i)] = true;
+            any_thread_failed = true;
+        }
+    });
+
+    for (int socket = 0; socket < fm.socket_count(); ++socket) {
+        SchmooResult &r = results[{ socket, fm.core_frequency(socket), fm.uncore_frequency(socket) }];
+        ++r.fractures;
+        // a failure we can't attribute to a thread (crash, timeout) counts against all
+        if (socket_failed[socket] || (state > TestResult::Passed && !any_thread_failed))
+            ++r.failures;
+    }
+}
+
+static void print_schmoo_results(const SchmooResults &results)
+{
+    logging_printf(LOG_LEVEL_VERBOSE(1), "# Frequency schmoo results (socket, core, uncore: passed/run):\n");
+    for (const auto &[point, r] : results) {
+        auto [socket, core, uncore] = point;
+        logging_printf(LOG_LEVEL_VERBOSE(1), "#  - socket %d, %d MHz, %d MHz: %d/%d%s\n",
+                       socket, core / 1000, uncore / 1000, r.fractures - r.failures, r.fractures,
+                       r.failures ? " FAIL" : "");
+    }
+}
+
 TestResult run_one_test(int *tc, const struct test *test, SandstoneApplication::PerCpuFailures &per_cpu_fails)
 {
     TestResult state = TestResult::Skipped;
@@ -2230,6 +2458,7 @@ TestResult run_one_test(int *tc, const struct test *test, SandstoneApplication::
     MonotonicTimePoint first_iteration_target;
     bool auto_fracture = false;
     Duration runtime = 0ms;
+    SchmooResults schmoo_results;
 
     // resize and zero the storage
     if (per_cpu_fails.size() == num_cpus()) {
@@ -2274,11 +2503,13 @@ TestResult run_one_test(int *tc, const struct test *test, SandstoneApplication::
 
         //change frequency per fracture
         if (sApp->vary_frequency_mode == true)
-            sApp->frequency_manager.change_core_frequency();
+            print_frequency_transition("Core", sApp->frequency_manager.change_core_frequency(),
+                                       &FrequencyManager::core_frequency);
         
         //change uncore frequency per fracture
         if (sApp->vary_uncore_frequency_mode == true)
-            sApp->frequency_manager.change_uncore_frequency();
+            print_frequency_transition("Uncore", sApp->frequency_manager.change_uncore_frequency(),
+                                       &FrequencyManager::uncore_frequency);
 
         init_internal(test);
 
@@ -2291,6 +2522,9 @@ TestResult run_one_test(int *tc, const struct test *test, SandstoneApplication::
 
         cleanup_internal(test);
 
+        if (sApp->frequency_manager.schmoo_mode() && state != TestResult::Skipped)
+            record_schmoo_fracture(schmoo_results, state);
+
         if ((sApp->shmem->current_max_loop_count > 0
              && MonotonicTimePoint::clock::now() < first_iteration_target && auto_fracture))
             sApp->shmem->current_max_loop_count *= 2;
@@ -2352,6 +2586,9 @@ TestResult run_one_test(int *tc, const struct test *test, SandstoneApplication::
     }
 
 out:
+    if (!schmoo_results.empty())
+        print_schmoo_results(schmoo_results);
+
     //reset frequency level idx for the next test
     if (sApp->vary_frequency_mode || sApp->vary_uncore_frequency_mode)
         sApp->frequency_manager.reset_frequency_level_idx();
@@ -2927,6 +3164,7 @@ static void background_scan_init()
         std::atomic<int> initialized;
         std::atomic<int> dummy;
         std::array<MonotonicTimePoint::rep, 24> timestamp;
+        std::array<MonotonicTimePoint::rep, LogicalProcessorSet::MinSize> cpu_timestamp;
     };
 
     if (!sApp->service_background_scan)
@@ -2949,6 +3187,10 @@ static void background_scan_init()
     sApp->background_scan.timestamp = {
         reinterpret_cast<MonotonicTimePoint *>(file->timestamp.data()), file->timestamp.size()
     };
+    // files from older versions are extended with zeroes: never tested
+    sApp->background_scan.cpu_timestamp = {
+        reinterpret_cast<MonotonicTimePoint *>(file->cpu_timestamp.data()), file->cpu_timestamp.size()
+    };
     if (file->initialized.exchange(true, std::memory_order_relaxed) == false) {
         // init timestamps to more than the batch testing time - this quickstarts
         // testing on first run
@@ -2960,6 +3202,14 @@ static void background_scan_init()
     if (fd >= 0)
         close(fd);
 
+    sApp->background_scan.pressure = std::make_unique<PressureMonitor>();
+    if (sApp->background_scan.cgroup_weight
+            && !sApp->background_scan.pressure->create_test_cgroup(sApp->background_scan.cgroup_weight)) {
+        logging_printf(LOG_LEVEL_QUIET, "# WARNING: could not create a cgroup for the tests, "
+                                        "running them with normal weight: %m\n");
+        sApp->background_scan.cgroup_weight = 0;
+    }
+
 #ifdef _WIN32
     if (setup_windows_loadavg_perf_counters() != 0) {
         // If setting up performance counters fail, assume system is never idle.
@@ -2986,6 +3236,80 @@ static void background_scan_update_load_threshold(MonotonicTimePoint now)
         sApp->background_scan.load_idle_threshold = sApp->background_scan.load_idle_threshold_max;
 }
 
+static void background_scan_mark_cpus_tested()
+{
+    MonotonicTimePoint now = MonotonicTimePoint::clock::now();
+    for (int i = 0; i < num_cpus(); ++i) {
+        if (size_t(cpu_info[i].cpu_number) < sApp->background_scan.cpu_timestamp.size())
+            sApp->background_scan.cpu_timestamp[cpu_info[i].cpu_number] = now;
+    }
+}
+
+// Samples /proc/stat and selects the CPUs that are idle and haven't been
+// tested recently
+static bool background_scan_find_idle_cpus()
+{
+    using namespace SandstoneBackgroundScanConstants;
+    SandstoneBackgroundScan &bs = sApp->background_scan;
+    bs.idle_cpus.clear();
+
+    auto before = bs.pressure->read_cpu_times();
+    if (before.empty())
+        return false;
+    if (usleep(duration_cast<microseconds>(IdleCpuSampleInterval).count()) != 0)
+        return false;
+    auto after = bs.pressure->read_cpu_times();
+
+    MonotonicTimePoint now = MonotonicTimePoint::clock::now();
+    std::span<const struct cpu_info> enabled_cpus(cpu_info, num_cpus());
+    for (int cpu : PressureMonitor::idle_cpus(before, after, bs.idle_cpu_threshold)) {
+        // only those we're allowed to run on
+        auto it = std::find_if(enabled_cpus.begin(), enabled_cpus.end(),
+                               [&](const struct cpu_info &ci) { return ci.cpu_number == cpu; });
+        if (it == enabled_cpus.end())
+            continue;
+        if (size_t(cpu) < bs.cpu_timestamp.size() && bs.cpu_timestamp[cpu] != MonotonicTimePoint{}
+                && now < bs.cpu_timestamp[cpu] + MinimumDelayBetweenTestsPerCpu)
+            continue;
+        bs.idle_cpus.set(LogicalProcessor(cpu));
+    }
+    return !bs.idle_cpus.empty();
+}
+
+// Runs the test on only the idle CPUs, like the triage does for sockets
+static TestResult background_scan_run_on_idle_cpus(int *tc, const struct test *test,
+                                                   SandstoneApplication::PerCpuFailures &per_cpu_failures)
+{
+    Topology::Data topo = Topology::topology().clone();
+    auto saved_slice_plans = sApp->slice_plans;
+    std::vector<struct cpu_info> idle_cpu_info;
+    for (const Topology::Thread &t : topo.all_threads) {
+        if (sApp->background_scan.idle_cpus.is_set(LogicalProcessor(t.cpu_number)))
+            idle_cpu_info.push_back(t);
+    }
+
+    update_topology(idle_cpu_info);
+    slice_plan_init(-1);        // a single slice
+
+    SandstoneApplication::PerCpuFailures idle_failures;
+    TestResult result = run_one_test(tc, test, idle_failures);
+    background_scan_mark_cpus_tested();
+
+    update_topology(topo.all_threads);
+    sApp->slice_plans = std::move(saved_slice_plans);
+
+    // map the failures back to the full system
+    per_cpu_failures.assign(num_cpus(), 0);
+    for (size_t i = 0; i < idle_failures.size(); ++i) {
+        for (int j = 0; j < num_cpus(); ++j) {
+            if (cpu_info[j].cpu_number == idle_cpu_info[i].cpu_number)
+                per_cpu_failures[j] = idle_failures[i];
+        }
+    }
+    sApp->background_scan.idle_cpus.clear();
+    return result;
+}
+
 // Don't run tests unless load is low or it's time to run a test anyway
 static bool background_scan_wait()
 {
@@ -3037,12 +3361,26 @@ skip_wait:
         now = MonotonicTimePoint::clock::now();
         background_scan_update_load_threshold(now);
 
-        // if the system is idle, run a test
-        float idle_load = system_idle_load();
-        if (idle_load < sApp->background_scan.load_idle_threshold) {
+        // if the system is idle, run a test; if it's only somewhat idle
+        // (according to PSI), run a shorter one
+        float idle_load, idle_threshold;
+        if (background_scan_uses_pressure()) {
+            idle_load = background_scan_pressure_ratio();
+            idle_threshold = 1.0;
+        } else {
+            idle_load = system_idle_load();
+            idle_threshold = sApp->background_scan.load_idle_threshold;
+        }
+        sApp->background_scan.duration_scale = 1.0;
+        sApp->background_scan.idle_cpus.clear();
+        if (idle_load < idle_threshold) {
+            if (background_scan_uses_pressure()
+                    && PressureMonitor::verdict(idle_load) == PressureMonitor::Shrink)
+                sApp->background_scan.duration_scale = SandstoneBackgroundScan::shrunk_duration_scale;
             logging_printf(LOG_LEVEL_VERBOSE(2), "# Background scan: system is sufficiently idle "
-                                                 "(%.2f; below %.2f), executing next test\n",
-                           idle_load, sApp->background_scan.load_idle_threshold);
+                                                 "(%.2f; below %.2f), executing next test%s\n",
+                           idle_load, idle_threshold,
+                           sApp->background_scan.duration_scale < 1 ? " with reduced duration" : "");
             break;
         }
 
@@ -3055,14 +3393,42 @@ skip_wait:
             break;
         }
 
+        // if some CPUs are idle, run a shorter test on only those
+        if (sApp->background_scan.idle_cpus_mode && background_scan_find_idle_cpus()) {
+            sApp->background_scan.duration_scale = SandstoneBackgroundScan::shrunk_duration_scale;
+            logging_printf(LOG_LEVEL_VERBOSE(2), "# Background scan: system is not idle "
+                                                 "(%.2f; above %.2f), executing next test on %d idle CPUs\n",
+                           idle_load, idle_threshold, sApp->background_scan.idle_cpus.count());
+            break;
+        }
+
         logging_printf(LOG_LEVEL_VERBOSE(3), "# Background scan: system is not idle "
                                              "(%.2f; above %.2f), waiting %d +/- 10%% s\n",
-                       idle_load, sApp->background_scan.load_idle_threshold,
+                       idle_load, idle_threshold,
                        as_seconds(MinimumDelayBetweenTests));
     }
     return true;
 }
 
+// Some tests are also built for wider ISAs than the base one; replace each
+// such test with the clone that requires the most features this CPU has. The
+// whole structure is copied, so the test's init, run and cleanup functions
+// all come from the same build.
+static void dispatch_test_clones()
+{
+    for (const struct test &clone : test_clones) {
+        if (clone.compiler_minimum_cpu & ~cpu_features)
+            continue;
+        for (struct test &test : regular_tests) {
+            if (strcmp(test.id, clone.id) != 0)
+                continue;
+            if (__builtin_popcountll(clone.compiler_minimum_cpu) > __builtin_popcountll(test.compiler_minimum_cpu))
+                test = clone;
+            break;
+        }
+    }
+}
+
 extern constexpr const uint64_t minimum_cpu_features = _compilerCpuFeatures;
 int main(int argc, char **argv)
 {
@@ -3109,6 +3475,7 @@ int main(int argc, char **argv)
         { "on-hang", required_argument, nullptr, on_hang_option },
         { "output-format", required_argument, nullptr, output_format_option},
         { "output-log", required_argument, nullptr, 'o' },
+        { "oversubscribe", required_argument, nullptr, oversubscribe_option },
         { "quality", required_argument, nullptr, quality_option },
         { "quick", no_argument, nullptr, quick_run_option },
         { "quiet", no_argument, nullptr, 'q' },
@@ -3119,6 +3486,8 @@ int main(int argc, char **argv)
         { "selftests", no_argument, nullptr, selftest_option },
 #endif
         { "service", no_argument, nullptr, service_option },
+        { "service-cgroup-weight", required_argument, nullptr, service_cgroup_weight_option },
+        { "service-idle-cpus", no_argument, nullptr, service_idle_cpus_option },
         { "shorten-runtime", required_argument, nullptr, shortened_runtime_option },
         { "strict-runtime", no_argument, nullptr, strict_runtime_option },
         { "syslog", no_argument, nullptr, syslog_runtime_option },
@@ -3138,6 +3507,7 @@ int main(int argc, char **argv)
         { "ud-on-failure", no_argument, nullptr, ud_on_failure_option },
         { "use-builtin-test-list", optional_argument, nullptr, use_builtin_test_list_option },
         { "vary-frequency", no_argument, nullptr, vary_frequency},
+        { "vary-frequency-schmoo", no_argument, nullptr, vary_frequency_schmoo},
         { "vary-uncore-frequency", no_argument, nullptr, vary_uncore_frequency},
         { "verbose", no_argument, nullptr, 'v' },
         { "version", no_argument, nullptr, version_option },
@@ -3181,6 +3551,7 @@ int main(int argc, char **argv)
 
     thread_num = -1;            /* indicate main thread */
     find_thyself(argv[0]);
+    dispatch_test_clones();
     setup_stack_size(argc, argv);
 #ifdef __linux__
     prctl(PR_SET_TIMERSLACK, 1, 0, 0, 0);
@@ -3362,6 +3733,13 @@ int main(int argc, char **argv)
                 return EX_USAGE;
             }
             break;
+        case oversubscribe_option:
+            sApp->shmem->oversubscription = ParseIntArgument<>{
+                    .name = "--oversubscribe",
+                    .min = 1,
+                    .max = 64,
+            }();
+            break;
 
         case quality_option:
             sApp->requested_quality = ParseIntArgument<>{
@@ -3409,6 +3787,17 @@ int main(int argc, char **argv)
             sApp->endtime = MonotonicTimePoint::max();
             sApp->service_background_scan = true;
             break;
+        case service_cgroup_weight_option:
+            sApp->background_scan.cgroup_weight = ParseIntArgument<>{
+                    .name = "--service-cgroup-weight",
+                    .explanation = "value should be a cgroup v2 cpu.weight",
+                    .min = 1,
+                    .max = 10000
+            }();
+            break;
+        case service_idle_cpus_option:
+            sApp->background_scan.idle_cpus_mode = true;
+            break;
         case ud_on_failure_option:
             sApp->shmem->ud_on_failure = true;
             break;
@@ -3515,6 +3904,14 @@ int main(int argc, char **argv)
             }
             sApp->vary_frequency_mode = true;
             break;
+
+        case vary_frequency_schmoo:
+            if (!FrequencyManager::FrequencyManagerWorks) {
+                fprintf(stderr, "%s: --vary-frequency-schmoo works only on Linux\n", program_invocation_name);
+                return EX_USAGE;
+            }
+            sApp->frequency_manager.enable_schmoo_mode();
+            break;
         
         case vary_uncore_frequency:
             if (!FrequencyManager::FrequencyManagerWorks) {
@@ -3684,6 +4081,12 @@ int main(int argc, char **argv)
         sApp->mce_count_last = std::accumulate(sApp->mce_counts_start.begin(), sApp->mce_counts_start.end(), uint64_t(0));
     }
 
+    if (sApp->frequency_manager.schmoo_mode() && !sApp->vary_frequency_mode && !sApp->vary_uncore_frequency_mode) {
+        fprintf(stderr, "%s: --vary-frequency-schmoo requires --vary-frequency or --vary-uncore-frequency\n",
+                program_invocation_name);
+        return EX_USAGE;
+    }
+
     //if --vary-frequency mode is used, do a initial setup for running different frequencies
     if (sApp->vary_frequency_mode)
         sApp->frequency_manager.initial_core_frequency_setup();
@@ -3798,7 +4201,13 @@ int main(int argc, char **argv)
                 continue;
         }
 
-        lastTestResult = run_one_test(&tc, test, per_cpu_failures);
+        if (!sApp->background_scan.idle_cpus.empty()) {
+            lastTestResult = background_scan_run_on_idle_cpus(&tc, test, per_cpu_failures);
+        } else {
+            lastTestResult = run_one_test(&tc, test, per_cpu_failures);
+            if (sApp->service_background_scan)
+                background_scan_mark_cpus_tested();
+        }
 
         total_tests_run++;
         if (lastTestResult == TestResult::Failed) {
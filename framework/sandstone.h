@@ -143,6 +143,19 @@ typedef enum SkipCategory {
     for (int _loop_i_ = 0; _loop_i_ == 0; test_loop_end(), _loop_i_ = 1)          \
         for ( ; _loop_i_ < N || (_loop_i_ = 0, test_time_condition(test)); ++_loop_i_)
 
+#ifdef __cplusplus
+/// like TEST_LOOP, but the granularity is chosen at runtime. The body is compiled
+/// for every power of two between MinN and MaxN (optional, defaulting to 1 and
+/// 1 << 10), so keep the range narrow, and the framework times the first
+/// iterations to select the variant whose loop takes about as long as the
+/// target duration on this CPU. The body is a lambda: it must be followed by a
+/// semicolon, break and continue do not compile in it and return only ends the
+/// current execution of the body, not the loop. The expression's value is the
+/// granularity the framework chose. C++ only.
+#  define TEST_LOOP_AUTO(test, ...)                 \
+    _TestLoopAuto<__VA_ARGS__>{test} * [&]() -> void
+#endif
+
 /// used in a test's quality_level field to signify that a test is a production test.
 #define TEST_QUALITY_PROD        100
 /// used in a test's quality_level field to signify that a test is a beta test.
@@ -153,9 +166,21 @@ typedef enum SkipCategory {
 /// used in a test's test_init function to indicate that a test should be skipped.
 #define EXIT_SKIP               -255
 
+/* ISA clones of a test (see tests/meson.build) go to a section of their own
+ * and the framework dispatches each test to the best one the CPU supports */
+#ifdef SANDSTONE_TEST_CLONE
+#  define SANDSTONE_TEST_SECTION                        "test_clones"
+#  define SANDSTONE_TEST_SYMBOL(test_id)                SANDSTONE_TEST_SYMBOL2(test_id, SANDSTONE_TEST_CLONE)
+#  define SANDSTONE_TEST_SYMBOL2(test_id, clone)        SANDSTONE_TEST_SYMBOL3(test_id, clone)
+#  define SANDSTONE_TEST_SYMBOL3(test_id, clone)        _test_ ## test_id ## _ ## clone
+#else
+#  define SANDSTONE_TEST_SECTION                        "tests"
+#  define SANDSTONE_TEST_SYMBOL(test_id)                _test_ ## test_id
+#endif
+
 #define DECLARE_TEST_INNER2(test_id, test_description) \
-    __attribute__((aligned(alignof(void*)), used, section(SANDSTONE_SECTION_PREFIX "tests"))) \
-    struct test _test_ ## test_id = {                   \
+    __attribute__((aligned(alignof(void*)), used, section(SANDSTONE_SECTION_PREFIX SANDSTONE_TEST_SECTION))) \
+    struct test SANDSTONE_TEST_SYMBOL(test_id) = {      \
         .compiler_minimum_cpu = _compilerCpuFeatures,   \
         .id = SANDSTONE_STRINGIFY(test_id),             \
         .description = test_description,
@@ -412,6 +437,7 @@ struct test {
     /* methods */
     initfunc test_preinit;        ///! called from the main thread
     initfunc test_init;                ///! called from the main thread
+    runfunc test_init_per_thread;      ///! called per CPU, before test_run and not timed
     runfunc test_run;                ///! called per CPU
     cleanupfunc test_cleanup;        ///! called from the main thread
 
@@ -615,6 +641,13 @@ extern struct cpu_info *cpu_info;
 /// restricts the number of CPUs sandstone can see.
 int num_cpus() __attribute__((pure));
 
+/// Returns the number of logical CPUs the framework is running tests on,
+/// across all slices. When the system is split into slices, each runs the
+/// same test at the same time, so tests that size a share of a system-wide
+/// resource (like the memory) should divide it by this value, not by
+/// num_cpus().
+int num_cpus_total() __attribute__((pure));
+
 /// Returns the number of physical CPU packages (a.k.a. sockets) available to a
 /// test.
 int num_packages() __attribute__((pure));
@@ -631,6 +664,57 @@ constexpr inline test_flags operator|(test_flag f1, test_flag f2)
     return test_flags(unsigned(f1) | unsigned(f2));
 }
 
+/// @internal function called by TEST_LOOP_AUTO: returns 0 while the calibration
+/// needs more iterations, or the granularity to use
+unsigned test_loop_auto_calibrate(uint64_t iterations, Duration elapsed, unsigned min_n, unsigned max_n) noexcept;
+
+template <unsigned N, unsigned MaxN, typename Body> static inline void
+_test_loop_auto_run(const struct test *test, unsigned n, Body &body)
+{
+    if constexpr (N < MaxN) {
+        if (n > N)
+            return _test_loop_auto_run<N * 2, MaxN>(test, n, body);
+    }
+    while (test_time_condition(test)) {
+        for (unsigned i = 0; i < N; ++i)
+            body();
+    }
+}
+
+/// the function form of TEST_LOOP_AUTO: runs body() until the framework asks
+/// the test to terminate, checking the time every N calls. Returns N.
+template <unsigned MinN = 1, unsigned MaxN = 1U << 10, typename Body> static inline unsigned
+test_loop_auto(const struct test *test, Body &&body)
+{
+    static_assert(MinN > 0 && (MinN & (MinN - 1)) == 0, "MinN must be a power of two");
+    static_assert(MaxN >= MinN && (MaxN & (MaxN - 1)) == 0, "MaxN must be a power of two not less than MinN");
+    test_loop_start();
+
+    // calibrate with doubling run-time counts: this is the loop's first iteration
+    MonotonicTimePoint start = std::chrono::steady_clock::now();
+    uint64_t iterations = 0;
+    unsigned n = 0;
+    for (uint64_t count = MinN; n == 0; count = count < MaxN ? count * 2 : count) {
+        for (uint64_t i = 0; i < count; ++i)
+            body();
+        iterations += count;
+        n = test_loop_auto_calibrate(iterations, std::chrono::steady_clock::now() - start, MinN, MaxN);
+    }
+
+    _test_loop_auto_run<MinN, MaxN>(test, n, body);
+    test_loop_end();
+    return n;
+}
+
+template <unsigned MinN = 1, unsigned MaxN = 1U << 10> struct _TestLoopAuto
+{
+    const struct test *test;
+    template <typename Body> unsigned operator*(Body &&body) const
+    {
+        return test_loop_auto<MinN, MaxN>(test, body);
+    }
+};
+
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wformat-security"
 template <typename T, typename... FmtArgs> [[noreturn, gnu::cold]] static inline std::enable_if_t<SandstoneDataDetails::TypeToDataType<T>::IsValid>
@@ -0,0 +1,229 @@
+/*
+ * Copyright 2024 Intel Corporation.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// PLEASE READ BEFORE EDITING:
+//     This is a clean file, meaning everyrthing in it is properly unit tested
+//     Please do not add anything to this file unless it is unit tested.
+//     All unit tests should be put in framework/unit-tests/sandstone_checksum_tests.cpp
+
+#include "sandstone_checksum.h"
+#include "sandstone.h"
+
+#include <string.h>
+
+#if defined(__x86_64__) && defined(__SSE4_2__) && defined(__PCLMUL__)
+#  include <immintrin.h>
+#  define CRC32C_HAS_HARDWARE   1
+#endif
+
+// All the functions below operate on the CRC register state, without the
+// initial and final inversions, which only the public functions apply.
+namespace {
+constexpr uint32_t Crc32cPolynomial = 0x82f63b78;      // bit-reflected 0x1edc6f41
+
+struct Crc32cTable
+{
+    uint32_t entries[256] = {};
+    constexpr Crc32cTable()
+    {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int bit = 0; bit < 8; ++bit)
+                c = (c >> 1) ^ (c & 1 ? Crc32cPolynomial : 0);
+            entries[i] = c;
+        }
+    }
+};
+constexpr Crc32cTable crc32c_lookup;
+
+uint32_t table_update(uint32_t state, const uint8_t *ptr, size_t len)
+{
+    for ( ; len; --len, ++ptr)
+        state = crc32c_lookup.entries[(state ^ *ptr) & 0xff] ^ (state >> 8);
+    return state;
+}
+
+#ifdef CRC32C_HAS_HARDWARE
+uint32_t sse42_update(uint32_t state, const uint8_t *ptr, size_t len)
+{
+    uint64_t state64 = state;
+    for ( ; len >= sizeof(uint64_t); len -= sizeof(uint64_t), ptr += sizeof(uint64_t)) {
+        uint64_t v;
+        memcpy(&v, ptr, sizeof(v));
+        state64 = _mm_crc32_u64(state64, v);
+    }
+    state = uint32_t(state64);
+    for ( ; len; --len, ++ptr)
+        state = _mm_crc32_u8(state, *ptr);
+    return state;
+}
+
+// Folding replaces a 128-bit block with one congruent to it multiplied by
+// x^D modulo the polynomial, which can then be XORed into the block D bits
+// further along without changing the CRC. The low quadword is multiplied
+// by x^(D+63) mod P and the high one by x^(D-1) mod P, both bit-reflected.
+struct FoldConstants
+{
+    uint64_t low, high;
+};
+constexpr FoldConstants Fold128 = { 0x3743f7bd00000000, 0x3171d43000000000 };
+constexpr FoldConstants Fold256 = { 0x33ccbbbc00000000, 0xa2158b3400000000 };
+constexpr FoldConstants Fold384 = { 0xa46ef4aa00000000, 0x6051243f00000000 };
+constexpr FoldConstants Fold512 = { 0x1c19243b00000000, 0x75bba45b00000000 };
+constexpr FoldConstants Fold1024 = { 0x6577b24500000000, 0x7417153f00000000 };
+constexpr FoldConstants Fold1536 = { 0x7ccbbbf200000000, 0x31c9460800000000 };
+constexpr FoldConstants Fold2048 = { 0xe9a5d8be00000000, 0x1426a81500000000 };
+
+inline __m128i fold_constants(FoldConstants k)
+{
+    return _mm_set_epi64x(k.high, k.low);
+}
+
+inline __m128i fold(__m128i v, __m128i k)
+{
+    return _mm_xor_si128(_mm_clmulepi64_si128(v, k, 0x00), _mm_clmulepi64_si128(v, k, 0x11));
+}
+
+inline __m128i load128(const uint8_t *ptr)
+{
+    return _mm_loadu_si128(reinterpret_cast<const __m128i *>(ptr));
+}
+
+// Folds the remaining full 16-byte blocks into v, then reduces v to a CRC
+// state with the CRC32 instruction (v is equivalent to a message that
+// ends where ptr points and whose CRC starts with a state of 0) and
+// finishes any trailing bytes.
+uint32_t pclmul_finish(__m128i v, const uint8_t *ptr, size_t len)
+{
+    const __m128i k128 = fold_constants(Fold128);
+    for ( ; len >= sizeof(__m128i); len -= sizeof(__m128i), ptr += sizeof(__m128i))
+        v = _mm_xor_si128(fold(v, k128), load128(ptr));
+
+    uint64_t state = _mm_crc32_u64(0, _mm_cvtsi128_si64(v));
+    state = _mm_crc32_u64(state, _mm_extract_epi64(v, 1));
+    return sse42_update(uint32_t(state), ptr, len);
+}
+
+uint32_t pclmul_update(uint32_t state, const uint8_t *ptr, size_t len)
+{
+    if (len < 2 * 4 * sizeof(__m128i))
+        return sse42_update(state, ptr, len);
+
+    // four independent accumulators, folded 512 bits at a time
+    __m128i x0 = _mm_xor_si128(load128(ptr), _mm_cvtsi32_si128(state));
+    __m128i x1 = load128(ptr + 16);
+    __m128i x2 = load128(ptr + 32);
+    __m128i x3 = load128(ptr + 48);
+    ptr += 64;
+    len -= 64;
+
+    const __m128i k512 = fold_constants(Fold512);
+    for ( ; len >= 64; len -= 64, ptr += 64) {
+        x0 = _mm_xor_si128(fold(x0, k512), load128(ptr));
+        x1 = _mm_xor_si128(fold(x1, k512), load128(ptr + 16));
+        x2 = _mm_xor_si128(fold(x2, k512), load128(ptr + 32));
+        x3 = _mm_xor_si128(fold(x3, k512), load128(ptr + 48));
+    }
+
+    x3 = _mm_xor_si128(x3, fold(x0, fold_constants(Fold384)));
+    x3 = _mm_xor_si128(x3, fold(x1, fold_constants(Fold256)));
+    x3 = _mm_xor_si128(x3, fold(x2, fold_constants(Fold128)));
+    return pclmul_finish(x3, ptr, len);
+}
+
+#define VPCLMUL_TARGET  __attribute__((target("avx512f,vpclmulqdq")))
+
+VPCLMUL_TARGET inline __m512i fold512(__m512i v, __m512i k)
+{
+    return _mm512_xor_si512(_mm512_clmulepi64_epi128(v, k, 0x00), _mm512_clmulepi64_epi128(v, k, 0x11));
+}
+
+VPCLMUL_TARGET inline __m512i fold_constants512(FoldConstants k)
+{
+    return _mm512_broadcast_i32x4(fold_constants(k));
+}
+
+VPCLMUL_TARGET uint32_t vpclmul_update(uint32_t state, const uint8_t *ptr, size_t len)
+{
+    if (len < 2 * 4 * sizeof(__m512i))
+        return pclmul_update(state, ptr, len);
+
+    // four independent accumulators of four lanes each, folded 2048 bits
+    // at a time
+    __m512i z0 = _mm512_xor_si512(_mm512_loadu_si512(ptr), _mm512_castsi128_si512(_mm_cvtsi32_si128(state)));
+    __m512i z1 = _mm512_loadu_si512(ptr + 64);
+    __m512i z2 = _mm512_loadu_si512(ptr + 128);
+    __m512i z3 = _mm512_loadu_si512(ptr + 192);
+    ptr += 256;
+    len -= 256;
+
+    const __m512i k2048 = fold_constants512(Fold2048);
+    for ( ; len >= 256; len -= 256, ptr += 256) {
+        z0 = _mm512_xor_si512(fold512(z0, k2048), _mm512_loadu_si512(ptr));
+        z1 = _mm512_xor_si512(fold512(z1, k2048), _mm512_loadu_si512(ptr + 64));
+        z2 = _mm512_xor_si512(fold512(z2, k2048), _mm512_loadu_si512(ptr + 128));
+        z3 = _mm512_xor_si512(fold512(z3, k2048), _mm512_loadu_si512(ptr + 192));
+    }
+
+    const __m512i k512 = fold_constants512(Fold512);
+    z3 = _mm512_xor_si512(z3, fold512(z0, fold_constants512(Fold1536)));
+    z3 = _mm512_xor_si512(z3, fold512(z1, fold_constants512(Fold1024)));
+    z3 = _mm512_xor_si512(z3, fold512(z2, k512));
+    for ( ; len >= 64; len -= 64, ptr += 64)
+        z3 = _mm512_xor_si512(fold512(z3, k512), _mm512_loadu_si512(ptr));
+
+    // reduce the four lanes to one
+    __m128i x = _mm512_extracti32x4_epi32(z3, 3);
+    x = _mm_xor_si128(x, fold(_mm512_castsi512_si128(z3), fold_constants(Fold384)));
+    x = _mm_xor_si128(x, fold(_mm512_extracti32x4_epi32(z3, 1), fold_constants(Fold256)));
+    x = _mm_xor_si128(x, fold(_mm512_extracti32x4_epi32(z3, 2), fold_constants(Fold128)));
+    return pclmul_finish(x, ptr, len);
+}
+#undef VPCLMUL_TARGET
+#else
+// no hardware support in this build: everything uses the table
+uint32_t sse42_update(uint32_t state, const uint8_t *ptr, size_t len)
+{
+    return table_update(state, ptr, len);
+}
+
+uint32_t pclmul_update(uint32_t state, const uint8_t *ptr, size_t len)
+{
+    return table_update(state, ptr, len);
+}
+
+uint32_t vpclmul_update(uint32_t state, const uint8_t *ptr, size_t len)
+{
+    return table_update(state, ptr, len);
+}
+#endif // CRC32C_HAS_HARDWARE
+} // unnamed namespace
+
+uint32_t crc32c_table(uint32_t crc, const void *data, size_t len)
+{
+    return ~table_update(~crc, static_cast<const uint8_t *>(data), len);
+}
+
+uint32_t crc32c_sse42(uint32_t crc, const void *data, size_t len)
+{
+    return ~sse42_update(~crc, static_cast<const uint8_t *>(data), len);
+}
+
+uint32_t crc32c_pclmul(uint32_t crc, const void *data, size_t len)
+{
+    return ~pclmul_update(~crc, static_cast<const uint8_t *>(data), len);
+}
+
+uint32_t crc32c_vpclmul(uint32_t crc, const void *data, size_t len)
+{
+    return ~vpclmul_update(~crc, static_cast<const uint8_t *>(data), len);
+}
+
+uint32_t crc32c(uint32_t crc, const void *data, size_t len)
+{
+    if (cpu_has_feature(cpu_feature_avx512f | cpu_feature_vpclmulqdq))
+        return crc32c_vpclmul(crc, data, len);
+    return crc32c_pclmul(crc, data, len);
+}
@@ -0,0 +1,44 @@
+/*
+ * Copyright 2024 Intel Corporation.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef SANDSTONE_CHECKSUM_H
+#define SANDSTONE_CHECKSUM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Computes the CRC-32C (Castagnoli) of the len bytes at data. The crc
+/// parameter is the CRC of any preceding data, or 0 to start a new
+/// checksum, so a buffer may be checksummed in pieces:
+///
+///     uint32_t crc = crc32c(0, buf, 100);
+///     crc = crc32c(crc, buf + 100, len - 100);
+///
+/// This function selects the fastest implementation for the buffer size
+/// and the features of the CPU it is running on. Tests can use it to
+/// verify large amounts of data cheaply, storing a checksum instead of a
+/// full copy of the expected results.
+uint32_t crc32c(uint32_t crc, const void *data, size_t len);
+
+/// The individual implementations of crc32c(), all producing the same
+/// results. crc32c_table() uses no special instructions;
+/// crc32c_sse42() uses the SSE 4.2 CRC32 instruction; crc32c_pclmul()
+/// folds 64 bytes at a time with PCLMULQDQ; crc32c_vpclmul() folds 256
+/// bytes at a time with 512-bit VPCLMULQDQ and must only be called if the
+/// CPU supports AVX-512F and VPCLMULQDQ.
+uint32_t crc32c_table(uint32_t crc, const void *data, size_t len);
+uint32_t crc32c_sse42(uint32_t crc, const void *data, size_t len);
+uint32_t crc32c_pclmul(uint32_t crc, const void *data, size_t len);
+uint32_t crc32c_vpclmul(uint32_t crc, const void *data, size_t len);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // SANDSTONE_CHECKSUM_H
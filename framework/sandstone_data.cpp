@@ -9,9 +9,21 @@
 //     All unit tests should be put in framework/unit-tests/sandstone_utils_tests.cpp
 
 #include "sandstone_data.h"
+#include "sandstone.h"
 
 #include <type_traits>
 
+#if defined(__x86_64__) && defined(__F16C__)
+#  include <immintrin.h>
+#  define FP16_HAS_F16C         1
+#  if __GNUC__ >= 12 || __clang_major__ >= 14
+#    define FP16_HAS_AVX512FP16 1
+#  endif
+#  if __GNUC__ >= 10 || __clang_major__ >= 9
+#    define BF16_HAS_AVX512BF16 1
+#  endif
+#endif
+
 template <typename T, typename X>
 static T bit_cast(X src)
 {
@@ -51,8 +63,9 @@ template <typename T> static inline uint16_t ieee754_downconvert(T f)
         /* infinity or NaN */
         exp = 2 * OutputLimits::max_exponent - 1;
 #if defined(__i386__) || defined(__x86_64__)
-        /* x86 always quiets any SNaN, so do the same */
-        if (mant)
+        /* x86 always quiets any SNaN, so do the same (this also keeps NaNs
+         * whose payload was only in the discarded bits as NaNs) */
+        if (v & MantissaMask)
             mant |= 1 << (OutputLimits::digits - 2);
 #endif
     } else if (exp >= OutputLimits::max_exponent) {
@@ -67,8 +80,8 @@ template <typename T> static inline uint16_t ieee754_downconvert(T f)
         mant >>= -(exp - (OutputLimits::min_exponent - 1));
         exp = 0;
     } else {
-        /* underflow or zero (including negative zero), make zero */
-        sign = exp = mant = 0;
+        /* underflow or zero, make zero of the same sign */
+        exp = mant = 0;
     }
 
     exp <<= OutputLimits::digits - 1;
@@ -104,7 +117,7 @@ template <typename T> static inline uint16_t to_bfloat16(T f)
         uint16_t r = v >> 8 * (sizeof(T) - sizeof(BFloat16));
 #if defined(__i386__) || defined(__x86_64__)
         /* x86 always quiets any SNaN, so do the same */
-        if (mant)
+        if (v & MantissaMask)
             r |= 1 << (OutputLimits::digits - 2);
 #endif
         return r;
@@ -151,7 +164,8 @@ float fromfp16_emulated(Float16 f)
         return decode_half(f.as_hex);
 
     // preserve NaN's bit pattern
-    uint32_t p = f.as_hex & ~Float16::infinity().as_hex;
+    uint32_t sign = uint32_t(f.sign) << 31;
+    uint32_t p = f.mantissa;
 
 #if defined(__i386__) || defined(__x86_64__)
     /* x86 always quiets any SNaN, so do the same */
@@ -159,7 +173,7 @@ float fromfp16_emulated(Float16 f)
 #endif
 
     p <<= std::numeric_limits<float>::digits - Float16::digits;
-    p |= bit_cast<uint32_t>(std::numeric_limits<float>::infinity());
+    p |= bit_cast<uint32_t>(std::numeric_limits<float>::infinity()) | sign;
     return bit_cast<float>(p);
 }
 
@@ -169,3 +183,131 @@ BFloat16 tobf16_emulated(float f)
     r.as_hex = to_bfloat16(f);
     return r;
 }
+
+void tofp16_bulk_emulated(Float16 *dst, const float *src, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+        dst[i] = tofp16_emulated(src[i]);
+}
+
+void fromfp16_bulk_emulated(float *dst, const Float16 *src, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+        dst[i] = fromfp16_emulated(src[i]);
+}
+
+void tobf16_bulk_emulated(BFloat16 *dst, const float *src, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+        dst[i] = tobf16_emulated(src[i]);
+}
+
+// Like tofp16(), these truncate
+void tofp16_bulk_f16c(Float16 *dst, const float *src, size_t count)
+{
+#ifdef FP16_HAS_F16C
+    size_t i = 0;
+    for ( ; i + 8 <= count; i += 8) {
+        __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TRUNC);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), h);
+    }
+    for ( ; i < count; ++i)
+        dst[i].as_hex = _cvtss_sh(src[i], _MM_FROUND_TRUNC);
+#else
+    tofp16_bulk_emulated(dst, src, count);
+#endif
+}
+
+void fromfp16_bulk_f16c(float *dst, const Float16 *src, size_t count)
+{
+#ifdef FP16_HAS_F16C
+    size_t i = 0;
+    for ( ; i + 8 <= count; i += 8) {
+        __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(h));
+    }
+    for ( ; i < count; ++i)
+        dst[i] = _cvtsh_ss(src[i].as_hex);
+#else
+    fromfp16_bulk_emulated(dst, src, count);
+#endif
+}
+
+#ifdef FP16_HAS_AVX512FP16
+__attribute__((target("avx512fp16,avx512bw,avx512vl")))
+#endif
+void tofp16_bulk_avx512fp16(Float16 *dst, const float *src, size_t count)
+{
+#ifdef FP16_HAS_AVX512FP16
+    // the tail is converted with a masked load and store
+    for (size_t i = 0; i < count; i += 16) {
+        __mmask16 mask = count - i >= 16 ? 0xffff : (1U << (count - i)) - 1;
+        __m512 v = _mm512_maskz_loadu_ps(mask, src + i);
+        __m256h h = _mm512_cvtx_roundps_ph(v, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+        _mm256_mask_storeu_epi16(dst + i, mask, _mm256_castph_si256(h));
+    }
+#else
+    tofp16_bulk_emulated(dst, src, count);
+#endif
+}
+
+#ifdef FP16_HAS_AVX512FP16
+__attribute__((target("avx512fp16,avx512bw,avx512vl")))
+#endif
+void fromfp16_bulk_avx512fp16(float *dst, const Float16 *src, size_t count)
+{
+#ifdef FP16_HAS_AVX512FP16
+    for (size_t i = 0; i < count; i += 16) {
+        __mmask16 mask = count - i >= 16 ? 0xffff : (1U << (count - i)) - 1;
+        __m256i h = _mm256_maskz_loadu_epi16(mask, src + i);
+        _mm512_mask_storeu_ps(dst + i, mask, _mm512_cvtxph_ps(_mm256_castsi256_ph(h)));
+    }
+#else
+    fromfp16_bulk_emulated(dst, src, count);
+#endif
+}
+
+#ifdef BF16_HAS_AVX512BF16
+__attribute__((target("avx512bf16,avx512bw,avx512vl")))
+#endif
+void tobf16_bulk_avx512bf16(BFloat16 *dst, const float *src, size_t count)
+{
+#ifdef BF16_HAS_AVX512BF16
+    for (size_t i = 0; i < count; i += 16) {
+        __mmask16 mask = count - i >= 16 ? 0xffff : (1U << (count - i)) - 1;
+        __m512 v = _mm512_maskz_loadu_ps(mask, src + i);
+        __m256i h = reinterpret_cast<__m256i>(_mm512_cvtneps_pbh(v));
+        _mm256_mask_storeu_epi16(dst + i, mask, h);
+    }
+#else
+    tobf16_bulk_emulated(dst, src, count);
+#endif
+}
+
+void tofp16_bulk(Float16 *dst, const float *src, size_t count)
+{
+    if (cpu_has_feature(cpu_feature_avx512fp16 | cpu_feature_avx512bw | cpu_feature_avx512vl))
+        return tofp16_bulk_avx512fp16(dst, src, count);
+    return tofp16_bulk_f16c(dst, src, count);
+}
+
+void fromfp16_bulk(float *dst, const Float16 *src, size_t count)
+{
+    if (cpu_has_feature(cpu_feature_avx512fp16 | cpu_feature_avx512bw | cpu_feature_avx512vl))
+        return fromfp16_bulk_avx512fp16(dst, src, count);
+    return fromfp16_bulk_f16c(dst, src, count);
+}
+
+void tobf16_bulk(BFloat16 *dst, const float *src, size_t count)
+{
+    if (cpu_has_feature(cpu_feature_avx512bf16 | cpu_feature_avx512bw | cpu_feature_avx512vl))
+        return tobf16_bulk_avx512bf16(dst, src, count);
+    return tobf16_bulk_emulated(dst, src, count);
+}
+
+void frombf16_bulk(float *dst, const BFloat16 *src, size_t count)
+{
+    // there's no conversion instruction to use, but this vectorizes
+    for (size_t i = 0; i < count; ++i)
+        dst[i] = frombf16_emulated(src[i]);
+}
@@ -6,6 +6,7 @@
 #ifndef SANDSTONE_DATA_H
 #define SANDSTONE_DATA_H
 
+#include <assert.h>
 #include <float.h>
 #include <math.h>
 #include <stddef.h>
@@ -18,6 +19,10 @@
 #  include <immintrin.h>
 #endif
 
+#ifdef __cplusplus
+#  include <span>
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -111,6 +116,24 @@ extern Float16 tofp16_emulated(float f);
 extern float fromfp16_emulated(Float16 f);
 extern BFloat16 tobf16_emulated(float f);
 
+/* Bulk conversions: the same results as the scalar functions, using the
+ * widest conversion instructions the CPU supports */
+extern void tofp16_bulk(Float16 *dst, const float *src, size_t count);
+extern void fromfp16_bulk(float *dst, const Float16 *src, size_t count);
+extern void tobf16_bulk(BFloat16 *dst, const float *src, size_t count);
+extern void frombf16_bulk(float *dst, const BFloat16 *src, size_t count);
+
+/* The implementations of the above, for testing: the emulated ones are
+ * the reference. Those the compiler can't generate use emulation. */
+extern void tofp16_bulk_emulated(Float16 *dst, const float *src, size_t count);
+extern void tofp16_bulk_f16c(Float16 *dst, const float *src, size_t count);
+extern void tofp16_bulk_avx512fp16(Float16 *dst, const float *src, size_t count);
+extern void fromfp16_bulk_emulated(float *dst, const Float16 *src, size_t count);
+extern void fromfp16_bulk_f16c(float *dst, const Float16 *src, size_t count);
+extern void fromfp16_bulk_avx512fp16(float *dst, const Float16 *src, size_t count);
+extern void tobf16_bulk_emulated(BFloat16 *dst, const float *src, size_t count);
+extern void tobf16_bulk_avx512bf16(BFloat16 *dst, const float *src, size_t count);
+
 static inline Float16 tofp16(float f)
 {
 #ifdef __F16C__
@@ -158,6 +181,30 @@ inline BFloat16::BFloat16(float f)
 {
 }
 
+inline void tofp16_bulk(std::span<Float16> dst, std::span<const float> src)
+{
+    assert(dst.size() >= src.size());
+    tofp16_bulk(dst.data(), src.data(), src.size());
+}
+
+inline void fromfp16_bulk(std::span<float> dst, std::span<const Float16> src)
+{
+    assert(dst.size() >= src.size());
+    fromfp16_bulk(dst.data(), src.data(), src.size());
+}
+
+inline void tobf16_bulk(std::span<BFloat16> dst, std::span<const float> src)
+{
+    assert(dst.size() >= src.size());
+    tobf16_bulk(dst.data(), src.data(), src.size());
+}
+
+inline void frombf16_bulk(std::span<float> dst, std::span<const BFloat16> src)
+{
+    assert(dst.size() >= src.size());
+    frombf16_bulk(dst.data(), src.data(), src.size());
+}
+
 namespace SandstoneDataDetails {
 enum { MaxDataTypeSize = 16 };
 
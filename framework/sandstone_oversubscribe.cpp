@@ -0,0 +1,339 @@
+/*
+ * Copyright 2024 Intel Corporation.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// With --oversubscribe=K, each logical processor runs the test's thread plus
+// K - 1 companion threads pinned to it. The companions load the vector, mask
+// and AMX tile registers with a pattern of their own, yield the CPU and check
+// that the pattern is intact when they are scheduled back in. The test threads
+// yield in test_time_condition(), so the kernel constantly saves and restores
+// different register state while the test is verifying its own.
+
+#include "sandstone_p.h"
+#include "topology.h"
+
+#ifdef __x86_64__
+#  include "amx_common.h"
+#endif
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <inttypes.h>
+#include <sched.h>
+#ifdef __linux__
+#  include <sys/syscall.h>
+#endif
+#ifdef __unix__
+#  include <sys/resource.h>
+#endif
+
+namespace {
+struct alignas(64) RegisterState
+{
+    static constexpr int TileCount = 8;
+    static constexpr int TileRows = 16;
+    uint8_t zmm[32][64];
+    uint64_t k[8];
+    uint8_t tiles[TileCount][TileRows][64];
+};
+
+enum class RegisterSet { None, Sse, Avx, Avx512 };
+
+struct Companion
+{
+    std::thread thread;
+    int cpu;
+    uint64_t switches = 0;
+
+    // first corruption found, if any
+    const char *register_name = nullptr;
+    int register_index;
+    uint64_t expected, actual;
+};
+
+std::vector<std::unique_ptr<Companion>> companions;
+std::atomic<bool> companions_stop;
+MonotonicTimePoint start_time;
+#ifdef __unix__
+struct rusage start_usage;
+#endif
+} // unnamed namespace
+
+#if defined(__linux__) && defined(__x86_64__)
+// The system call is made from inside each asm block, so no library or
+// compiler-generated code runs between loading and storing the registers.
+#  define REG_LIST_16   "0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15"
+#  define REG_LIST_32   REG_LIST_16 ",16,17,18,19,20,21,22,23,24,25,26,27,28,29,30,31"
+#  define XMM_CLOBBERS_16 \
+    "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7", \
+    "xmm8", "xmm9", "xmm10", "xmm11", "xmm12", "xmm13", "xmm14", "xmm15"
+
+static void yield_with_sse(const RegisterState *in, RegisterState *out)
+{
+    long ret = SYS_sched_yield;
+    asm volatile(".irp i," REG_LIST_16 "\n\t"
+                 "movdqa \\i*64(%[in]), %%xmm\\i\n\t"
+                 ".endr\n\t"
+                 "syscall\n\t"
+                 ".irp i," REG_LIST_16 "\n\t"
+                 "movdqa %%xmm\\i, \\i*64(%[out])\n\t"
+                 ".endr"
+                 : "+a" (ret)
+                 : [in] "r" (in->zmm), [out] "r" (out->zmm)
+                 : "rcx", "r11", "memory", XMM_CLOBBERS_16);
+}
+
+__attribute__((target("avx")))
+static void yield_with_avx(const RegisterState *in, RegisterState *out)
+{
+    long ret = SYS_sched_yield;
+    asm volatile(".irp i," REG_LIST_16 "\n\t"
+                 "vmovdqa \\i*64(%[in]), %%ymm\\i\n\t"
+                 ".endr\n\t"
+                 "syscall\n\t"
+                 ".irp i," REG_LIST_16 "\n\t"
+                 "vmovdqa %%ymm\\i, \\i*64(%[out])\n\t"
+                 ".endr\n\t"
+                 "vzeroupper"
+                 : "+a" (ret)
+                 : [in] "r" (in->zmm), [out] "r" (out->zmm)
+                 : "rcx", "r11", "memory", XMM_CLOBBERS_16);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static void yield_with_avx512(const RegisterState *in, RegisterState *out)
+{
+    long ret = SYS_sched_yield;
+    asm volatile(".irp i," REG_LIST_32 "\n\t"
+                 "vmovdqa64 \\i*64(%[in]), %%zmm\\i\n\t"
+                 ".endr\n\t"
+                 ".irp i,0,1,2,3,4,5,6,7\n\t"
+                 "kmovq \\i*8(%[kin]), %%k\\i\n\t"
+                 ".endr\n\t"
+                 "syscall\n\t"
+                 ".irp i," REG_LIST_32 "\n\t"
+                 "vmovdqa64 %%zmm\\i, \\i*64(%[out])\n\t"
+                 ".endr\n\t"
+                 ".irp i,0,1,2,3,4,5,6,7\n\t"
+                 "kmovq %%k\\i, \\i*8(%[kout])\n\t"
+                 ".endr\n\t"
+                 "vzeroupper"
+                 : "+a" (ret)
+                 : [in] "r" (in->zmm), [out] "r" (out->zmm), [kin] "r" (in->k), [kout] "r" (out->k)
+                 : "rcx", "r11", "memory", XMM_CLOBBERS_16,
+                   "xmm16", "xmm17", "xmm18", "xmm19", "xmm20", "xmm21", "xmm22", "xmm23",
+                   "xmm24", "xmm25", "xmm26", "xmm27", "xmm28", "xmm29", "xmm30", "xmm31",
+                   "k0", "k1", "k2", "k3", "k4", "k5", "k6", "k7");
+}
+
+// Nothing else in the process uses the tile registers, so they can be loaded
+// and stored outside of the asm block that makes the system call.
+static void amx_configure()
+{
+    alignas(64) static const struct amx_tileconfig cfg = {
+        .palette = 1,
+        .start_row = 0,
+        .colsb = { 64, 64, 64, 64, 64, 64, 64, 64 },
+        .rows = { 16, 16, 16, 16, 16, 16, 16, 16 },
+    };
+    asm volatile("ldtilecfg %0" : : "m" (cfg));
+}
+
+static void amx_load(const RegisterState *in)
+{
+    asm volatile(".irp i,0,1,2,3,4,5,6,7\n\t"
+                 "tileloadd \\i*1024(%0, %1, 1), %%tmm\\i\n\t"
+                 ".endr"
+                 : : "r" (in->tiles), "r" (ptrdiff_t(64)) : "memory");
+}
+
+static void amx_store(RegisterState *out)
+{
+    asm volatile(".irp i,0,1,2,3,4,5,6,7\n\t"
+                 "tilestored %%tmm\\i, \\i*1024(%0, %1, 1)\n\t"
+                 ".endr"
+                 : : "r" (out->tiles), "r" (ptrdiff_t(64)) : "memory");
+}
+
+static void amx_release()
+{
+    asm volatile("tilerelease");
+}
+
+static RegisterSet detect_register_set()
+{
+    if (cpu_has_feature(cpu_feature_avx512f | cpu_feature_avx512bw))
+        return RegisterSet::Avx512;
+    if (cpu_has_feature(cpu_feature_avx))
+        return RegisterSet::Avx;
+    return RegisterSet::Sse;
+}
+
+static bool detect_amx()
+{
+    return cpu_has_feature(cpu_feature_amx_tile);
+}
+#else
+// no way to yield without running code that may use the registers
+static RegisterSet detect_register_set()
+{
+    return RegisterSet::None;
+}
+
+static bool detect_amx()
+{
+    return false;
+}
+
+static void amx_configure() {}
+static void amx_load(const RegisterState *) {}
+static void amx_store(RegisterState *) {}
+static void amx_release() {}
+#endif
+
+static void fill_pattern(RegisterState *state, uint64_t seed)
+{
+    // a different, easily recognisable pattern on each iteration, so a
+    // restore of stale or of another thread's state is caught too
+    auto words = reinterpret_cast<uint64_t *>(state);
+    for (size_t i = 0; i < sizeof(*state) / sizeof(uint64_t); ++i) {
+        uint64_t z = seed + (i + 1) * 0x9e3779b97f4a7c15;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+        words[i] = z ^ (z >> 27);
+    }
+}
+
+static bool compare_registers(Companion *self, const char *name, int count, size_t width,
+                              const uint8_t *expected, const uint8_t *actual, size_t stride)
+{
+    for (int i = 0; i < count; ++i, expected += stride, actual += stride) {
+        for (size_t offset = 0; offset < width; offset += sizeof(uint64_t)) {
+            uint64_t e, a;
+            memcpy(&e, expected + offset, sizeof(e));
+            memcpy(&a, actual + offset, sizeof(a));
+            if (e == a)
+                continue;
+            self->register_name = name;
+            self->register_index = i;
+            self->expected = e;
+            self->actual = a;
+            return false;
+        }
+    }
+    return true;
+}
+
+static void companion_main(Companion *self, int index, RegisterSet set, bool amx)
+{
+    pin_to_logical_processor(LogicalProcessor(cpu_info[self->cpu].cpu_number), "oversubscribe");
+
+    auto in = std::make_unique<RegisterState>();
+    auto out = std::make_unique<RegisterState>();
+    if (amx)
+        amx_configure();
+
+    for (uint64_t iteration = 0; !companions_stop.load(std::memory_order_relaxed); ++iteration) {
+        fill_pattern(in.get(), (uint64_t(index) << 40) ^ iteration);
+        if (amx)
+            amx_load(in.get());
+
+        bool ok = true;
+        switch (set) {
+#if defined(__linux__) && defined(__x86_64__)
+        case RegisterSet::Avx512:
+            yield_with_avx512(in.get(), out.get());
+            ok = compare_registers(self, "zmm", 32, 64, in->zmm[0], out->zmm[0], 64) &&
+                    compare_registers(self, "k", 8, 8, reinterpret_cast<uint8_t *>(in->k),
+                                      reinterpret_cast<uint8_t *>(out->k), 8);
+            break;
+        case RegisterSet::Avx:
+            yield_with_avx(in.get(), out.get());
+            ok = compare_registers(self, "ymm", 16, 32, in->zmm[0], out->zmm[0], 64);
+            break;
+        case RegisterSet::Sse:
+            yield_with_sse(in.get(), out.get());
+            ok = compare_registers(self, "xmm", 16, 16, in->zmm[0], out->zmm[0], 64);
+            break;
+#endif
+        default:
+            sched_yield();
+            break;
+        }
+
+        if (amx) {
+            amx_store(out.get());
+            ok = ok && compare_registers(self, "tmm", RegisterState::TileCount,
+                                         sizeof(in->tiles[0]), in->tiles[0][0],
+                                         out->tiles[0][0], sizeof(in->tiles[0]));
+        }
+        ++self->switches;
+        if (!ok)
+            break;
+    }
+
+    if (amx)
+        amx_release();
+}
+
+void oversubscription_start()
+{
+    int extra = sApp->shmem->oversubscription - 1;
+    if (extra <= 0)
+        return;
+
+    RegisterSet set = detect_register_set();
+    bool amx = detect_amx();
+    companions_stop.store(false, std::memory_order_relaxed);
+    companions.reserve(num_cpus() * extra);
+    for (int i = 0; i < num_cpus() * extra; ++i) {
+        Companion *c = companions.emplace_back(std::make_unique<Companion>()).get();
+        c->cpu = i % num_cpus();
+        c->thread = std::thread(companion_main, c, i, set, amx);
+    }
+
+    start_time = MonotonicTimePoint::clock::now();
+#ifdef __unix__
+    getrusage(RUSAGE_SELF, &start_usage);
+#endif
+}
+
+void oversubscription_finish()
+{
+    if (companions.empty())
+        return;
+
+    companions_stop.store(true, std::memory_order_relaxed);
+    for (auto &c : companions)
+        c->thread.join();
+
+    // report from this thread, now that the test threads have exited too
+    uint64_t switches = 0;
+    for (auto &c : companions) {
+        switches += c->switches;
+        if (c->register_name)
+            log_message(c->cpu, SANDSTONE_LOG_ERROR "Register %s%d was corrupted across a context switch "
+                        "(companion thread, word expected 0x%016" PRIx64 ", got 0x%016" PRIx64 ")",
+                        c->register_name, c->register_index, c->expected, c->actual);
+    }
+    companions.clear();
+
+    Duration elapsed = MonotonicTimePoint::clock::now() - start_time;
+    double seconds = std::chrono::duration<double>(elapsed).count();
+#ifdef __unix__
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    long long voluntary = usage.ru_nvcsw - start_usage.ru_nvcsw;
+    long long involuntary = usage.ru_nivcsw - start_usage.ru_nivcsw;
+    log_message(-1, SANDSTONE_LOG_INFO "Oversubscribed: %d threads per CPU, %.0f context switches/s "
+                "(%lld voluntary, %lld involuntary), %" PRIu64 " companion yields",
+                sApp->shmem->oversubscription, (voluntary + involuntary) / seconds,
+                voluntary, involuntary, switches);
+#else
+    log_message(-1, SANDSTONE_LOG_INFO "Oversubscribed: %d threads per CPU, %.0f companion yields/s",
+                sApp->shmem->oversubscription, switches / seconds);
+#endif
+}
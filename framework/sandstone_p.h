@@ -39,6 +39,7 @@
 #include "topology.h"
 #include "interrupt_monitor.hpp"
 #include "thermal_monitor.hpp"
+#include "pressure_monitor.hpp"
 #include "frequency_manager.hpp"
 
 #ifndef _WIN32
@@ -263,13 +264,28 @@ namespace SandstoneBackgroundScanConstants {
 static constexpr Duration MinimumDelayBetweenTests = std::chrono::minutes(5);
 static constexpr Duration DelayBetweenTestBatch = std::chrono::hours(24);
 static constexpr Duration MaximumDelayBetweenTests = (DelayBetweenTestBatch / 2);
+static constexpr Duration PressurePollInterval = std::chrono::seconds(1);
+static constexpr Duration IdleCpuSampleInterval = std::chrono::seconds(1);
+static constexpr Duration MinimumDelayBetweenTestsPerCpu = std::chrono::hours(1);
 }
 
 struct SandstoneBackgroundScan
 {
     std::span<MonotonicTimePoint> timestamp;
+    std::span<MonotonicTimePoint> cpu_timestamp;    // indexed by OS logical processor number
     float load_idle_threshold = 0.0;
 
+    // if enabled and the system isn't idle, run short tests on the CPUs that are
+    bool idle_cpus_mode = false;
+    LogicalProcessorSet idle_cpus;
+    static constexpr float idle_cpu_threshold = 0.9;
+
+    // if PSI is available, we use it instead of loadavg
+    std::unique_ptr<PressureMonitor> pressure;
+    float duration_scale = 1.0;
+    int cgroup_weight = 0;                  // 0 = don't create a cgroup for the tests
+    static constexpr float shrunk_duration_scale = 0.5;
+
 #ifdef _WIN32
     static constexpr float load_idle_threshold_init = 0.35;
     static constexpr float load_idle_threshold_inc_val = 0.05;
@@ -387,6 +403,7 @@ struct SandstoneApplication : public InterruptMonitor, public test_the_test_data
     MonotonicTimePoint current_test_starttime;
     static constexpr auto DefaultTestDuration = std::chrono::seconds(1);
     ShortDuration current_test_duration;
+    Duration init_per_thread_time = {};     // not counted in the test's duration
     ShortDuration test_time = {};
     ShortDuration max_test_time = {};
     ShortDuration delay_between_tests = std::chrono::milliseconds(5);
@@ -454,6 +471,7 @@ struct SandstoneApplication::SharedMemory
     // test execution
     MonotonicTimePoint current_test_endtime = {};
     int current_max_loop_count = 0;
+    int oversubscription = 1;           // test threads per logical processor
     bool selftest = false;
     bool ud_on_failure = false;
     bool use_strict_runtime = false;
@@ -683,6 +701,15 @@ void random_advance_seed();
 std::string random_format_seed();
 void random_init_thread(int thread_num);
 
+/* sandstone_oversubscribe.cpp */
+void oversubscription_start();
+void oversubscription_finish();
+
+/* sandstone_slice.cpp */
+void slice_coordinator_start(int threads, int first_thread);
+void slice_coordinator_thread_finished();
+void slice_coordinator_finish();
+
 /* sandstone.cpp */
 TestResult run_one_test(int *tc, const struct test *test, SandstoneApplication::PerCpuFailures &per_cpu_fails);
 
@@ -0,0 +1,66 @@
+/*
+ * Copyright 2024 Intel Corporation.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "sandstone_slice.h"
+#include "sandstone.h"
+#include "sandstone_p.h"
+#include "slice_coordinator.hpp"
+
+#include <optional>
+
+static std::optional<SliceCoordinator> coordinator;
+static int coordinator_first_thread;
+
+void slice_coordinator_start(int threads, int first_thread)
+{
+    coordinator.emplace(threads);
+    coordinator_first_thread = first_thread;
+}
+
+void slice_coordinator_thread_finished()
+{
+    coordinator->leave();
+}
+
+void slice_coordinator_finish()
+{
+    coordinator.reset();
+}
+
+void test_slice_barrier(void)
+{
+    coordinator->barrier();
+}
+
+int test_slice_time_condition(const struct test *test)
+{
+    uint64_t keep_running = test_time_condition(test) != 0;
+    return coordinator->arrive(keep_running, SliceCoordinator::And);
+}
+
+uint64_t test_slice_reduce_sum(uint64_t value)
+{
+    return coordinator->arrive(value, SliceCoordinator::Sum);
+}
+
+uint64_t test_slice_reduce_min(uint64_t value)
+{
+    return coordinator->arrive(value, SliceCoordinator::Min);
+}
+
+uint64_t test_slice_reduce_max(uint64_t value)
+{
+    return coordinator->arrive(value, SliceCoordinator::Max);
+}
+
+void test_slice_work_begin(uint64_t count, uint64_t chunk)
+{
+    coordinator->work_begin(count, chunk);
+}
+
+int test_slice_work_next(uint64_t *begin, uint64_t *end)
+{
+    return coordinator->work_next(thread_num - coordinator_first_thread, begin, end);
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright 2024 Intel Corporation.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef SANDSTONE_SLICE_H
+#define SANDSTONE_SLICE_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct test;
+
+/// Cooperative tests: instead of each thread running its own copy of the
+/// workload, the threads of a slice can work together on one large problem
+/// (which then only needs to be in memory once per slice) and verify each
+/// other's results. The functions below are called from test_run().
+///
+/// All of them except test_slice_work_next() are collective: every thread
+/// of the slice must call them, the same number of times and in the same
+/// order. Threads that have returned from test_run() or failed are no
+/// longer waited for. A cooperative test should not use the
+/// test_schedule_sequential flag, as then each thread is its own slice.
+///
+/// Example:
+///
+///     do {
+///         uint64_t begin, end;
+///         test_slice_work_begin(count, 64);
+///         while (test_slice_work_next(&begin, &end))
+///             compute(t, begin, end);
+///         test_slice_barrier();
+///         verify(t, cpu);
+///     } while (test_slice_time_condition(test));
+
+/// Waits until all the threads of the slice have called this function.
+void test_slice_barrier(void);
+
+/// Like test_time_condition(), but the threads of the slice agree on the
+/// result: returns 1 only if all of them should keep running. Use this
+/// instead of TEST_LOOP() or test_time_condition() in cooperative tests,
+/// so no thread is left waiting at a barrier for a thread that has already
+/// stopped.
+int test_slice_time_condition(const struct test *test);
+
+/// Each thread passes a value and all receive the sum, the minimum or the
+/// maximum of the values passed by all threads.
+uint64_t test_slice_reduce_sum(uint64_t value);
+uint64_t test_slice_reduce_min(uint64_t value);
+uint64_t test_slice_reduce_max(uint64_t value);
+
+/// Starts handing out the items [0, count) to the threads of the slice,
+/// in chunks of up to chunk items. Each thread is given an even share,
+/// and threads that finish theirs steal chunks from the others'. Threads
+/// must not call this while others may still be calling
+/// test_slice_work_next() for the previous work, so put a
+/// test_slice_barrier() in between if needed.
+void test_slice_work_begin(uint64_t count, uint64_t chunk);
+
+/// Stores the next chunk of work for this thread in [*begin, *end) and
+/// returns 1, or returns 0 if all items have been handed out. This
+/// function is not collective.
+int test_slice_work_next(uint64_t *begin, uint64_t *end);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // SANDSTONE_SLICE_H
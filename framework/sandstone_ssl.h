@@ -757,6 +757,8 @@
     F(EVP_CIPHER_CTX_set_key_length)             \
     F(EVP_CIPHER_CTX_set_padding)                \
     /*F(EVP_CIPHER_CTX_type)*/                   \
+    F(EVP_CIPHER_fetch)                          \
+    F(EVP_CIPHER_free)                           \
     F(EVP_CipherFinal_ex)                        \
     F(EVP_CipherFinal)                           \
     F(EVP_CIPHER_flags)                          \
@@ -19,8 +19,20 @@ extern constexpr struct test_group group_compression = {
                "Tests that drive compression routines in various libraries"),
 };
 
+TEST_GROUP_ATTRIBUTES
+extern constexpr struct test_group group_crypto = {
+    TEST_GROUP("crypto",
+               "Tests that drive cryptographic routines in various libraries"),
+};
+
 TEST_GROUP_ATTRIBUTES
 extern constexpr struct test_group group_math = {
     TEST_GROUP("math",
                "Tests that perform math using, e.g., Eigen"),
 };
+
+TEST_GROUP_ATTRIBUTES
+extern constexpr struct test_group group_memory = {
+    TEST_GROUP("memory",
+               "Tests that stress the memory subsystem"),
+};
@@ -13,7 +13,9 @@ extern "C" {
 struct test_group;
 extern const struct test_group
         group_compression,
-        group_math;
+        group_crypto,
+        group_math,
+        group_memory;
 
 #ifdef __cplusplus
 }
@@ -54,6 +54,11 @@ __attribute__((weak)) extern const struct test_group __start_test_group;
 __attribute__((weak)) extern const struct test_group __stop_test_group;
 
 inline std::span<struct test> regular_tests = { &__start_tests, &__stop_tests };
+
+// ISA-specific clones of some of the regular tests (may be empty)
+__attribute__((weak)) extern struct test __start_test_clones;
+__attribute__((weak)) extern struct test __stop_test_clones;
+inline std::span<struct test> test_clones = { &__start_test_clones, &__stop_test_clones };
 extern const std::span<struct test> selftests;
 
 }
@@ -10,6 +10,10 @@
 /* Define dummy setup struct that can be used by unittests when needed */
 struct cpu_info *cpu_info = nullptr;
 
+/* Define dummy cpu features: only what the compiler guarantees */
+uint64_t cpu_features = 0;
+
 /* Define dummy number of dummy cpus */
 int num_cpus() { return UNITTESTS_NUM_CPUS; }
+int num_cpus_total() { return UNITTESTS_NUM_CPUS; }
 
@@ -0,0 +1,52 @@
+#!/usr/bin/env python3
+# Copyright 2024 Intel Corporation.
+# SPDX-License-Identifier: Apache-2.0
+
+arguments_desc="""
+Arguments are (in order, all required):
+  - the name of the static library to generate;
+  - the clone's name (the suffix of its test symbols, e.g. skx);
+  - the objcopy program;
+  - the ar program;
+  - the static library with the clone's objects;
+  - the compiler command to link with, as the remaining arguments.
+
+The clone's objects are linked into one relocatable object and every symbol
+in it other than the tests (_test_<id>_<clone>) is made local. Otherwise,
+inline functions and template instantiations compiled for the clone's ISA
+would be weak or COMDAT definitions shared with the base build and the
+linker could pick the clone's copy for code that runs on any CPU.
+"""
+
+import os
+import subprocess
+import sys
+
+# print usage
+def usage():
+    name = os.path.basename(sys.argv[0])
+    print(f'Usage: {name} [ARGS]')
+    print(arguments_desc)
+
+def main():
+    if len(sys.argv) < 7:
+        usage()
+        exit(2)
+    output, clone, objcopy, ar, archive = sys.argv[1:6]
+    linker = sys.argv[6:]
+    obj = os.path.splitext(output)[0] + '.o'
+
+    # resolve the COMDAT groups now, so the final link can't discard the
+    # clone's copies in favour of the base build's
+    subprocess.check_call(linker + [ '-r', '-nostdlib', '-Wl,--force-group-allocation',
+                                     '-Wl,--whole-archive', archive, '-Wl,--no-whole-archive',
+                                     '-o', obj ])
+    subprocess.check_call([ objcopy, '--wildcard', f'--keep-global-symbol=_test_*_{clone}', obj ])
+
+    if os.path.exists(output):
+        os.remove(output)
+    subprocess.check_call([ ar, 'rcs', output, obj ])
+    exit(0)
+
+if __name__ == '__main__':
+    main()
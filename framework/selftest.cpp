@@ -26,6 +26,7 @@
 #include "sandstone_kvm.h"
 #endif // _WIN32
 #include "sandstone_p.h"
+#include "sandstone_slice.h"
 
 #include <exception>
 #include <unordered_map>
@@ -80,6 +81,85 @@ static int selftest_timedpass_run(struct test *test, int cpu)
     return EXIT_SUCCESS;
 }
 
+static int selftest_loop_auto_run(struct test *test, int cpu)
+{
+    // each iteration is much shorter than the target loop duration of 10 ms,
+    // so the framework must pick a granularity above 1; each takes at least
+    // 100 us, so no more than 64 fit
+    uint64_t count = 0;
+    unsigned granularity = TEST_LOOP_AUTO(test) {
+        usleep(100);
+        ++count;
+    };
+    if (granularity < 2 || granularity > 64)
+        report_fail_msg("Loop granularity is %u, expected between 2 and 64", granularity);
+    if (count < granularity)
+        report_fail_msg("Loop body ran %" PRIu64 " times, fewer than one loop of %u", count, granularity);
+    return EXIT_SUCCESS;
+}
+
+static int selftest_slice_cooperative_run(struct test *test, int cpu)
+{
+    // the threads sum 0 to N-1 together, each summing the chunks it gets;
+    // one sum is quick, so do several between the time checks
+    constexpr uint64_t N = 1024 * 1024;
+    constexpr int RoundsPerLoop = 32;
+    do {
+        for (int round = 0; round < RoundsPerLoop; ++round) {
+            uint64_t begin, end, sum = 0, items = 0;
+            test_slice_work_begin(N, 4096);
+            while (test_slice_work_next(&begin, &end)) {
+                for (uint64_t i = begin; i < end; ++i)
+                    sum += i;
+                items += end - begin;
+            }
+            if (uint64_t total = test_slice_reduce_sum(items); total != N)
+                report_fail_msg("Threads processed %" PRIu64 " items, expected %" PRIu64, total, N);
+            if (uint64_t total = test_slice_reduce_sum(sum); total != N * (N - 1) / 2)
+                report_fail_msg("Sum was %" PRIu64 ", expected %" PRIu64, total, N * (N - 1) / 2);
+            test_slice_barrier();
+        }
+    } while (test_slice_time_condition(test));
+    return EXIT_SUCCESS;
+}
+
+static int selftest_slice_cooperative_fail_run(struct test *test, int cpu)
+{
+    // the other threads must not wait forever for the failed one
+    if (cpu == num_cpus() - 1)
+        report_fail_msg("Failing before the first barrier");
+    return selftest_slice_cooperative_run(test, cpu);
+}
+
+static int selftest_init_per_thread_init(struct test *test, int cpu)
+{
+    // longer than 25% of the default duration: if this counted towards the
+    // test's time, test_the_test would complain of overtime
+    usleep(300'000);
+    test->per_thread[cpu].data = reinterpret_cast<void *>(uintptr_t(cpu) + 1);
+    return EXIT_SUCCESS;
+}
+
+static int selftest_init_per_thread_run(struct test *test, int cpu)
+{
+    auto expected = reinterpret_cast<void *>(uintptr_t(cpu) + 1);
+    if (test->per_thread[cpu].data != expected)
+        report_fail_msg("Per-thread init did not run on this thread (data is %p)", test->per_thread[cpu].data);
+    return selftest_timedpass_run<10'000>(test, cpu);
+}
+
+static int selftest_skip_init_per_thread(struct test *test, int cpu)
+{
+    log_info("Requesting skip from per-thread init (this is a skip message)");
+    return EXIT_SKIP;
+}
+
+static int selftest_failinit_per_thread(struct test *test, int cpu)
+{
+    // only the last thread fails; the others must still run
+    return cpu == num_cpus() - 1 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
 template <useconds_t Usecs>
 static int selftest_timedpass_whileloop_run(struct test *test, int cpu)
 {
@@ -897,6 +977,33 @@ static struct test selftests_array[] = {
     .groups = DECLARE_TEST_GROUPS(&group_positive),
     .test_run = selftest_timedpass_run<10'000>,
 },
+{
+    .id = "selftest_loop_auto",
+    .description = "Loops around a short usleep() using TEST_LOOP_AUTO",
+    .groups = DECLARE_TEST_GROUPS(&group_positive),
+    .test_run = selftest_loop_auto_run,
+},
+{
+    .id = "selftest_slice_cooperative",
+    .description = "Sums a range with the slice's threads cooperating",
+    .groups = DECLARE_TEST_GROUPS(&group_positive),
+    .test_run = selftest_slice_cooperative_run,
+},
+{
+    .id = "selftest_init_per_thread",
+    .description = "Prepares per-thread data in parallel, outside of the test's time",
+    .groups = DECLARE_TEST_GROUPS(&group_positive),
+    .test_init_per_thread = selftest_init_per_thread_init,
+    .test_run = selftest_init_per_thread_run,
+},
+{
+    .id = "selftest_skip_init_per_thread",
+    .description = "Skips by returning EXIT_SKIP from the per-thread init function",
+    .groups = DECLARE_TEST_GROUPS(&group_positive),
+    .test_init_per_thread = selftest_skip_init_per_thread,
+    .test_run = selftest_failinit_run,
+    .desired_duration = -1,
+},
 {
     .id = "selftest_logs",
     .description = "Adds some debug, info and warning messages",
@@ -1230,6 +1337,12 @@ static struct test selftests_array[] = {
     .test_run = selftest_fail_run,
     .desired_duration = -1,
 },
+{
+    .id = "selftest_slice_cooperative_fail",
+    .description = "Fails one thread of a cooperative test",
+    .groups = DECLARE_TEST_GROUPS(&group_negative),
+    .test_run = selftest_slice_cooperative_fail_run,
+},
 {
     .id = "selftest_failinit",
     .description = "Fails in the init function",
@@ -1238,6 +1351,13 @@ static struct test selftests_array[] = {
     .test_run = selftest_failinit_run,
     .desired_duration = -1,
 },
+{
+    .id = "selftest_failinit_per_thread",
+    .description = "Fails in the per-thread init function of the last thread",
+    .groups = DECLARE_TEST_GROUPS(&group_negative),
+    .test_init_per_thread = selftest_failinit_per_thread,
+    .test_run = selftest_timedpass_run<10'000>,
+},
 {
     .id = "selftest_fail_cleanup",
     .description = "Fails in the cleanup function",
@@ -0,0 +1,166 @@
+/*
+ * Copyright 2024 Intel Corporation.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef SANDSTONE_SLICE_COORDINATOR_HPP
+#define SANDSTONE_SLICE_COORDINATOR_HPP
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+// Synchronizes the threads of one slice running a cooperative test. All
+// operations other than leave() are collective unless noted: every thread
+// still running the test must call them, in the same order. Threads that
+// leave() (because test_run() returned or the thread failed) stop being
+// waited for, so one failing thread can't deadlock the others.
+class SliceCoordinator
+{
+public:
+    enum ReduceOp { Sum, Min, Max, And };
+
+    explicit SliceCoordinator(int threads)
+        : ranges(new Range[threads]), thread_count(threads), active(threads)
+    {
+    }
+
+    SliceCoordinator(const SliceCoordinator &) = delete;
+    SliceCoordinator &operator=(const SliceCoordinator &) = delete;
+
+    int threads() const { return thread_count; }
+
+    // Not collective: called once by each thread when it's done
+    void leave()
+    {
+        std::unique_lock lock(mutex);
+        --active;
+        if (arrived && arrived == active) {
+            if (completion)
+                completion();
+            complete(lock);
+        }
+    }
+
+    // Waits for all active threads; all receive the reduction of the
+    // values they passed
+    uint64_t arrive(uint64_t value, ReduceOp op)
+    {
+        return arrive(value, op, nullptr);
+    }
+
+    void barrier()
+    {
+        arrive(0, Sum);
+    }
+
+    // Divides [0, count) evenly among all threads, including those that
+    // have left, so their share gets stolen by the others
+    void work_begin(uint64_t count, uint64_t chunk)
+    {
+        arrive(0, Sum, [&] {
+            work_chunk = std::max(chunk, uint64_t(1));
+            for (int i = 0; i < thread_count; ++i) {
+                std::lock_guard range_lock(ranges[i].mutex);
+                ranges[i].begin = count * i / thread_count;
+                ranges[i].end = count * (i + 1) / thread_count;
+            }
+        });
+    }
+
+    // Not collective: takes the next chunk of this thread's share, or
+    // steals from the end of another thread's. Returns false when all the
+    // work has been handed out.
+    bool work_next(int thread, uint64_t *begin, uint64_t *end)
+    {
+        if (take(ranges[thread], false, begin, end))
+            return true;
+        for (int i = 1; i < thread_count; ++i) {
+            if (take(ranges[(thread + i) % thread_count], true, begin, end))
+                return true;
+        }
+        return false;
+    }
+
+private:
+    struct alignas(64) Range
+    {
+        std::mutex mutex;
+        uint64_t begin = 0;
+        uint64_t end = 0;
+    };
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::unique_ptr<Range[]> ranges;
+    std::function<void()> completion;
+    uint64_t work_chunk = 1;
+    uint64_t generation = 0;
+    uint64_t accumulator = 0;
+    uint64_t result = 0;
+    int thread_count;
+    int active;
+    int arrived = 0;
+
+    // the completion runs in the last thread to arrive, before any is released
+    uint64_t arrive(uint64_t value, ReduceOp op, std::function<void()> on_complete)
+    {
+        std::unique_lock lock(mutex);
+        completion = std::move(on_complete);
+        accumulator = arrived ? reduce(accumulator, value, op) : value;
+
+        if (++arrived == active) {
+            if (completion)
+                completion();
+            return complete(lock);
+        }
+
+        uint64_t my_generation = generation;
+        cv.wait(lock, [&] { return generation != my_generation; });
+        return result;
+    }
+
+    uint64_t complete(std::unique_lock<std::mutex> &)
+    {
+        result = accumulator;
+        completion = nullptr;
+        arrived = 0;
+        ++generation;
+        cv.notify_all();
+        return result;
+    }
+
+    static uint64_t reduce(uint64_t a, uint64_t b, ReduceOp op)
+    {
+        switch (op) {
+        case Sum:   return a + b;
+        case Min:   return std::min(a, b);
+        case Max:   return std::max(a, b);
+        case And:   return a & b;
+        }
+        return a;
+    }
+
+    bool take(Range &r, bool steal, uint64_t *begin, uint64_t *end)
+    {
+        std::lock_guard lock(r.mutex);
+        if (r.begin == r.end)
+            return false;
+        uint64_t n = std::min(work_chunk, r.end - r.begin);
+        if (steal) {
+            r.end -= n;
+            *begin = r.end;
+        } else {
+            *begin = r.begin;
+            r.begin += n;
+        }
+        *end = *begin + n;
+        return true;
+    }
+};
+
+#endif // SANDSTONE_SLICE_COORDINATOR_HPP
@@ -0,0 +1 @@
+#include "../generic/pressure_monitor.hpp"
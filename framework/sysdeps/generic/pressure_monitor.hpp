@@ -0,0 +1,31 @@
+/*
+ * Copyright 2024 Intel Corporation.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef SANDSTONE_GENERIC_PRESSURE_MONITOR_HPP
+#define SANDSTONE_GENERIC_PRESSURE_MONITOR_HPP
+
+#include <vector>
+
+#include <sys/types.h>
+
+// Placeholder NULL pattern here
+class PressureMonitor {
+public:
+    enum Verdict { Admit, Shrink, Abort };
+    struct CpuTimes {};
+    struct Sample {};
+
+    bool works() const { return false; }
+    Sample sample() { return {}; }
+    static float pressure_ratio(const Sample &, int, float = 1.0) { return 0; }
+    static Verdict verdict(float) { return Admit; }
+    std::vector<CpuTimes> read_cpu_times() const { return {}; }
+    static std::vector<int> idle_cpus(const std::vector<CpuTimes> &, const std::vector<CpuTimes> &, float)
+    { return {}; }
+    bool create_test_cgroup(int) { return false; }
+    bool move_to_test_cgroup(pid_t) { return false; }
+};
+
+#endif // SANDSTONE_GENERIC_PRESSURE_MONITOR_HPP
@@ -0,0 +1,270 @@
+/*
+ * Copyright 2024 Intel Corporation.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef SANDSTONE_LINUX_PRESSURE_MONITOR_HPP
+#define SANDSTONE_LINUX_PRESSURE_MONITOR_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <glob.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define DEFAULT_PROC_ROOT       "/proc"
+#define DEFAULT_CGROUP2_ROOT    "/sys/fs/cgroup"
+
+// Measures how busy the rest of the host is, using the kernel's Pressure
+// Stall Information and the CPU usage of the other top-level cgroup v2
+// slices (the host's workload), so the background scan can get out of the way.
+class PressureMonitor {
+public:
+    enum Verdict { Admit, Shrink, Abort };
+
+    struct CpuTimes {
+        int cpu;                    // OS logical processor number
+        long long idle;             // in USER_HZ ticks
+        long long total;
+    };
+
+    struct Sample {
+        float cpu_some = std::numeric_limits<float>::quiet_NaN();       // % of time, last 10 s
+        float memory_some = std::numeric_limits<float>::quiet_NaN();    // % of time, last 10 s
+        float workload_cpus = std::numeric_limits<float>::quiet_NaN();  // CPUs in use since last sample
+    };
+
+    // Values at which we stop testing; at half of them, we run shorter tests.
+    static constexpr float CpuPressureLimit = 10.0;
+    static constexpr float MemoryPressureLimit = 5.0;
+    static constexpr float WorkloadUsageLimit = 0.5;    // fraction of the CPUs
+
+    explicit PressureMonitor(const std::string &proc_root = DEFAULT_PROC_ROOT,
+                             const std::string &cgroup_root = DEFAULT_CGROUP2_ROOT)
+        : proc_root(proc_root), cgroup_root(cgroup_root)
+    {
+        has_psi = access((proc_root + "/pressure/cpu").c_str(), R_OK) == 0;
+        discover_workload_cgroups();
+    }
+
+    ~PressureMonitor()
+    {
+        if (test_cgroup_procs_fd >= 0)
+            close(test_cgroup_procs_fd);
+    }
+
+    PressureMonitor(const PressureMonitor &) = delete;
+    PressureMonitor &operator=(const PressureMonitor &) = delete;
+
+    bool works() const { return has_psi; }
+    const std::vector<std::string> &workload_cgroups() const { return workload_cpu_stat_files; }
+
+    Sample sample(std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now())
+    {
+        Sample s;
+        s.cpu_some = read_psi_some_avg10(proc_root + "/pressure/cpu");
+        s.memory_some = read_psi_some_avg10(proc_root + "/pressure/memory");
+
+        long long usage = 0;
+        for (const std::string &file : workload_cpu_stat_files) {
+            long long u = read_cpu_stat_usage(file);
+            if (u >= 0)
+                usage += u;
+        }
+        if (!workload_cpu_stat_files.empty() && last_sample_time != decltype(now){}) {
+            auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(now - last_sample_time);
+            if (elapsed.count() > 0)
+                s.workload_cpus = float(usage - last_workload_usage) / elapsed.count();
+        }
+        last_workload_usage = usage;
+        last_sample_time = now;
+        return s;
+    }
+
+    // Returns the highest of the sample's values relative to its limit, with
+    // the limits multiplied by scale. Values we couldn't read are ignored.
+    static float pressure_ratio(const Sample &s, int cpu_count, float scale = 1.0)
+    {
+        float ratio = 0;
+        auto add = [&](float value, float limit) {
+            if (!isnan(value))
+                ratio = std::max(ratio, value / (limit * scale));
+        };
+        add(s.cpu_some, CpuPressureLimit);
+        add(s.memory_some, MemoryPressureLimit);
+        add(s.workload_cpus / cpu_count, WorkloadUsageLimit);
+        return ratio;
+    }
+
+    static Verdict verdict(float ratio)
+    {
+        if (ratio < 0.5)
+            return Admit;
+        if (ratio < 1.0)
+            return Shrink;
+        return Abort;
+    }
+
+    // Returns the per-CPU lines of /proc/stat
+    std::vector<CpuTimes> read_cpu_times() const
+    {
+        std::vector<CpuTimes> result;
+        std::ifstream in(proc_root + "/stat");
+        std::string line;
+        while (getline(in, line)) {
+            // cpuN user nice system idle iowait irq softirq steal
+            // (skipping the aggregate "cpu " line)
+            if (line.size() < 4 || !line.starts_with("cpu") || !isdigit(line[3]))
+                continue;
+            int cpu;
+            long long user, nice, system, idle, iowait, irq, softirq, steal;
+            if (sscanf(line.c_str(), "cpu%d %lld %lld %lld %lld %lld %lld %lld %lld", &cpu,
+                       &user, &nice, &system, &idle, &iowait, &irq, &softirq, &steal) != 9)
+                continue;
+            long long total = user + nice + system + idle + iowait + irq + softirq + steal;
+            result.push_back({ cpu, idle + iowait, total });
+        }
+        return result;
+    }
+
+    // Returns the CPUs that were idle for at least min_idle of the time
+    // between the two readings
+    static std::vector<int> idle_cpus(const std::vector<CpuTimes> &before,
+                                      const std::vector<CpuTimes> &after, float min_idle)
+    {
+        std::vector<int> result;
+        for (const CpuTimes &a : after) {
+            auto b = std::find_if(before.begin(), before.end(),
+                                  [&](const CpuTimes &b) { return b.cpu == a.cpu; });
+            if (b == before.end() || a.total <= b->total)
+                continue;
+            if (float(a.idle - b->idle) / (a.total - b->total) >= min_idle)
+                result.push_back(a.cpu);
+        }
+        return result;
+    }
+
+    // Moves this process to a "control" leaf of its cgroup and creates a
+    // sibling "tests" leaf with the given cpu.weight, for the children.
+    bool create_test_cgroup(int weight)
+    {
+        std::string self = cgroup_root + own_cgroup(proc_root);
+        std::string control = self + "/sandstone-control";
+        std::string tests = self + "/sandstone-tests";
+
+        // cgroup v2 doesn't allow processes in non-leaf cgroups with
+        // controllers enabled, so we must move ourselves out first
+        if (mkdir(control.c_str(), 0755) < 0 && errno != EEXIST)
+            return false;
+        if (!write_file(control + "/cgroup.procs", "0"))
+            return false;
+        if (!write_file(self + "/cgroup.subtree_control", "+cpu"))
+            return false;
+        if (mkdir(tests.c_str(), 0755) < 0 && errno != EEXIST)
+            return false;
+        if (!write_file(tests + "/cpu.weight", std::to_string(weight)))
+            return false;
+
+        test_cgroup_procs_fd = open((tests + "/cgroup.procs").c_str(), O_WRONLY | O_CLOEXEC);
+        return test_cgroup_procs_fd >= 0;
+    }
+
+    bool move_to_test_cgroup(pid_t pid)
+    {
+        if (test_cgroup_procs_fd < 0)
+            return false;
+        std::string s = std::to_string(pid);
+        return pwrite(test_cgroup_procs_fd, s.data(), s.size(), 0) == ssize_t(s.size());
+    }
+
+    // Parses the "some" line of a PSI file:
+    //   some avg10=1.23 avg60=0.50 avg300=0.10 total=123456
+    static float read_psi_some_avg10(const std::string &file)
+    {
+        std::ifstream in(file);
+        std::string line;
+        while (getline(in, line)) {
+            float avg10;
+            if (sscanf(line.c_str(), "some avg10=%f", &avg10) == 1)
+                return avg10;
+        }
+        return std::numeric_limits<float>::quiet_NaN();
+    }
+
+    // Returns usage_usec from a cgroup v2 cpu.stat file, or -1
+    static long long read_cpu_stat_usage(const std::string &file)
+    {
+        std::ifstream in(file);
+        std::string key;
+        long long value;
+        while (in >> key >> value) {
+            if (key == "usage_usec")
+                return value;
+        }
+        return -1;
+    }
+
+    // Returns the cgroup v2 path of this process, from /proc/self/cgroup:
+    //   0::/system.slice/opendcdiag.service
+    static std::string own_cgroup(const std::string &proc_root)
+    {
+        std::ifstream in(proc_root + "/self/cgroup");
+        std::string line;
+        while (getline(in, line)) {
+            if (line.starts_with("0::"))
+                return line.substr(3);
+        }
+        return "/";
+    }
+
+private:
+    std::string proc_root;
+    std::string cgroup_root;
+    std::vector<std::string> workload_cpu_stat_files;
+    std::chrono::steady_clock::time_point last_sample_time = {};
+    long long last_workload_usage = 0;
+    int test_cgroup_procs_fd = -1;
+    bool has_psi = false;
+
+    void discover_workload_cgroups()
+    {
+        // every top-level slice except the one we're running in
+        std::string self = own_cgroup(proc_root);
+        std::string own_slice = self.substr(0, self.find('/', 1));
+
+        glob_t glob_results;
+        if (glob((cgroup_root + "/*.slice").c_str(), GLOB_ONLYDIR, nullptr, &glob_results) != 0)
+            return;
+        for (size_t i = 0; i < glob_results.gl_pathc; ++i) {
+            std::string dir = glob_results.gl_pathv[i];
+            if (dir.ends_with(own_slice))
+                continue;
+            if (access((dir + "/cpu.stat").c_str(), R_OK) == 0)
+                workload_cpu_stat_files.push_back(dir + "/cpu.stat");
+        }
+        globfree(&glob_results);
+    }
+
+    static bool write_file(const std::string &file, const std::string &contents)
+    {
+        int fd = open(file.c_str(), O_WRONLY | O_CLOEXEC);
+        if (fd < 0)
+            return false;
+        bool ok = write(fd, contents.data(), contents.size()) == ssize_t(contents.size());
+        close(fd);
+        return ok;
+    }
+};
+
+#endif // SANDSTONE_LINUX_PRESSURE_MONITOR_HPP
@@ -0,0 +1,137 @@
+/*
+ * Copyright 2024 Intel Corporation.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "gtest/gtest.h"
+#include "sysdeps/linux/pressure_monitor.hpp"
+
+using namespace std::chrono_literals;
+
+namespace LinuxTesting {
+    class LinuxPressureFixture : public ::testing::Test {
+    public:
+        std::string fake_root_dir;
+        std::string fake_proc_dir;
+        std::string fake_cgroup_dir;
+
+        void write_fake_file(const std::string &path, const std::string &contents) {
+            system(("mkdir -p " + path.substr(0, path.rfind('/'))).c_str());
+            system(("printf '" + contents + "' > " + path).c_str());
+        }
+
+        void setup_fake_psi(const std::string &resource, const std::string &some_avg10) {
+            write_fake_file(fake_proc_dir + "pressure/" + resource,
+                            "some avg10=" + some_avg10 + " avg60=0.00 avg300=0.00 total=1234\\n"
+                            "full avg10=0.00 avg60=0.00 avg300=0.00 total=0\\n");
+        }
+
+        void setup_fake_cpu_stat(const std::string &cgroup, long long usage_usec) {
+            write_fake_file(fake_cgroup_dir + cgroup + "/cpu.stat",
+                            "usage_usec " + std::to_string(usage_usec) + "\\n"
+                            "user_usec 0\\nsystem_usec 0\\n");
+        }
+
+        void SetUp() override {
+            fake_root_dir = "/tmp/sandstone_unittest_pressure_" + std::to_string(getpid()) + "/";
+            fake_proc_dir = fake_root_dir + "proc/";
+            fake_cgroup_dir = fake_root_dir + "cgroup/";
+            system(("rm -rf " + fake_root_dir).c_str());  // Clean out old results if present
+            write_fake_file(fake_proc_dir + "self/cgroup", "0::/system.slice/opendcdiag.service\\n");
+        }
+
+        void TearDown() override {
+            system(("rm -rf " + fake_root_dir).c_str());
+        }
+    };
+
+
+    TEST_F(LinuxPressureFixture, GivenNoPsiFiles_ThenItDoesNotWork) {
+        PressureMonitor monitor(fake_proc_dir, fake_cgroup_dir);
+        ASSERT_FALSE(monitor.works());
+    }
+
+
+    TEST_F(LinuxPressureFixture, CanReadTheSomeLineOfPsiFiles) {
+        setup_fake_psi("cpu", "12.50");
+        setup_fake_psi("memory", "0.25");
+
+        PressureMonitor monitor(fake_proc_dir, fake_cgroup_dir);
+        ASSERT_TRUE(monitor.works());
+
+        PressureMonitor::Sample s = monitor.sample();
+        ASSERT_FLOAT_EQ(s.cpu_some, 12.5);
+        ASSERT_FLOAT_EQ(s.memory_some, 0.25);
+    }
+
+
+    TEST_F(LinuxPressureFixture, GivenWeRunInASlice_ThenItIsNotConsideredWorkload) {
+        setup_fake_cpu_stat("system.slice", 0);
+        setup_fake_cpu_stat("machine.slice", 0);
+        setup_fake_cpu_stat("user.slice", 0);
+
+        PressureMonitor monitor(fake_proc_dir, fake_cgroup_dir);
+        auto cgroups = monitor.workload_cgroups();
+        ASSERT_EQ(cgroups.size(), 2);
+        for (const std::string &file : cgroups)
+            ASSERT_EQ(file.find("system.slice"), std::string::npos);
+    }
+
+
+    TEST_F(LinuxPressureFixture, WorkloadUsageIsTheDeltaBetweenSamples) {
+        setup_fake_psi("cpu", "0.00");
+        setup_fake_cpu_stat("machine.slice", 1000000);
+        setup_fake_cpu_stat("user.slice", 0);
+
+        PressureMonitor monitor(fake_proc_dir, fake_cgroup_dir);
+        auto start = std::chrono::steady_clock::time_point{} + 1h;
+
+        // first sample has nothing to compare to
+        ASSERT_TRUE(isnan(monitor.sample(start).workload_cpus));
+
+        // 3 CPU-seconds over 2 seconds
+        setup_fake_cpu_stat("machine.slice", 3000000);
+        setup_fake_cpu_stat("user.slice", 1000000);
+        ASSERT_FLOAT_EQ(monitor.sample(start + 2s).workload_cpus, 1.5);
+    }
+
+
+    TEST_F(LinuxPressureFixture, IdleCpusAreThoseMostlyIdleBetweenReadings) {
+        write_fake_file(fake_proc_dir + "stat",
+                        "cpu  400 0 0 400 0 0 0 0 0 0\n"
+                        "cpu0 100 0 0 100 0 0 0 0 0 0\n"
+                        "cpu1 100 0 0 100 0 0 0 0 0 0\n"
+                        "cpu4 100 0 0 100 0 0 0 0 0 0\n"
+                        "intr 12345\n");
+        PressureMonitor monitor(fake_proc_dir, fake_cgroup_dir);
+        auto before = monitor.read_cpu_times();
+        ASSERT_EQ(before.size(), 3);
+        ASSERT_EQ(before[2].cpu, 4);
+
+        // cpu0 was busy, cpu1 was idle (including iowait), cpu4 was idle
+        write_fake_file(fake_proc_dir + "stat",
+                        "cpu  400 0 0 400 0 0 0 0 0 0\n"
+                        "cpu0 200 0 0 100 0 0 0 0 0 0\n"
+                        "cpu1 100 0 0 180 20 0 0 0 0 0\n"
+                        "cpu4 105 0 0 200 0 0 0 0 0 0\n");
+        auto after = monitor.read_cpu_times();
+        ASSERT_EQ(PressureMonitor::idle_cpus(before, after, 0.9), std::vector({1, 4}));
+    }
+
+
+    TEST_F(LinuxPressureFixture, VerdictDependsOnTheWorstRatio) {
+        PressureMonitor::Sample s;
+        s.cpu_some = PressureMonitor::CpuPressureLimit / 4;
+        ASSERT_EQ(PressureMonitor::verdict(PressureMonitor::pressure_ratio(s, 4)), PressureMonitor::Admit);
+
+        s.memory_some = PressureMonitor::MemoryPressureLimit * 3 / 4;
+        ASSERT_EQ(PressureMonitor::verdict(PressureMonitor::pressure_ratio(s, 4)), PressureMonitor::Shrink);
+
+        s.workload_cpus = 4 * PressureMonitor::WorkloadUsageLimit;
+        ASSERT_EQ(PressureMonitor::verdict(PressureMonitor::pressure_ratio(s, 4)), PressureMonitor::Abort);
+
+        // the limits are relaxed by the scale
+        ASSERT_EQ(PressureMonitor::verdict(PressureMonitor::pressure_ratio(s, 4, 4.0)), PressureMonitor::Admit);
+    }
+
+}
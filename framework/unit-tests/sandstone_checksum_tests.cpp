@@ -0,0 +1,95 @@
+/*
+ * Copyright 2024 Intel Corporation.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "gtest/gtest.h"
+#include "sandstone_checksum.h"
+
+#include <string.h>
+
+#include <random>
+#include <vector>
+
+using Crc32cFunction = uint32_t (*)(uint32_t, const void *, size_t);
+
+static bool haveVpclmul()
+{
+    return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("vpclmulqdq");
+}
+
+static std::vector<Crc32cFunction> implementations()
+{
+    std::vector<Crc32cFunction> result = { crc32c_table, crc32c_sse42, crc32c_pclmul, crc32c };
+    if (haveVpclmul())
+        result.push_back(crc32c_vpclmul);
+    return result;
+}
+
+static std::vector<uint8_t> random_buffer(size_t size)
+{
+    std::mt19937 engine(size);
+    std::vector<uint8_t> buffer(size);
+    for (uint8_t &b : buffer)
+        b = engine();
+    return buffer;
+}
+
+TEST(Crc32c, KnownValues)
+{
+    static const char check[] = "123456789";
+    static const uint8_t zeroes[32] = {};
+    static const uint8_t ones[32] = {
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    };
+
+    for (Crc32cFunction fn : implementations()) {
+        EXPECT_EQ(fn(0, nullptr, 0), 0U);
+        EXPECT_EQ(fn(0, check, strlen(check)), 0xe3069283U);
+        // from RFC 3720 (iSCSI), appendix B.4
+        EXPECT_EQ(fn(0, zeroes, sizeof(zeroes)), 0x8a9136aaU);
+        EXPECT_EQ(fn(0, ones, sizeof(ones)), 0x62a8ab43U);
+    }
+}
+
+TEST(Crc32c, AllImplementationsAgree)
+{
+    // every size up to a few blocks of the widest implementation, so all
+    // the loop tails are exercised, then some larger ones
+    std::vector<size_t> sizes;
+    for (size_t size = 0; size <= 1100; ++size)
+        sizes.push_back(size);
+    for (size_t size : { 4095, 4096, 65536 + 17, 1024 * 1024 })
+        sizes.push_back(size);
+
+    for (size_t size : sizes) {
+        std::vector<uint8_t> buffer = random_buffer(size);
+        uint32_t expected = crc32c_table(0, buffer.data(), size);
+        for (Crc32cFunction fn : implementations())
+            ASSERT_EQ(fn(0, buffer.data(), size), expected) << "size = " << size;
+    }
+}
+
+TEST(Crc32c, Incremental)
+{
+    std::vector<uint8_t> buffer = random_buffer(4096);
+    uint32_t expected = crc32c_table(0, buffer.data(), buffer.size());
+    for (Crc32cFunction fn : implementations()) {
+        for (size_t split : { 0, 1, 7, 64, 1000, 2049, 4096 }) {
+            uint32_t crc = fn(0, buffer.data(), split);
+            crc = fn(crc, buffer.data() + split, buffer.size() - split);
+            EXPECT_EQ(crc, expected) << "split = " << split;
+        }
+    }
+}
+
+TEST(Crc32c, Unaligned)
+{
+    std::vector<uint8_t> buffer = random_buffer(8192);
+    for (size_t offset = 1; offset < 64; ++offset) {
+        uint32_t expected = crc32c_table(0, buffer.data() + offset, 4096);
+        for (Crc32cFunction fn : implementations())
+            EXPECT_EQ(fn(0, buffer.data() + offset, 4096), expected) << "offset = " << offset;
+    }
+}
@@ -8,6 +8,9 @@
 
 #include <string.h>
 
+#include <random>
+#include <vector>
+
 static constexpr bool UseF16C = false
 #ifdef __F16C__
         || true
@@ -26,10 +29,8 @@ static inline BFloat16 tobf16_avx512(float f)
 
 static bool useAvx512Bf16()
 {
-#ifdef __AVX512BF16__
-    return true;
-#endif
-    return __builtin_cpu_supports("avx512bf16");
+    return __builtin_cpu_supports("avx512bf16") && __builtin_cpu_supports("avx512bw")
+            && __builtin_cpu_supports("avx512vl");
 }
 #else
 static inline BFloat16 tobf16_avx512(float f)
@@ -138,6 +139,7 @@ TEST(Float16, FiniteConversions)
     // underflow and overflow
     fp16_check_full(0x1p16, Float16::max().payload, FLOAT16_MAX);
     fp16_check_full(0x1p-25, 0x0000, 0);
+    fp16_check_full(-0x1p-25, 0x8000, -0.0f);
 
     // check constants
     fp16_check(FLOAT16_MAX, Float16::max().payload);
@@ -169,6 +171,18 @@ TEST(Float16, NaNConversions)
     if (UseF16C) {
         EXPECT_EQ(FloatWrapper{fromfp16(Float16::signaling_NaN())}, quieted_snan);
     }
+
+    // SNaN whose payload doesn't fit must remain a NaN
+    fp16_check_full(__builtin_nansf("1"), Float16::quiet_NaN().payload,
+                    std::numeric_limits<float>::quiet_NaN());
+
+    // negative NaN
+    Float16 neg_qnan = Float16::quiet_NaN();
+    neg_qnan.sign = 1;
+    EXPECT_EQ(FloatWrapper{fromfp16_emulated(neg_qnan)}, FloatWrapper{-std::numeric_limits<float>::quiet_NaN()});
+    if (UseF16C) {
+        EXPECT_EQ(FloatWrapper{fromfp16(neg_qnan)}, FloatWrapper{-std::numeric_limits<float>::quiet_NaN()});
+    }
 }
 
 #define bf16_check_full(Float, FP16, Float2)                                    \
@@ -224,4 +238,108 @@ TEST(BFloat16, NaNConversions)
                     quieted_snan.f);
 
     EXPECT_EQ(FloatWrapper{frombf16_emulated(BFloat16::signaling_NaN())}, quieted_snan);
+
+    // SNaN whose payload doesn't fit must remain a NaN
+    bf16_check_full(__builtin_nansf("1"), BFloat16::quiet_NaN().payload,
+                    std::numeric_limits<float>::quiet_NaN());
+}
+
+// a mix of random and interesting values, and an odd count so the
+// implementations' tails are used
+static std::vector<float> bulk_inputs()
+{
+    std::vector<float> result = {
+        0.0f, -0.0f, 1.0f, -1.0f, 0x1p-25f, -0x1p-25f, 0x1p-15f, 0x1p16f, FLT_MIN, -FLT_MIN,
+        FLT_MAX, -FLT_MAX, FLT_TRUE_MIN, std::numeric_limits<float>::infinity(),
+        -std::numeric_limits<float>::infinity(), std::numeric_limits<float>::quiet_NaN(),
+        std::numeric_limits<float>::signaling_NaN(), __builtin_nansf("1"), -__builtin_nanf("0x3ff"),
+    };
+    std::mt19937 engine(1);
+    while (result.size() < 100003)
+        result.push_back(std::bit_cast<float>(uint32_t(engine())));
+    return result;
+}
+
+static bool useAvx512Fp16()
+{
+    return __builtin_cpu_supports("avx512fp16") && __builtin_cpu_supports("avx512bw")
+            && __builtin_cpu_supports("avx512vl");
+}
+
+TEST(Float16, BulkConversions)
+{
+    using ToFp16 = void (*)(Float16 *, const float *, size_t);
+    using FromFp16 = void (*)(float *, const Float16 *, size_t);
+    std::vector<std::pair<ToFp16, FromFp16>> implementations = {
+        { ToFp16(tofp16_bulk), FromFp16(fromfp16_bulk) },
+        { tofp16_bulk_f16c, fromfp16_bulk_f16c },
+    };
+    if (useAvx512Fp16())
+        implementations.push_back({ tofp16_bulk_avx512fp16, fromfp16_bulk_avx512fp16 });
+
+    // every Float16 encoding
+    std::vector<Float16> all(65536);
+    for (size_t i = 0; i < all.size(); ++i)
+        all[i].as_hex = i;
+    std::vector<float> expected_floats(all.size());
+    fromfp16_bulk_emulated(expected_floats.data(), all.data(), all.size());
+
+    std::vector<float> inputs = bulk_inputs();
+    std::vector<Float16> expected(inputs.size());
+    tofp16_bulk_emulated(expected.data(), inputs.data(), inputs.size());
+
+    for (auto [to, from] : implementations) {
+        std::vector<float> floats(all.size());
+        from(floats.data(), all.data(), all.size());
+        for (size_t i = 0; i < all.size(); ++i)
+            ASSERT_EQ(FloatWrapper{floats[i]}, FloatWrapper{expected_floats[i]}) << "fp16 = 0x" << std::hex << i;
+
+        std::vector<Float16> converted(inputs.size());
+        to(converted.data(), inputs.data(), inputs.size());
+        for (size_t i = 0; i < inputs.size(); ++i)
+            ASSERT_EQ(converted[i].as_hex, expected[i].as_hex) << "input = " << FloatWrapper{inputs[i]};
+
+        // every tail length
+        for (size_t count = 0; count <= 40; ++count) {
+            std::vector<Float16> small(count + 1, Float16::signaling_NaN());
+            to(small.data(), inputs.data(), count);
+            EXPECT_EQ(memcmp(small.data(), expected.data(), count * sizeof(Float16)), 0) << "count = " << count;
+            EXPECT_EQ(small[count].as_hex, Float16::signaling_NaN().as_hex) << "count = " << count;
+        }
+    }
+}
+
+TEST(BFloat16, BulkConversions)
+{
+    using ToBf16 = void (*)(BFloat16 *, const float *, size_t);
+    std::vector<ToBf16> implementations = { ToBf16(tobf16_bulk) };
+    if (useAvx512Bf16())
+        implementations.push_back(tobf16_bulk_avx512bf16);
+
+    std::vector<float> inputs = bulk_inputs();
+    std::vector<BFloat16> expected(inputs.size());
+    tobf16_bulk_emulated(expected.data(), inputs.data(), inputs.size());
+
+    for (ToBf16 to : implementations) {
+        std::vector<BFloat16> converted(inputs.size());
+        to(converted.data(), inputs.data(), inputs.size());
+        for (size_t i = 0; i < inputs.size(); ++i)
+            ASSERT_EQ(converted[i].as_hex, expected[i].as_hex) << "input = " << FloatWrapper{inputs[i]};
+
+        for (size_t count = 0; count <= 40; ++count) {
+            std::vector<BFloat16> small(count + 1, BFloat16::signaling_NaN());
+            to(small.data(), inputs.data(), count);
+            EXPECT_EQ(memcmp(small.data(), expected.data(), count * sizeof(BFloat16)), 0) << "count = " << count;
+            EXPECT_EQ(small[count].as_hex, BFloat16::signaling_NaN().as_hex) << "count = " << count;
+        }
+    }
+
+    // every BFloat16 encoding
+    std::vector<BFloat16> all(65536);
+    for (size_t i = 0; i < all.size(); ++i)
+        all[i].as_hex = i;
+    std::vector<float> floats(all.size());
+    frombf16_bulk(floats, all);
+    for (size_t i = 0; i < all.size(); ++i)
+        ASSERT_EQ(FloatWrapper{floats[i]}, FloatWrapper{frombf16_emulated(all[i])}) << "bf16 = 0x" << std::hex << i;
 }
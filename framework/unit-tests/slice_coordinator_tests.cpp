@@ -0,0 +1,123 @@
+/*
+ * Copyright 2024 Intel Corporation.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "gtest/gtest.h"
+#include "slice_coordinator.hpp"
+
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <vector>
+
+static constexpr int ThreadCount = 8;
+
+static void run_threads(int count, const std::function<void(int)> &f)
+{
+    std::vector<std::thread> threads;
+    for (int i = 0; i < count; ++i)
+        threads.emplace_back(f, i);
+    for (std::thread &t : threads)
+        t.join();
+}
+
+TEST(SliceCoordinator, BarrierSeparatesPhases)
+{
+    SliceCoordinator coordinator(ThreadCount);
+    std::atomic<int> counter = 0;
+    std::atomic<bool> ok = true;
+    run_threads(ThreadCount, [&](int) {
+        for (int round = 1; round <= 100; ++round) {
+            ++counter;
+            coordinator.barrier();
+            if (counter.load() != round * ThreadCount)
+                ok = false;
+            coordinator.barrier();
+        }
+        coordinator.leave();
+    });
+    EXPECT_TRUE(ok);
+    EXPECT_EQ(counter.load(), 100 * ThreadCount);
+}
+
+TEST(SliceCoordinator, Reductions)
+{
+    SliceCoordinator coordinator(ThreadCount);
+    std::vector<uint64_t> sums(ThreadCount), mins(ThreadCount), maxes(ThreadCount), ands(ThreadCount);
+    run_threads(ThreadCount, [&](int i) {
+        sums[i] = coordinator.arrive(i + 1, SliceCoordinator::Sum);
+        mins[i] = coordinator.arrive(i + 10, SliceCoordinator::Min);
+        maxes[i] = coordinator.arrive(i + 10, SliceCoordinator::Max);
+        ands[i] = coordinator.arrive(i != 3, SliceCoordinator::And);
+        coordinator.leave();
+    });
+    for (int i = 0; i < ThreadCount; ++i) {
+        EXPECT_EQ(sums[i], ThreadCount * (ThreadCount + 1) / 2);
+        EXPECT_EQ(mins[i], 10);
+        EXPECT_EQ(maxes[i], ThreadCount - 1 + 10);
+        EXPECT_EQ(ands[i], 0);
+    }
+}
+
+TEST(SliceCoordinator, LeavingThreadsAreNotWaitedFor)
+{
+    SliceCoordinator coordinator(ThreadCount);
+    std::vector<uint64_t> sums(ThreadCount);
+    run_threads(ThreadCount, [&](int i) {
+        if (i % 2 == 0) {
+            // leave while the others may already be waiting
+            coordinator.leave();
+            return;
+        }
+        sums[i] = coordinator.arrive(1, SliceCoordinator::Sum);
+        coordinator.barrier();
+        coordinator.leave();
+    });
+    for (int i = 1; i < ThreadCount; i += 2)
+        EXPECT_EQ(sums[i], ThreadCount / 2);
+}
+
+TEST(SliceCoordinator, WorkIsHandedOutExactlyOnce)
+{
+    constexpr uint64_t Count = 100'003;
+    SliceCoordinator coordinator(ThreadCount);
+    std::vector<std::atomic<int>> seen(Count);
+    std::vector<uint64_t> per_thread(ThreadCount);
+    run_threads(ThreadCount, [&](int i) {
+        // thread 0 does no work at all, so its share must be stolen
+        if (i == 0) {
+            coordinator.leave();
+            return;
+        }
+        coordinator.work_begin(Count, 7);
+        uint64_t begin, end;
+        while (coordinator.work_next(i, &begin, &end)) {
+            EXPECT_LE(end - begin, 7U);
+            per_thread[i] += end - begin;
+            for (uint64_t n = begin; n < end; ++n)
+                ++seen[n];
+        }
+        coordinator.leave();
+    });
+    for (uint64_t n = 0; n < Count; ++n)
+        ASSERT_EQ(seen[n].load(), 1) << "item " << n;
+    EXPECT_EQ(per_thread[0], 0U);
+}
+
+TEST(SliceCoordinator, WorkCanBeRestarted)
+{
+    SliceCoordinator coordinator(ThreadCount);
+    std::atomic<uint64_t> total = 0;
+    run_threads(ThreadCount, [&](int i) {
+        for (uint64_t count : { 10, 0, 1000, 3 }) {
+            coordinator.work_begin(count, 4);
+            uint64_t begin, end;
+            while (coordinator.work_next(i, &begin, &end))
+                total += end - begin;
+            coordinator.barrier();
+        }
+        coordinator.leave();
+    });
+    EXPECT_EQ(total.load(), 10U + 0 + 1000 + 3);
+}
@@ -0,0 +1,255 @@
+/**
+ * @file
+ *
+ * @copyright
+ * Copyright 2024 Intel Corporation.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * @test @b amx_gemm_int8
+ * @test @b amx_gemm_bf16
+ * @parblock
+ * These tests multiply matrices using the Advanced Matrix Extensions tile
+ * instructions: TDPBSSD (signed int8, accumulating into int32) for
+ * amx_gemm_int8 and TDPBF16PS (bfloat16, accumulating into float) for
+ * amx_gemm_bf16. All 8 tile registers are in use: four accumulate a 32x32
+ * block of the result and the other four hold the A and B tiles being
+ * multiplied.
+ *
+ * The inputs are generated and the expected result computed with scalar
+ * code once in test_init. The bfloat16 inputs are small integers, so every
+ * product and partial sum is exact and the result doesn't depend on the
+ * order of the accumulation.
+ *
+ * The throughput of each thread is logged at the end of the run, in
+ * tera-operations per second.
+ * @endparblock
+ */
+
+#include <sandstone.h>
+#include <sandstone_data.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#include "amx_common.h"
+
+#include <chrono>
+
+#include <inttypes.h>
+
+namespace {
+// The result is a 2x2 block of tiles, each 16 rows of 64 bytes
+constexpr int TileRows = 16;
+constexpr int TileBytes = 64;
+constexpr int M = 2 * TileRows;
+constexpr int N = 2 * TileBytes / sizeof(uint32_t);
+constexpr int KChunks = 32;         // number of A and B tile pairs per multiplication
+constexpr int GemmsPerLoop = 16;
+
+// The element types and how many of them fit in 4 bytes of a tile row
+struct Int8Gemm
+{
+    using InputType = int8_t;
+    using OutputType = int32_t;
+    static constexpr int Pack = 4;          // TDPBSSD: 4 int8 per dword
+    static constexpr const char *Name = "int8";
+};
+
+struct BF16Gemm
+{
+    using InputType = BFloat16;
+    using OutputType = float;
+    static constexpr int Pack = 2;          // TDPBF16PS: 2 bf16 per dword
+    static constexpr const char *Name = "bf16";
+};
+
+template <typename Gemm> struct GemmData
+{
+    using InputType = typename Gemm::InputType;
+    using OutputType = typename Gemm::OutputType;
+    static constexpr int K = KChunks * TileBytes / sizeof(InputType);
+
+    // A is M rows by K columns, row-major
+    alignas(64) InputType a[M][K];
+
+    // B is K rows by N columns, in the VNNI layout TDPxx needs: each row
+    // holds Pack consecutive rows of the original matrix, interleaved
+    alignas(64) InputType b[K / Gemm::Pack][N][Gemm::Pack];
+
+    alignas(64) OutputType expected[M][N];
+};
+
+struct PerThread
+{
+    uint64_t gemms;
+    std::chrono::nanoseconds elapsed;
+};
+
+template <typename Gemm> struct AmxTest
+{
+    GemmData<Gemm> data;
+    PerThread *per_thread;
+};
+
+int8_t random_input(Int8Gemm)
+{
+    return int8_t(random32());
+}
+
+BFloat16 random_input(BF16Gemm)
+{
+    // small integers, so that all products and sums are exact in float
+    return BFloat16(float(int(random32() % 17) - 8));
+}
+
+int32_t to_accumulator(int8_t v)
+{
+    return v;
+}
+
+float to_accumulator(BFloat16 v)
+{
+    return frombf16_emulated(v);
+}
+
+// tmm0-3: C, tmm4-5: A, tmm6-7: B
+#define AMX_GEMM_BODY(dp)                                                                       \
+    constexpr size_t AStride = sizeof(d->a[0]);                                                 \
+    constexpr size_t BStride = sizeof(d->b[0]);                                                 \
+    constexpr size_t CStride = sizeof(c[0]);                                                    \
+    constexpr int ATileCols = TileBytes / sizeof(d->a[0][0]);                                   \
+    _tile_zero(0);                                                                              \
+    _tile_zero(1);                                                                              \
+    _tile_zero(2);                                                                              \
+    _tile_zero(3);                                                                              \
+    for (int k = 0; k < KChunks; ++k) {                                                         \
+        _tile_loadd(4, &d->a[0][k * ATileCols], AStride);                                       \
+        _tile_loadd(5, &d->a[TileRows][k * ATileCols], AStride);                                \
+        _tile_loadd(6, &d->b[k * TileRows][0], BStride);                                        \
+        _tile_loadd(7, &d->b[k * TileRows][N / 2], BStride);                                    \
+        dp(0, 4, 6);                                                                            \
+        dp(1, 4, 7);                                                                            \
+        dp(2, 5, 6);                                                                            \
+        dp(3, 5, 7);                                                                            \
+    }                                                                                           \
+    _tile_stored(0, &c[0][0], CStride);                                                         \
+    _tile_stored(1, &c[0][N / 2], CStride);                                                     \
+    _tile_stored(2, &c[TileRows][0], CStride);                                                  \
+    _tile_stored(3, &c[TileRows][N / 2], CStride)
+
+ATTRIBUTE_AMX_TARGET("amx-tile,amx-int8")
+void amx_gemm(const GemmData<Int8Gemm> *d, int32_t (&c)[M][N])
+{
+    AMX_GEMM_BODY(_tile_dpbssd);
+}
+
+ATTRIBUTE_AMX_TARGET("amx-tile,amx-bf16")
+void amx_gemm(const GemmData<BF16Gemm> *d, float (&c)[M][N])
+{
+    AMX_GEMM_BODY(_tile_dpbf16ps);
+}
+#undef AMX_GEMM_BODY
+
+ATTRIBUTE_AMX_TARGET("amx-tile")
+void amx_start()
+{
+    // not _tile_loadconfig(): its asm operand says only 8 bytes are read, so
+    // the compiler may drop the stores to colsb[] and rows[]
+    alignas(64) static const struct amx_tileconfig cfg = {
+        .palette = 1,
+        .start_row = 0,
+        .colsb = { TileBytes, TileBytes, TileBytes, TileBytes, TileBytes, TileBytes, TileBytes, TileBytes },
+        .rows = { TileRows, TileRows, TileRows, TileRows, TileRows, TileRows, TileRows, TileRows },
+    };
+    asm volatile("ldtilecfg %0" : : "m" (cfg));
+}
+
+ATTRIBUTE_AMX_TARGET("amx-tile")
+void amx_stop()
+{
+    _tile_release();
+}
+} // unnamed namespace
+
+template <typename Gemm> static int amx_gemm_init(struct test *test)
+{
+    auto t = new AmxTest<Gemm>;
+    GemmData<Gemm> &d = t->data;
+    constexpr int K = GemmData<Gemm>::K;
+
+    for (int m = 0; m < M; ++m)
+        for (int k = 0; k < K; ++k)
+            d.a[m][k] = random_input(Gemm{});
+    for (int k = 0; k < K; ++k)
+        for (int n = 0; n < N; ++n)
+            d.b[k / Gemm::Pack][n][k % Gemm::Pack] = random_input(Gemm{});
+
+    // scalar reference
+    for (int m = 0; m < M; ++m) {
+        for (int n = 0; n < N; ++n) {
+            typename Gemm::OutputType sum = 0;
+            for (int k = 0; k < K; ++k)
+                sum += to_accumulator(d.a[m][k]) * to_accumulator(d.b[k / Gemm::Pack][n][k % Gemm::Pack]);
+            d.expected[m][n] = sum;
+        }
+    }
+
+    t->per_thread = new PerThread[num_cpus()]();
+    test->data = t;
+    return EXIT_SUCCESS;
+}
+
+template <typename Gemm> static int amx_gemm_run(struct test *test, int cpu)
+{
+    auto t = static_cast<AmxTest<Gemm> *>(test->data);
+    const GemmData<Gemm> *d = &t->data;
+    PerThread &stats = t->per_thread[cpu];
+    alignas(64) typename Gemm::OutputType c[M][N];
+
+    amx_start();
+    TEST_LOOP(test, 128) {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < GemmsPerLoop; ++i) {
+            amx_gemm(d, c);
+            memcmp_or_fail(&c[0][0], &d->expected[0][0], M * N, "%s GEMM result", Gemm::Name);
+        }
+        stats.elapsed += std::chrono::steady_clock::now() - start;
+        stats.gemms += GemmsPerLoop;
+    }
+    amx_stop();
+
+    if (stats.elapsed.count()) {
+        double ops = 2.0 * M * N * GemmData<Gemm>::K * stats.gemms;
+        log_info("%s: %.3f TOPS", Gemm::Name, ops / stats.elapsed.count() / 1000);
+    }
+    return EXIT_SUCCESS;
+}
+
+template <typename Gemm> static int amx_gemm_cleanup(struct test *test)
+{
+    auto t = static_cast<AmxTest<Gemm> *>(test->data);
+    if (t) {
+        delete[] t->per_thread;
+        delete t;
+    }
+    return EXIT_SUCCESS;
+}
+
+DECLARE_TEST(amx_gemm_int8, "AMX tile matrix multiplication with int8 inputs (TDPBSSD)")
+    .test_init = amx_gemm_init<Int8Gemm>,
+    .test_run = amx_gemm_run<Int8Gemm>,
+    .test_cleanup = amx_gemm_cleanup<Int8Gemm>,
+    .minimum_cpu = cpu_feature_amx_tile | cpu_feature_amx_int8,
+    .desired_duration = 1000,
+    .quality_level = TEST_QUALITY_BETA,
+END_DECLARE_TEST
+
+DECLARE_TEST(amx_gemm_bf16, "AMX tile matrix multiplication with bfloat16 inputs (TDPBF16PS)")
+    .test_init = amx_gemm_init<BF16Gemm>,
+    .test_run = amx_gemm_run<BF16Gemm>,
+    .test_cleanup = amx_gemm_cleanup<BF16Gemm>,
+    .minimum_cpu = cpu_feature_amx_tile | cpu_feature_amx_bf16,
+    .desired_duration = 1000,
+    .quality_level = TEST_QUALITY_BETA,
+END_DECLARE_TEST
+
+#endif // __x86_64__
@@ -0,0 +1,349 @@
+/**
+ * @file
+ *
+ * @copyright
+ * Copyright 2024 Intel Corporation.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * @test @b atomic_contention
+ * @test @b atomic_contention_socket
+ * @parblock
+ * These tests have all threads hammer shared data with locked
+ * read-modify-write instructions:
+ *  - LOCK XADD on counters that share a single cache line
+ *  - LOCK XADD on counters in cache lines that map to the same cache set,
+ *    so they evict each other while they bounce between cores
+ *  - LOCK BTS and LOCK BTR on bitmaps where each thread owns one bit of
+ *    words shared with other threads, checking the previous state of its
+ *    bit every time
+ *  - LOCK CMPXCHG16B on 128-bit records whose two halves must always be
+ *    consistent with each other
+ *  - if the CPU supports RTM, transactions that increment two counters in
+ *    different cache lines, with a spinlock fallback
+ *
+ * Each thread keeps a tally of what it added, and test_cleanup verifies
+ * that the final values of the shared data are exactly the totals of the
+ * tallies. The tallies are kept up to date as the threads run, so the
+ * check still holds if a thread failed. Each thread logs its rate of
+ * successful operations, its CMPXCHG16B failure rate and, if RTM was
+ * used, its transaction abort rate; threads that were much slower than
+ * the median are reported with a warning.
+ *
+ * atomic_contention_socket runs with all the threads of the system, so the
+ * cache lines also bounce between sockets.
+ * @endparblock
+ */
+
+#include <sandstone.h>
+#include "topology.h"
+
+#if defined(__x86_64__)
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+#include <immintrin.h>
+#include <inttypes.h>
+
+namespace {
+constexpr int RoundsPerLoop = 4096;
+static_assert(RoundsPerLoop % 2 == 0, "each loop must end with LOCK BTR");
+constexpr int SameLineCounters = 8;
+constexpr int SameSetLines = 16;
+constexpr size_t SameSetStride = 128 * 1024;    // multiple of the L1 and L2 set strides
+constexpr int CasRecords = 4;
+constexpr int SlowThreadRatio = 4;              // warn if the rate is less than 1/4 of the median
+
+struct alignas(64) CacheLine
+{
+    uint64_t words[8];
+};
+
+struct alignas(16) CasRecord
+{
+    uint64_t value;
+    uint64_t check;
+};
+
+uint64_t cas_check(uint64_t value)
+{
+    return ~value * 0x9e3779b97f4a7c15;
+}
+
+struct alignas(64) ThreadState
+{
+    uint64_t same_line[SameLineCounters];
+    uint64_t same_set[SameSetLines];
+    uint64_t cas_successes[CasRecords];
+    uint64_t rtm_increments;
+    uint64_t operations;
+    uint64_t cas_failures;
+    uint64_t rtm_aborts;
+    std::chrono::nanoseconds elapsed;
+    bool ran;                       // returned from test_run(), didn't fail
+};
+
+struct AtomicTest
+{
+    bool use_rtm;
+    int bitmap_words;
+    CacheLine *same_line;           // SameLineCounters counters in one line
+    uint8_t *same_set;              // SameSetLines lines, SameSetStride apart
+    CacheLine *bitmap;              // bitmap_words words, each in its own line
+    CasRecord *cas;                 // CasRecords records in one line
+    CacheLine *rtm;                 // [0] the lock, [1] and [2] the counters
+    std::vector<ThreadState> threads;
+};
+
+uint64_t *same_set_counter(AtomicTest *t, int line)
+{
+    return reinterpret_cast<uint64_t *>(t->same_set + line * SameSetStride);
+}
+
+inline uint64_t lock_xadd(uint64_t *ptr, uint64_t value)
+{
+    return __atomic_fetch_add(ptr, value, __ATOMIC_SEQ_CST);
+}
+
+// both return the previous state of the bit
+inline bool lock_bts(uint64_t *word, uint64_t bit)
+{
+    bool old;
+    asm volatile("lock btsq %2, %0" : "+m" (*word), "=@ccc" (old) : "r" (bit) : "memory");
+    return old;
+}
+
+inline bool lock_btr(uint64_t *word, uint64_t bit)
+{
+    bool old;
+    asm volatile("lock btrq %2, %0" : "+m" (*word), "=@ccc" (old) : "r" (bit) : "memory");
+    return old;
+}
+
+// on failure, expected is updated with the record's current contents
+inline bool lock_cmpxchg16b(CasRecord *record, CasRecord &expected, CasRecord desired)
+{
+    bool ok;
+    asm volatile("lock cmpxchg16b %1"
+                 : "=@ccz" (ok), "+m" (*record), "+a" (expected.value), "+d" (expected.check)
+                 : "b" (desired.value), "c" (desired.check)
+                 : "memory");
+    return ok;
+}
+
+// increments both counters, in a transaction if possible
+__attribute__((target("rtm")))
+void rtm_increment(CacheLine *rtm, ThreadState &state)
+{
+    uint64_t *lock = &rtm[0].words[0];
+    if (_xbegin() == _XBEGIN_STARTED) {
+        if (__atomic_load_n(lock, __ATOMIC_RELAXED))
+            _xabort(0xff);
+        ++rtm[1].words[0];
+        ++rtm[2].words[0];
+        _xend();
+    } else {
+        ++state.rtm_aborts;
+        while (__atomic_exchange_n(lock, 1, __ATOMIC_ACQUIRE))
+            _mm_pause();
+        ++rtm[1].words[0];
+        ++rtm[2].words[0];
+        __atomic_store_n(lock, 0, __ATOMIC_RELEASE);
+    }
+    ++state.rtm_increments;
+}
+
+bool check_total(const char *what, int index, uint64_t actual, uint64_t expected)
+{
+    if (actual == expected)
+        return true;
+    log_error("%s %d: final value %#" PRIx64 ", expected %#" PRIx64, what, index, actual, expected);
+    return false;
+}
+} // unnamed namespace
+
+static int atomic_init(struct test *test)
+{
+    auto t = new AtomicTest;
+    t->use_rtm = cpu_has_feature(cpu_feature_rtm);
+    t->bitmap_words = (num_cpus() + 63) / 64;
+    t->same_line = new CacheLine{};
+    t->same_set = static_cast<uint8_t *>(aligned_alloc_safe(SameSetStride, SameSetLines * SameSetStride));
+    for (int i = 0; i < SameSetLines; ++i)
+        *same_set_counter(t, i) = 0;
+    t->bitmap = new CacheLine[t->bitmap_words]{};
+    t->cas = static_cast<CasRecord *>(aligned_alloc_safe(64, CasRecords * sizeof(CasRecord)));
+    for (int i = 0; i < CasRecords; ++i)
+        t->cas[i] = { 0, cas_check(0) };
+    t->rtm = new CacheLine[3]{};
+    t->threads.resize(num_cpus());
+    test->data = t;
+    return EXIT_SUCCESS;
+}
+
+static int atomic_socket_init(struct test *test)
+{
+    if (Topology::topology().packages.size() < 2) {
+        log_skip(CpuTopologyIssueSkipCategory, "System has only one socket");
+        return EXIT_SKIP;
+    }
+    return atomic_init(test);
+}
+
+static int atomic_run(struct test *test, int cpu)
+{
+    auto t = static_cast<AtomicTest *>(test->data);
+    // tallied in place, so test_cleanup sees them even if this thread fails
+    ThreadState &state = t->threads[cpu];
+    const uint64_t increment = 1 + cpu % 7;
+    const int counter = cpu % SameLineCounters;
+    uint64_t *bitmap_word = &t->bitmap[cpu / 64].words[0];
+    const uint64_t bit = cpu % 64;
+    CasRecord seen[CasRecords];
+    std::copy_n(t->cas, CasRecords, seen);      // a guess, corrected by the first failure
+
+    // contention makes the rounds slower the more threads there are
+    TEST_LOOP_AUTO(test, 1, 1 << 10) {
+        auto start = std::chrono::steady_clock::now();
+        for (int round = 0; round < RoundsPerLoop; ++round) {
+            lock_xadd(&t->same_line->words[counter], increment);
+            state.same_line[counter] += increment;
+
+            int line = round % SameSetLines;
+            lock_xadd(same_set_counter(t, line), increment);
+            state.same_set[line] += increment;
+
+            bool was_set = (round & 1) ? lock_btr(bitmap_word, bit) : lock_bts(bitmap_word, bit);
+            if (was_set != bool(round & 1))
+                report_fail_msg("LOCK %s found bit %" PRIu64 " %s, but only this thread changes it",
+                                (round & 1) ? "BTR" : "BTS", bit, was_set ? "set" : "clear");
+
+            int r = round % CasRecords;
+            CasRecord desired = { seen[r].value + 1, cas_check(seen[r].value + 1) };
+            if (lock_cmpxchg16b(&t->cas[r], seen[r], desired)) {
+                seen[r] = desired;
+                ++state.cas_successes[r];
+            } else {
+                ++state.cas_failures;
+                if (seen[r].check != cas_check(seen[r].value))
+                    report_fail_msg("LOCK CMPXCHG16B read an inconsistent record: value %#" PRIx64
+                                    ", check %#" PRIx64 " (expected %#" PRIx64 ")",
+                                    seen[r].value, seen[r].check, cas_check(seen[r].value));
+            }
+
+            if (t->use_rtm)
+                rtm_increment(t->rtm, state);
+        }
+        state.operations += RoundsPerLoop * (3 + t->use_rtm);
+        state.elapsed += std::chrono::steady_clock::now() - start;
+    };
+
+    uint64_t cas_attempts = state.cas_failures;
+    for (uint64_t n : state.cas_successes) {
+        cas_attempts += n;
+        state.operations += n;
+    }
+    if (state.elapsed.count()) {
+        char rtm_info[64] = "";
+        if (state.rtm_increments)
+            snprintf(rtm_info, sizeof(rtm_info), ", RTM abort rate %.1f%%",
+                     100.0 * state.rtm_aborts / state.rtm_increments);
+        log_info("%.1f M operations/s, CMPXCHG16B failure rate %.1f%%%s",
+                 1000.0 * state.operations / state.elapsed.count(),
+                 cas_attempts ? 100.0 * state.cas_failures / cas_attempts : 0.0, rtm_info);
+    }
+
+    state.ran = true;
+    return EXIT_SUCCESS;
+}
+
+static int atomic_cleanup(struct test *test)
+{
+    auto t = static_cast<AtomicTest *>(test->data);
+    if (!t)
+        return EXIT_SUCCESS;
+
+    uint64_t same_line[SameLineCounters] = {};
+    uint64_t same_set[SameSetLines] = {};
+    uint64_t cas_successes[CasRecords] = {};
+    uint64_t rtm_increments = 0;
+    std::vector<double> rates;
+    for (size_t i = 0; i < t->threads.size(); ++i) {
+        const ThreadState &state = t->threads[i];
+        for (int j = 0; j < SameLineCounters; ++j)
+            same_line[j] += state.same_line[j];
+        for (int j = 0; j < SameSetLines; ++j)
+            same_set[j] += state.same_set[j];
+        for (int j = 0; j < CasRecords; ++j)
+            cas_successes[j] += state.cas_successes[j];
+        rtm_increments += state.rtm_increments;
+        if (state.ran && state.elapsed.count())
+            rates.push_back(double(state.operations) / state.elapsed.count());
+    }
+
+    bool ok = true;
+    for (int i = 0; i < SameLineCounters; ++i)
+        ok &= check_total("Same-line counter", i, t->same_line->words[i], same_line[i]);
+    for (int i = 0; i < SameSetLines; ++i)
+        ok &= check_total("Same-set counter", i, *same_set_counter(t, i), same_set[i]);
+    for (int i = 0; i < t->bitmap_words; ++i) {
+        // every loop leaves all bits clear, but a thread that failed may
+        // have stopped with its bit set
+        uint64_t failed = 0;
+        for (int bit = 0; bit < 64 && i * 64 + bit < int(t->threads.size()); ++bit) {
+            if (!t->threads[i * 64 + bit].ran)
+                failed |= uint64_t(1) << bit;
+        }
+        ok &= check_total("Bitmap word", i, t->bitmap[i].words[0] & ~failed, 0);
+    }
+    for (int i = 0; i < CasRecords; ++i) {
+        ok &= check_total("CMPXCHG16B record", i, t->cas[i].value, cas_successes[i]);
+        ok &= check_total("CMPXCHG16B record check", i, t->cas[i].check, cas_check(cas_successes[i]));
+    }
+    ok &= check_total("RTM counter", 1, t->rtm[1].words[0], rtm_increments);
+    ok &= check_total("RTM counter", 2, t->rtm[2].words[0], rtm_increments);
+
+    // flag the threads whose atomics were much slower than the others'
+    if (rates.size() > 1) {
+        std::vector<double> sorted = rates;
+        std::nth_element(sorted.begin(), sorted.begin() + sorted.size() / 2, sorted.end());
+        double median = sorted[sorted.size() / 2];
+        for (size_t i = 0; i < t->threads.size(); ++i) {
+            const ThreadState &state = t->threads[i];
+            if (!state.ran || !state.elapsed.count())
+                continue;
+            double rate = double(state.operations) / state.elapsed.count();
+            if (rate * SlowThreadRatio < median)
+                log_warning("Thread %zu (CPU %d) managed %.1f M operations/s, the median is %.1f M",
+                            i, cpu_info[i].cpu_number, 1000 * rate, 1000 * median);
+        }
+    }
+
+    free(t->cas);
+    free(t->same_set);
+    delete[] t->rtm;
+    delete[] t->bitmap;
+    delete t->same_line;
+    delete t;
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+DECLARE_TEST(atomic_contention, "Locked read-modify-write, CMPXCHG16B and RTM contention with verified totals")
+    .test_init = atomic_init,
+    .test_run = atomic_run,
+    .test_cleanup = atomic_cleanup,
+    .desired_duration = 1000,
+    .quality_level = TEST_QUALITY_BETA,
+END_DECLARE_TEST
+
+DECLARE_TEST(atomic_contention_socket, "Locked read-modify-write, CMPXCHG16B and RTM contention across sockets")
+    .test_init = atomic_socket_init,
+    .test_run = atomic_run,
+    .test_cleanup = atomic_cleanup,
+    .desired_duration = 1000,
+    .quality_level = TEST_QUALITY_BETA,
+    .flags = test_schedule_fullsystem,
+END_DECLARE_TEST
+
+#endif // __x86_64__
@@ -0,0 +1,482 @@
+/**
+ * @file
+ *
+ * @copyright
+ * Copyright 2024 Intel Corporation.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * @test @b bigint_adx
+ * @test @b bigint_ifma
+ * @parblock
+ * These tests perform modular exponentiation of 1024-, 2048-, 4096- and
+ * 8192-bit integers with Montgomery multiplication, the core of RSA and
+ * Diffie-Hellman.
+ *
+ * bigint_adx uses 64-bit limbs: each row of the multiplication is a MULX
+ * loop with two interleaved carry chains, ADCX for the low halves of the
+ * products and ADOX for the high halves. bigint_ifma uses 52-bit limbs in
+ * ZMM registers with the AVX-512 IFMA VPMADD52LUQ and VPMADD52HUQ
+ * instructions.
+ *
+ * The moduli, bases and exponents are generated in test_init and the
+ * expected results computed with a portable implementation that uses
+ * ordinary 128-bit integer arithmetic. Each thread logs the number of limb
+ * multiplications per second it achieved at each size.
+ * @endparblock
+ */
+
+#include <sandstone.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+#include <string>
+
+#include <inttypes.h>
+
+namespace {
+constexpr int Sizes[] = { 1024, 2048, 4096, 8192 };
+constexpr int SizeCount = std::size(Sizes);
+constexpr int CasesPerSize = 4;
+constexpr int MaxBits = 8192;
+constexpr int MaxLimbs = MaxBits / 64;
+
+// 52-bit limbs for IFMA: we need R = 2^(52 * L) > 4N, so the almost
+// Montgomery multiplication's result stays below 2N
+constexpr uint64_t Mask52 = (UINT64_C(1) << 52) - 1;
+constexpr int limbs52(int bits)
+{
+    return (bits + 2 + 51) / 52;
+}
+constexpr int MaxLimbs52 = (limbs52(MaxBits) + 7) & ~7;    // padded to whole ZMM registers
+
+struct Modulus
+{
+    int bits;
+    int n;                          // 64-bit limbs
+    int l;                          // 52-bit limbs
+    uint64_t n0inv;                 // -N^-1 mod 2^64 (its low 52 bits are -N^-1 mod 2^52)
+    uint64_t N[MaxLimbs];
+    uint64_t r2[MaxLimbs];          // 2^(2 * 64 * n) mod N
+    alignas(64) uint64_t N52[MaxLimbs52];
+    alignas(64) uint64_t r2_52[MaxLimbs52];     // 2^(2 * 52 * l) mod N, 52-bit limbs
+};
+
+struct Case
+{
+    Modulus mod;
+    uint64_t exponent;
+    uint64_t base[MaxLimbs];
+    uint64_t expected[MaxLimbs];
+};
+
+struct bigint_test
+{
+    Case cases[SizeCount][CasesPerSize];
+};
+
+struct Stats
+{
+    uint64_t limb_mults = 0;
+    std::chrono::nanoseconds elapsed = {};
+};
+
+// --- portable helpers ---
+
+bool geq(const uint64_t *a, const uint64_t *b, int n)
+{
+    for (int i = n - 1; i >= 0; --i) {
+        if (a[i] != b[i])
+            return a[i] > b[i];
+    }
+    return true;
+}
+
+// a -= b, returning the borrow
+uint64_t sub(uint64_t *a, const uint64_t *b, int n)
+{
+    unsigned char borrow = 0;
+    for (int i = 0; i < n; ++i) {
+        unsigned long long r;
+        borrow = _subborrow_u64(borrow, a[i], b[i], &r);
+        a[i] = r;
+    }
+    return borrow;
+}
+
+// t has n + 1 limbs and is less than 2N; reduces it below N into r
+void final_subtract(uint64_t *r, const uint64_t *t, const uint64_t *N, int n)
+{
+    std::copy_n(t, n, r);
+    if (t[n] || geq(r, N, n))
+        sub(r, N, n);
+}
+
+// a = 2a mod N, for a < N
+void double_mod(uint64_t *a, const uint64_t *N, int n)
+{
+    uint64_t top = a[n - 1] >> 63;
+    for (int i = n - 1; i > 0; --i)
+        a[i] = (a[i] << 1) | (a[i - 1] >> 63);
+    a[0] <<= 1;
+    if (top || geq(a, N, n))
+        sub(a, N, n);
+}
+
+void pow2_mod(uint64_t *r, int k, const uint64_t *N, int n)
+{
+    std::fill_n(r, n, 0);
+    r[0] = 1;
+    for (int i = 0; i < k; ++i)
+        double_mod(r, N, n);
+}
+
+void to_radix52(uint64_t *out, const uint64_t *in, int n, int l, int lpad)
+{
+    for (int i = 0; i < lpad; ++i) {
+        out[i] = 0;
+        if (i >= l)
+            continue;
+        int bit = i * 52;
+        int limb = bit / 64, shift = bit % 64;
+        if (limb >= n)
+            continue;
+        uint64_t v = in[limb] >> shift;
+        if (shift > 12 && limb + 1 < n)
+            v |= in[limb + 1] << (64 - shift);
+        out[i] = v & Mask52;
+    }
+}
+
+// in must be normalized (every limb below 2^52) and less than 2^(64 * n)
+void from_radix52(uint64_t *out, const uint64_t *in, int l, int n)
+{
+    std::fill_n(out, n, 0);
+    for (int i = 0; i < l; ++i) {
+        int bit = i * 52;
+        int limb = bit / 64, shift = bit % 64;
+        if (limb < n)
+            out[limb] |= in[i] << shift;
+        if (shift > 12 && limb + 1 < n)
+            out[limb + 1] |= in[i] >> (64 - shift);
+    }
+}
+
+// --- portable Montgomery multiplication (reference) ---
+
+// r = a * b / 2^(64 * n) mod N (CIOS method)
+void montmul_portable(uint64_t *r, const uint64_t *a, const uint64_t *b, const Modulus &m)
+{
+    const int n = m.n;
+    uint64_t t[MaxLimbs + 2] = {};
+    for (int i = 0; i < n; ++i) {
+        unsigned __int128 c = 0;
+        for (int j = 0; j < n; ++j) {
+            c += (unsigned __int128)a[i] * b[j] + t[j];
+            t[j] = uint64_t(c);
+            c >>= 64;
+        }
+        c += t[n];
+        t[n] = uint64_t(c);
+        t[n + 1] = uint64_t(c >> 64);
+
+        uint64_t mm = t[0] * m.n0inv;
+        c = (unsigned __int128)mm * m.N[0] + t[0];
+        c >>= 64;
+        for (int j = 1; j < n; ++j) {
+            c += (unsigned __int128)mm * m.N[j] + t[j];
+            t[j - 1] = uint64_t(c);
+            c >>= 64;
+        }
+        c += t[n];
+        t[n - 1] = uint64_t(c);
+        t[n] = t[n + 1] + uint64_t(c >> 64);
+    }
+    final_subtract(r, t, m.N, n);
+}
+
+// --- MULX/ADCX/ADOX Montgomery multiplication ---
+
+// t[0..n+1] += x * b[0..n-1]: MULX produces each product without touching
+// the flags, ADCX adds the low halves in the CF chain and ADOX the high
+// halves in the OF chain. The loop counter runs from -n to 0 with LEA and
+// JRCXZ, which don't modify the flags either.
+inline void mul_add_row_adx(uint64_t *t, const uint64_t *b, uint64_t x, int n)
+{
+    uint64_t lo, hi, prev, r;
+    long count = -n;
+    asm volatile(
+        "xor    %[prev], %[prev]\n\t"              // also clears CF and OF
+        "1:\n\t"
+        "mulx   (%[b],%[count],8), %[lo], %[hi]\n\t"
+        "mov    (%[t],%[count],8), %[r]\n\t"
+        "adcx   %[lo], %[r]\n\t"
+        "adox   %[prev], %[r]\n\t"
+        "mov    %[r], (%[t],%[count],8)\n\t"
+        "mov    %[hi], %[prev]\n\t"
+        "lea    1(%[count]), %[count]\n\t"
+        "jrcxz  2f\n\t"
+        "jmp    1b\n"
+        "2:\n\t"
+        "mov    $0, %[lo]\n\t"
+        "mov    (%[t]), %[r]\n\t"
+        "adcx   %[lo], %[r]\n\t"
+        "adox   %[prev], %[r]\n\t"
+        "mov    %[r], (%[t])\n\t"
+        "mov    8(%[t]), %[r]\n\t"
+        "adcx   %[lo], %[r]\n\t"
+        "adox   %[lo], %[r]\n\t"
+        "mov    %[r], 8(%[t])\n\t"
+        : [count] "+c" (count), [lo] "=&r" (lo), [hi] "=&r" (hi), [prev] "=&r" (prev), [r] "=&r" (r)
+        : [t] "r" (t + n), [b] "r" (b + n), "d" (x)
+        : "cc", "memory");
+}
+
+void montmul_adx(uint64_t *r, const uint64_t *a, const uint64_t *b, const Modulus &m)
+{
+    const int n = m.n;
+    uint64_t t[2 * MaxLimbs + 2];
+    std::fill_n(t, 2 * n + 2, 0);
+
+    // instead of shifting t one limb right every row, slide the window
+    for (int i = 0; i < n; ++i) {
+        uint64_t *w = t + i;
+        mul_add_row_adx(w, b, a[i], n);
+        mul_add_row_adx(w, m.N, w[0] * m.n0inv, n);
+    }
+    final_subtract(r, t + n, m.N, n);
+}
+
+// --- AVX-512 IFMA Montgomery multiplication ---
+
+#define IFMA_TARGET __attribute__((target("avx512f,avx512ifma")))
+
+// r = a * b / 2^(52 * l) mod N, with a, b and r normalized, below 2N and
+// in 52-bit limbs (almost Montgomery multiplication)
+IFMA_TARGET void montmul_ifma(uint64_t *r, const uint64_t *a, const uint64_t *b, const Modulus &m)
+{
+    constexpr int MaxVectors = MaxLimbs52 / 8;
+    const int vectors = (m.l + 7) / 8;
+    __m512i z[MaxVectors + 1];
+    __m512i B[MaxVectors], N[MaxVectors];
+    for (int v = 0; v < vectors; ++v) {
+        z[v] = _mm512_setzero_si512();
+        B[v] = _mm512_load_si512(b + 8 * v);
+        N[v] = _mm512_load_si512(m.N52 + 8 * v);
+    }
+    z[vectors] = _mm512_setzero_si512();
+
+    for (int i = 0; i < m.l; ++i) {
+        __m512i ai = _mm512_set1_epi64(a[i]);
+        for (int v = 0; v < vectors; ++v)
+            z[v] = _mm512_madd52lo_epu64(z[v], ai, B[v]);
+
+        uint64_t z0 = _mm_cvtsi128_si64(_mm512_castsi512_si128(z[0]));
+        __m512i mm = _mm512_set1_epi64((z0 * m.n0inv) & Mask52);
+        for (int v = 0; v < vectors; ++v)
+            z[v] = _mm512_madd52lo_epu64(z[v], mm, N[v]);
+
+        // the lowest limb is now a multiple of 2^52: shift everything down
+        // by one limb and carry its upper bits into the new lowest one
+        uint64_t carry = uint64_t(_mm_cvtsi128_si64(_mm512_castsi512_si128(z[0]))) >> 52;
+        for (int v = 0; v < vectors; ++v)
+            z[v] = _mm512_alignr_epi64(z[v + 1], z[v], 1);
+        z[0] = _mm512_add_epi64(z[0], _mm512_maskz_set1_epi64(1, carry));
+
+        // the high halves of the products belong one limb up, which after
+        // the shift is the same limb as their inputs
+        for (int v = 0; v < vectors; ++v) {
+            z[v] = _mm512_madd52hi_epu64(z[v], ai, B[v]);
+            z[v] = _mm512_madd52hi_epu64(z[v], mm, N[v]);
+        }
+    }
+
+    // normalize
+    for (int v = 0; v < vectors; ++v)
+        _mm512_store_si512(r + 8 * v, z[v]);
+    uint64_t carry = 0;
+    for (int i = 0; i < 8 * vectors; ++i) {
+        uint64_t x = r[i] + carry;
+        r[i] = x & Mask52;
+        carry = x >> 52;
+    }
+}
+
+#undef IFMA_TARGET
+
+// --- modular exponentiation ---
+
+// r = base^e mod N, with 64-bit limbs
+template <auto MontMul> void modexp64(uint64_t *r, const Case &c)
+{
+    const Modulus &m = c.mod;
+    uint64_t one[MaxLimbs] = { 1 };
+    uint64_t base[MaxLimbs], x[MaxLimbs];
+
+    MontMul(base, c.base, m.r2, m);         // to Montgomery form
+    MontMul(x, one, m.r2, m);
+    for (int bit = 63 - __builtin_clzll(c.exponent); bit >= 0; --bit) {
+        MontMul(x, x, x, m);
+        if (c.exponent & (UINT64_C(1) << bit))
+            MontMul(x, x, base, m);
+    }
+    MontMul(r, x, one, m);                  // and back
+}
+
+void modexp_ifma(uint64_t *r, const Case &c)
+{
+    const Modulus &m = c.mod;
+    const int lpad = (m.l + 7) & ~7;
+    alignas(64) uint64_t one[MaxLimbs52] = { 1 };
+    alignas(64) uint64_t base[MaxLimbs52], x[MaxLimbs52], t[MaxLimbs52];
+
+    to_radix52(t, c.base, m.n, m.l, lpad);
+    montmul_ifma(base, t, m.r2_52, m);
+    montmul_ifma(x, one, m.r2_52, m);
+    for (int bit = 63 - __builtin_clzll(c.exponent); bit >= 0; --bit) {
+        montmul_ifma(x, x, x, m);
+        if (c.exponent & (UINT64_C(1) << bit))
+            montmul_ifma(x, x, base, m);
+    }
+    montmul_ifma(t, x, one, m);
+
+    // the result is below 2N, which may need one more limb than N
+    uint64_t wide[MaxLimbs + 1];
+    from_radix52(wide, t, m.l, m.n + 1);
+    final_subtract(r, wide, m.N, m.n);
+}
+
+// one squaring per exponent bit, one multiplication per bit set and three
+// conversions into and out of Montgomery form
+int montmul_count(const Case &c)
+{
+    return 3 + (64 - __builtin_clzll(c.exponent)) + __builtin_popcountll(c.exponent);
+}
+
+uint64_t random_limb()
+{
+    return random64();
+}
+
+void generate_case(Case &c, int bits)
+{
+    Modulus &m = c.mod;
+    m.bits = bits;
+    m.n = bits / 64;
+    m.l = limbs52(bits);
+
+    // random odd modulus with the top bit set
+    for (int i = 0; i < m.n; ++i)
+        m.N[i] = random_limb();
+    m.N[0] |= 1;
+    m.N[m.n - 1] |= UINT64_C(1) << 63;
+
+    // -N^-1 mod 2^64, by Newton's iteration
+    uint64_t inv = 1;
+    for (int i = 0; i < 6; ++i)
+        inv *= 2 - m.N[0] * inv;
+    m.n0inv = -inv;
+
+    pow2_mod(m.r2, 2 * 64 * m.n, m.N, m.n);
+    uint64_t r2_52[MaxLimbs];
+    pow2_mod(r2_52, 2 * 52 * m.l, m.N, m.n);
+    to_radix52(m.r2_52, r2_52, m.n, m.l, MaxLimbs52);
+    to_radix52(m.N52, m.N, m.n, m.l, MaxLimbs52);
+
+    // a base below N and an exponent with its top bit set
+    for (int i = 0; i < m.n; ++i)
+        c.base[i] = random_limb();
+    c.base[m.n - 1] >>= 1;
+    c.exponent = random64() | (UINT64_C(1) << 63);
+
+    modexp64<montmul_portable>(c.expected, c);
+}
+
+int bigint_init(struct test *test)
+{
+    auto t = new bigint_test;
+    for (int s = 0; s < SizeCount; ++s) {
+        for (int i = 0; i < CasesPerSize; ++i)
+            generate_case(t->cases[s][i], Sizes[s]);
+    }
+    test->data = t;
+    return EXIT_SUCCESS;
+}
+
+int bigint_cleanup(struct test *test)
+{
+    delete static_cast<bigint_test *>(test->data);
+    return EXIT_SUCCESS;
+}
+
+// products of two limbs in one Montgomery multiplication
+uint64_t limb_mults_adx(const Case &c)
+{
+    return 2 * uint64_t(c.mod.n) * c.mod.n;
+}
+
+uint64_t limb_mults_ifma(const Case &c)
+{
+    return 2 * uint64_t(c.mod.l) * c.mod.l;
+}
+
+template <void (*ModExp)(uint64_t *, const Case &), uint64_t (*LimbMults)(const Case &)>
+int bigint_run(struct test *test, int cpu)
+{
+    auto t = static_cast<bigint_test *>(test->data);
+    Stats stats[SizeCount];
+    uint64_t result[MaxLimbs];
+    int s = 0;
+
+    // the time of one modexp depends on the size and the instructions used
+    TEST_LOOP_AUTO(test, 1, 1 << 8) {
+        const Case &c = t->cases[s][random32() % CasesPerSize];
+
+        auto start = std::chrono::steady_clock::now();
+        ModExp(result, c);
+        stats[s].elapsed += std::chrono::steady_clock::now() - start;
+        stats[s].limb_mults += LimbMults(c) * montmul_count(c);
+
+        memcmp_or_fail(result, c.expected, c.mod.n, "%d-bit modular exponentiation", c.mod.bits);
+
+        if (++s == SizeCount)
+            s = 0;
+    };
+
+    std::string msg;
+    for (int s = 0; s < SizeCount; ++s) {
+        if (!stats[s].elapsed.count())
+            continue;
+        char buf[64];
+        snprintf(buf, sizeof(buf), "%s%d bits: %.1f M", msg.empty() ? "" : ", ", Sizes[s],
+                 1000.0 * stats[s].limb_mults / stats[s].elapsed.count());
+        msg += buf;
+    }
+    if (!msg.empty())
+        log_info("limb multiplications per second: %s", msg.c_str());
+    return EXIT_SUCCESS;
+}
+} // unnamed namespace
+
+DECLARE_TEST(bigint_adx, "Multiprecision modular exponentiation with MULX, ADCX and ADOX")
+    .test_init = bigint_init,
+    .test_run = bigint_run<modexp64<montmul_adx>, limb_mults_adx>,
+    .test_cleanup = bigint_cleanup,
+    .minimum_cpu = cpu_feature_bmi2 | cpu_feature_adx,
+    .desired_duration = 1000,
+    .quality_level = TEST_QUALITY_BETA,
+END_DECLARE_TEST
+
+DECLARE_TEST(bigint_ifma, "Multiprecision modular exponentiation with AVX-512 IFMA")
+    .test_init = bigint_init,
+    .test_run = bigint_run<modexp_ifma, limb_mults_ifma>,
+    .test_cleanup = bigint_cleanup,
+    .minimum_cpu = cpu_feature_avx512f | cpu_feature_avx512ifma,
+    .desired_duration = 1000,
+    .quality_level = TEST_QUALITY_BETA,
+END_DECLARE_TEST
+
+#endif // __x86_64__
@@ -0,0 +1,338 @@
+/**
+ * @file
+ *
+ * @copyright
+ * Copyright 2024 Intel Corporation.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * @test @b cache_coherency_smt
+ * @test @b cache_coherency_core
+ * @test @b cache_coherency_socket
+ * @parblock
+ * These tests pair up threads and have them bounce cacheline-sized
+ * messages back and forth, each carrying a sequence number, a payload and
+ * a checksum. The responder validates every message it receives and
+ * replies with the complemented payload, which the initiator validates in
+ * turn. This makes the cache lines migrate between the two logical
+ * processors on every exchange, exercising the coherency fabric between
+ * them.
+ *
+ * The pairs are chosen from the topology:
+ *  - cache_coherency_smt pairs the SMT siblings of each core
+ *  - cache_coherency_core pairs threads of different cores in the same socket
+ *  - cache_coherency_socket pairs threads of different sockets
+ *
+ * Threads that have no partner of the requested class are skipped. Each
+ * thread of a pair stops when its time is up or when its partner stops, so
+ * a failure is only reported by the thread that detected it. The
+ * distribution of the round-trip latency is logged at the end of the run,
+ * when verbose logging is enabled.
+ * @endparblock
+ */
+
+#include <sandstone.h>
+#include "topology.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <vector>
+
+#include <inttypes.h>
+
+namespace {
+constexpr int RoundTripsPerLoop = 4096;
+constexpr auto PartnerTimeout = std::chrono::seconds(10);
+constexpr uint64_t DoneSequence = UINT64_MAX;
+
+// bucket N counts round trips of less than 2^(N + FirstBucketShift) ns
+constexpr int FirstBucketShift = 6;     // 64 ns
+constexpr int BucketCount = 12;         // up to 128 us, last bucket is everything else
+
+enum PairingClass { SmtSiblings, SameSocket, CrossSocket };
+
+struct alignas(64) Message
+{
+    static constexpr int PayloadWords = 6;
+    std::atomic<uint64_t> sequence;
+    uint64_t payload[PayloadWords];
+    uint64_t checksum;
+};
+static_assert(sizeof(Message) == 64);
+
+struct Mailbox
+{
+    Message ping;               // written by the initiator
+    Message pong;               // written by the responder
+};
+
+struct ThreadState
+{
+    int partner = -1;
+    bool initiator = false;
+    Mailbox *mailbox = nullptr;
+    uint64_t round_trips = 0;
+    uint64_t histogram[BucketCount] = {};
+};
+
+struct CoherencyTest
+{
+    PairingClass pairing;
+    std::vector<Mailbox *> mailboxes;
+    std::vector<ThreadState> threads;
+};
+
+uint64_t checksum(uint64_t sequence, const uint64_t (&payload)[Message::PayloadWords])
+{
+    uint64_t sum = sequence;
+    for (uint64_t word : payload)
+        sum = ((sum << 7) | (sum >> 57)) ^ word;
+    return sum;
+}
+
+void expected_payload(uint64_t (&payload)[Message::PayloadWords], uint64_t seed, uint64_t sequence,
+                      bool reply)
+{
+    for (int i = 0; i < Message::PayloadWords; ++i) {
+        payload[i] = (sequence * 0x9e3779b97f4a7c15 + i) ^ seed;
+        if (reply)
+            payload[i] = ~payload[i];
+    }
+}
+
+// Publishes the "done" marker when the thread leaves test_run(), including
+// through report_fail_msg(), so the partner doesn't wait for it
+struct DoneOnExit
+{
+    Message &msg;
+    ~DoneOnExit() { msg.sequence.store(DoneSequence, std::memory_order_release); }
+};
+
+void send(Message &msg, uint64_t seed, uint64_t sequence, bool reply)
+{
+    expected_payload(msg.payload, seed, sequence, reply);
+    msg.checksum = checksum(sequence, msg.payload);
+    msg.sequence.store(sequence, std::memory_order_release);
+}
+
+// Waits for the message with the given sequence number, then validates it.
+// Returns false if the partner left instead or stopped responding.
+bool receive(const Message &msg, uint64_t seed, uint64_t sequence, bool reply, int partner)
+{
+    uint64_t got;
+    unsigned spins = 0;
+    auto deadline = std::chrono::steady_clock::time_point{};
+    while ((got = msg.sequence.load(std::memory_order_acquire)) != sequence) {
+        if (got == DoneSequence)
+            return false;
+        if (++spins % 1024)
+            continue;
+        auto now = std::chrono::steady_clock::now();
+        if (deadline == decltype(deadline){}) {
+            deadline = now + PartnerTimeout;
+        } else if (now > deadline) {
+            // it's the partner that is stuck, not us
+            log_warning("Thread %d stopped responding: waiting for sequence %#" PRIx64
+                        ", last seen %#" PRIx64, partner, sequence, got);
+            return false;
+        }
+    }
+
+    uint64_t expected[Message::PayloadWords];
+    expected_payload(expected, seed, sequence, reply);
+    memcmp_or_fail(msg.payload, expected, Message::PayloadWords,
+                   "payload of message %#" PRIx64 " from thread %d", sequence, partner);
+    if (msg.checksum != checksum(sequence, msg.payload))
+        report_fail_msg("Checksum mismatch in message %#" PRIx64 " from thread %d: "
+                        "expected %#018" PRIx64 ", got %#018" PRIx64, sequence, partner,
+                        checksum(sequence, msg.payload), msg.checksum);
+    return true;
+}
+
+void record_round_trip(ThreadState &state, std::chrono::nanoseconds elapsed)
+{
+    int bucket = 0;
+    while (bucket < BucketCount - 1 && elapsed.count() >= (int64_t(1) << (bucket + FirstBucketShift)))
+        ++bucket;
+    ++state.histogram[bucket];
+    ++state.round_trips;
+}
+
+void add_pair(CoherencyTest *t, const Topology::Thread &a, const Topology::Thread &b)
+{
+    auto mailbox = new Mailbox;
+    mailbox->ping.sequence.store(0, std::memory_order_relaxed);
+    mailbox->pong.sequence.store(0, std::memory_order_relaxed);
+    t->mailboxes.push_back(mailbox);
+    t->threads[a.cpu()] = { .partner = b.cpu(), .initiator = true, .mailbox = mailbox };
+    t->threads[b.cpu()] = { .partner = a.cpu(), .initiator = false, .mailbox = mailbox };
+}
+
+void pair_cores(CoherencyTest *t, const Topology::Core &c1, const Topology::Core &c2)
+{
+    size_t n = std::min(c1.threads.size(), c2.threads.size());
+    for (size_t i = 0; i < n; ++i)
+        add_pair(t, c1.threads[i], c2.threads[i]);
+}
+
+void build_pairs(CoherencyTest *t)
+{
+    const Topology &topology = Topology::topology();
+    switch (t->pairing) {
+    case SmtSiblings:
+        for (const Topology::Package &pkg : topology.packages) {
+            for (const Topology::Core &core : pkg.cores) {
+                for (size_t i = 0; i + 1 < core.threads.size(); i += 2)
+                    add_pair(t, core.threads[i], core.threads[i + 1]);
+            }
+        }
+        break;
+
+    case SameSocket:
+        for (const Topology::Package &pkg : topology.packages) {
+            for (size_t i = 0; i + 1 < pkg.cores.size(); i += 2)
+                pair_cores(t, pkg.cores[i], pkg.cores[i + 1]);
+        }
+        break;
+
+    case CrossSocket:
+        for (size_t p = 0; p + 1 < topology.packages.size(); p += 2) {
+            const Topology::Package &pkg1 = topology.packages[p];
+            const Topology::Package &pkg2 = topology.packages[p + 1];
+            size_t n = std::min(pkg1.cores.size(), pkg2.cores.size());
+            for (size_t i = 0; i < n; ++i)
+                pair_cores(t, pkg1.cores[i], pkg2.cores[i]);
+        }
+        break;
+    }
+}
+
+const char *pairing_name(PairingClass pairing)
+{
+    switch (pairing) {
+    case SmtSiblings:   return "SMT siblings";
+    case SameSocket:    return "cores in the same socket";
+    case CrossSocket:   return "cores in different sockets";
+    }
+    __builtin_unreachable();
+}
+} // unnamed namespace
+
+template <PairingClass Pairing> static int coherency_init(struct test *test)
+{
+    auto t = new CoherencyTest;
+    t->pairing = Pairing;
+    t->threads.resize(num_cpus());
+    build_pairs(t);
+
+    if (t->mailboxes.empty()) {
+        delete t;
+        log_skip(CpuTopologyIssueSkipCategory, "No pairs of %s to test", pairing_name(Pairing));
+        return EXIT_SKIP;
+    }
+    test->data = t;
+    return EXIT_SUCCESS;
+}
+
+static int coherency_run(struct test *test, int cpu)
+{
+    auto t = static_cast<CoherencyTest *>(test->data);
+    ThreadState &state = t->threads[cpu];
+    if (state.partner < 0) {
+        log_skip(CpuTopologyIssueSkipCategory, "No partner thread for this logical processor");
+        return EXIT_SKIP;
+    }
+
+    Mailbox *mailbox = state.mailbox;
+    uint64_t seed = reinterpret_cast<uintptr_t>(mailbox);
+    uint64_t sequence = 0;
+    Message &inbox = state.initiator ? mailbox->pong : mailbox->ping;
+    Message &outbox = state.initiator ? mailbox->ping : mailbox->pong;
+    DoneOnExit done_on_exit{ outbox };
+
+    TEST_LOOP(test, 1) {
+        bool partner_left = false;
+        for (int i = 0; i < RoundTripsPerLoop && !partner_left; ++i) {
+            ++sequence;
+            if (state.initiator) {
+                auto start = std::chrono::steady_clock::now();
+                send(outbox, seed, sequence, false);
+                partner_left = !receive(inbox, seed, sequence, true, state.partner);
+                if (!partner_left)
+                    record_round_trip(state, std::chrono::steady_clock::now() - start);
+            } else {
+                partner_left = !receive(inbox, seed, sequence, false, state.partner);
+                if (!partner_left)
+                    send(outbox, seed, sequence, true);
+            }
+        }
+        if (partner_left)
+            break;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+static int coherency_cleanup(struct test *test)
+{
+    auto t = static_cast<CoherencyTest *>(test->data);
+    if (!t)
+        return EXIT_SUCCESS;
+
+    uint64_t histogram[BucketCount] = {};
+    uint64_t round_trips = 0;
+    for (const ThreadState &state : t->threads) {
+        round_trips += state.round_trips;
+        for (int i = 0; i < BucketCount; ++i)
+            histogram[i] += state.histogram[i];
+    }
+
+    if (round_trips) {
+        log_info("%zu pairs of %s, %" PRIu64 " round trips", t->mailboxes.size(),
+                 pairing_name(t->pairing), round_trips);
+        for (int i = 0; i < BucketCount; ++i) {
+            if (!histogram[i])
+                continue;
+            if (i == BucketCount - 1)
+                log_info("  >= %6d ns: %5.1f%%", 1 << (i - 1 + FirstBucketShift),
+                         100.0 * histogram[i] / round_trips);
+            else
+                log_info("  < %7d ns: %5.1f%%", 1 << (i + FirstBucketShift),
+                         100.0 * histogram[i] / round_trips);
+        }
+    }
+
+    for (Mailbox *mailbox : t->mailboxes)
+        delete mailbox;
+    delete t;
+    return EXIT_SUCCESS;
+}
+
+DECLARE_TEST(cache_coherency_smt, "Cache coherency ping-pong between SMT siblings")
+    .test_init = coherency_init<SmtSiblings>,
+    .test_run = coherency_run,
+    .test_cleanup = coherency_cleanup,
+    .desired_duration = 1000,
+    .fracture_loop_count = -1,
+    .quality_level = TEST_QUALITY_BETA,
+END_DECLARE_TEST
+
+DECLARE_TEST(cache_coherency_core, "Cache coherency ping-pong between cores of the same socket")
+    .test_init = coherency_init<SameSocket>,
+    .test_run = coherency_run,
+    .test_cleanup = coherency_cleanup,
+    .desired_duration = 1000,
+    .fracture_loop_count = -1,
+    .quality_level = TEST_QUALITY_BETA,
+END_DECLARE_TEST
+
+DECLARE_TEST(cache_coherency_socket, "Cache coherency ping-pong between sockets")
+    .test_init = coherency_init<CrossSocket>,
+    .test_run = coherency_run,
+    .test_cleanup = coherency_cleanup,
+    .desired_duration = 1000,
+    .fracture_loop_count = -1,
+    .quality_level = TEST_QUALITY_BETA,
+    .flags = test_schedule_fullsystem,
+END_DECLARE_TEST
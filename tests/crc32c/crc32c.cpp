@@ -0,0 +1,136 @@
+/**
+ * @file
+ *
+ * @copyright
+ * Copyright 2024 Intel Corporation.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * @test @b crc32c
+ * @parblock
+ * This test computes the CRC-32C of large random buffers with each of the
+ * framework's implementations: the SSE 4.2 CRC32 instruction, PCLMULQDQ
+ * folding and, if the CPU supports it, 512-bit VPCLMULQDQ folding. Every
+ * result is compared to the one of a table-driven implementation that uses
+ * only ordinary integer instructions.
+ *
+ * Each iteration fills a new buffer, then checksums it at a random
+ * misalignment and length several times with every implementation and
+ * once more in two pieces, to exercise the incremental form. The
+ * throughput of each implementation is logged at the end of the run.
+ *
+ * The buffer size can be changed with the buffer_size knob (default 256
+ * kB).
+ * @endparblock
+ */
+
+#include <sandstone.h>
+#include <sandstone_checksum.h>
+
+#include <chrono>
+#include <iterator>
+
+namespace {
+constexpr size_t DefaultBufferSize = 256 * 1024;
+constexpr int RoundsPerLoop = 8;
+
+struct Implementation
+{
+    uint32_t (*fn)(uint32_t crc, const void *data, size_t len);
+    const char *name;
+};
+
+const Implementation implementations[] = {
+    { crc32c_sse42, "CRC32" },
+    { crc32c_pclmul, "PCLMULQDQ" },
+    { crc32c_vpclmul, "VPCLMULQDQ" },
+};
+constexpr int ImplementationCount = std::size(implementations);
+
+struct crc32c_test
+{
+    size_t buffer_size;
+    bool have_vpclmul;
+};
+
+struct Stats
+{
+    uint64_t bytes = 0;
+    std::chrono::nanoseconds elapsed = {};
+};
+
+void check_crc(const Implementation &impl, uint32_t crc, uint32_t expected, size_t offset, size_t len)
+{
+    if (crc != expected)
+        report_fail_msg("%s CRC-32C of %zu bytes at offset %zu was 0x%08x, expected 0x%08x",
+                        impl.name, len, offset, crc, expected);
+}
+} // unnamed namespace
+
+static int crc32c_init(struct test *test)
+{
+    auto t = new crc32c_test;
+    t->buffer_size = get_testspecific_knob_value_uint(test, "buffer_size", DefaultBufferSize);
+    if (t->buffer_size < 4096)
+        t->buffer_size = 4096;
+    t->have_vpclmul = cpu_has_feature(cpu_feature_avx512f | cpu_feature_vpclmulqdq);
+    if (!t->have_vpclmul)
+        log_info("VPCLMULQDQ not available, skipping that implementation");
+    test->data = t;
+    return EXIT_SUCCESS;
+}
+
+static int crc32c_cleanup(struct test *test)
+{
+    delete static_cast<crc32c_test *>(test->data);
+    return EXIT_SUCCESS;
+}
+
+static int crc32c_run(struct test *test, int cpu)
+{
+    auto t = static_cast<crc32c_test *>(test->data);
+    int count = t->have_vpclmul ? ImplementationCount : ImplementationCount - 1;
+    Stats stats[ImplementationCount];
+
+    // extra room for the misalignment
+    size_t alloc_size = t->buffer_size + 64;
+    auto buffer = static_cast<uint8_t *>(aligned_alloc_safe(64, alloc_size));
+
+    TEST_LOOP(test, 1) {
+        memset_random(buffer, alloc_size);
+        size_t offset = random32() % 64;
+        size_t len = t->buffer_size - random32() % 4096;
+        const uint8_t *data = buffer + offset;
+        uint32_t expected = crc32c_table(0, data, len);
+
+        for (int i = 0; i < count; ++i) {
+            const Implementation &impl = implementations[i];
+            auto start = std::chrono::steady_clock::now();
+            for (int round = 0; round < RoundsPerLoop; ++round)
+                check_crc(impl, impl.fn(0, data, len), expected, offset, len);
+            stats[i].elapsed += std::chrono::steady_clock::now() - start;
+            stats[i].bytes += RoundsPerLoop * len;
+
+            size_t split = random32() % len;
+            uint32_t crc = impl.fn(0, data, split);
+            check_crc(impl, impl.fn(crc, data + split, len - split), expected, offset, len);
+        }
+    }
+
+    free(buffer);
+
+    for (int i = 0; i < count; ++i) {
+        if (stats[i].elapsed.count())
+            log_info("%s: %.2f GB/s", implementations[i].name,
+                     double(stats[i].bytes) / stats[i].elapsed.count());
+    }
+    return EXIT_SUCCESS;
+}
+
+DECLARE_TEST(crc32c, "CRC-32C with the CRC32 instruction and carry-less multiplication folding")
+    .test_init = crc32c_init,
+    .test_run = crc32c_run,
+    .test_cleanup = crc32c_cleanup,
+    .minimum_cpu = cpu_feature_sse4_2 | cpu_feature_pclmul,
+    .desired_duration = 1000,
+    .quality_level = TEST_QUALITY_BETA,
+END_DECLARE_TEST
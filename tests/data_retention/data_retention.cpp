@@ -0,0 +1,233 @@
+/**
+ * @file
+ *
+ * @copyright
+ * Copyright 2024 Intel Corporation.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * @test @b data_retention
+ * @parblock
+ * This test checks that data left untouched keeps its value. Every other
+ * test rewrites its data constantly, so it can't find cells that slowly
+ * lose their contents.
+ *
+ * Each thread fills two buffers once, with a pattern derived from a
+ * random64() seed and the thread's CPU number, and records the CRC-32C of
+ * each 4 kB block:
+ *  - a cache-sized buffer, half of the thread's L2 cache, which stays
+ *    resident in the cache between the scans
+ *  - a share of a large fraction of the system's memory (see the
+ *    "memory_percent" knob, default 10%)
+ *
+ * The thread then rescans both buffers, comparing the checksums. The
+ * cache-sized buffer is rescanned in full on every loop iteration; the
+ * memory buffer is scrubbed a bounded range of blocks at a time, round
+ * robin, with the sleep between iterations scaled so that a full pass over
+ * it takes about the scrub interval (see the "scrub_interval_ms" knob,
+ * default 100 ms) or as long as the scan itself, whichever is longer.
+ *
+ * The data is never rewritten, so the test only finds cells that lose
+ * their contents over time if it is run for a long time, on its own: the
+ * framework runs one test at a time, so select it with -e data_retention
+ * and set the soak duration with --test-time (e.g. --test-time=1h).
+ *
+ * Blocks whose checksum does not match are compared word by word against
+ * the pattern and each corrupt word is reported with its virtual and
+ * physical addresses (the latter only if running as root) and the bits
+ * that flipped.
+ * @endparblock
+ */
+
+#include <sandstone.h>
+#include <sandstone_checksum.h>
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
+
+namespace {
+constexpr size_t BlockSize = 4096;
+constexpr size_t WordsPerBlock = BlockSize / sizeof(uint64_t);
+constexpr size_t MinMemorySize = 1024 * 1024;       // per thread
+constexpr size_t MinCacheSize = 64 * 1024;
+constexpr int DefaultMemoryPercent = 10;
+constexpr int DefaultScrubIntervalMs = 100;
+constexpr size_t ScrubBlocksPerLoop = 4096;         // 16 MB of the memory buffer
+constexpr int MaxReportedWords = 16;                // per block
+
+struct RetentionTest
+{
+    size_t memory_size;             // per thread
+    std::chrono::milliseconds scrub_interval;
+};
+
+struct Region
+{
+    const char *name;
+    uint64_t *data;
+    size_t blocks;
+    uint64_t seed;
+    uint32_t *crcs;                 // one per block
+};
+
+// SplitMix64's finalizer, so neighbouring words are uncorrelated
+uint64_t pattern_word(uint64_t seed, size_t index)
+{
+    uint64_t z = seed + index * UINT64_C(0x9e3779b97f4a7c15);
+    z = (z ^ (z >> 30)) * UINT64_C(0xbf58476d1ce4e5b9);
+    z = (z ^ (z >> 27)) * UINT64_C(0x94d049bb133111eb);
+    z ^= z >> 31;
+
+    // odd blocks are inverted, so every cell holds both 0 and 1 across blocks
+    return (index / WordsPerBlock) & 1 ? ~z : z;
+}
+
+void fill_region(Region &r, size_t size, uint64_t seed, const char *name)
+{
+    r.name = name;
+    r.blocks = size / BlockSize;
+    r.seed = seed;
+    r.data = static_cast<uint64_t *>(aligned_alloc_safe(BlockSize, r.blocks * BlockSize));
+    r.crcs = new uint32_t[r.blocks];
+    for (size_t b = 0; b < r.blocks; ++b) {
+        uint64_t *block = r.data + b * WordsPerBlock;
+        for (size_t i = 0; i < WordsPerBlock; ++i)
+            block[i] = pattern_word(seed, b * WordsPerBlock + i);
+        r.crcs[b] = crc32c(0, block, BlockSize);
+    }
+}
+
+void free_region(Region &r)
+{
+    delete[] r.crcs;
+    free(r.data);
+}
+
+[[noreturn]] void report_corruption(const Region &r, size_t b, std::chrono::seconds age)
+{
+    const volatile uint64_t *block = r.data + b * WordsPerBlock;
+    int bad_words = 0;
+    for (size_t i = 0; i < WordsPerBlock; ++i) {
+        uint64_t expected = pattern_word(r.seed, b * WordsPerBlock + i);
+        uint64_t actual = block[i];
+        if (actual == expected)
+            continue;
+        if (++bad_words > MaxReportedWords)
+            continue;
+
+        char bits[64 * 4] = "";
+        size_t len = 0;
+        for (uint64_t diff = actual ^ expected; diff && len < sizeof(bits) - 4; diff &= diff - 1)
+            len += snprintf(bits + len, sizeof(bits) - len, "%s%d", len ? "," : "", __builtin_ctzll(diff));
+        log_error("%s corrupt at %p (physical %#" PRIx64 "): %#018" PRIx64 ", expected %#018" PRIx64
+                  ", flipped bits %s", r.name, &block[i], retrieve_physical_address(&block[i]),
+                  actual, expected, bits);
+    }
+
+    if (bad_words == 0)
+        report_fail_msg("%s block at %p: CRC-32C mismatch after %lld s, but the contents match on re-read",
+                        r.name, block, (long long)age.count());
+    report_fail_msg("%s block at %p: %d corrupt words after %lld s", r.name, block, bad_words,
+                    (long long)age.count());
+}
+
+void scrub_blocks(const Region &r, size_t first, size_t count, std::chrono::seconds age)
+{
+    for (size_t b = first; b < first + count; ++b) {
+        if (crc32c(0, r.data + b * WordsPerBlock, BlockSize) != r.crcs[b])
+            report_corruption(r, b, age);
+    }
+}
+
+size_t default_memory_size(int percent)
+{
+    size_t total = 0;
+#if defined(_SC_PHYS_PAGES) && defined(_SC_PAGESIZE)
+    long pages = sysconf(_SC_PHYS_PAGES);
+    long page_size = sysconf(_SC_PAGESIZE);
+    if (pages > 0 && page_size > 0)
+        total = size_t(pages) * size_t(page_size);
+#endif
+    // each slice runs this test at the same time, so divide by the threads
+    // of all the slices, not by those of this one
+    size_t size = total / 100 * percent / num_cpus_total();
+    return std::max(size, MinMemorySize);
+}
+} // unnamed namespace
+
+static int retention_init(struct test *test)
+{
+    auto t = new RetentionTest;
+    int percent = get_testspecific_knob_value_uint(test, "memory_percent", DefaultMemoryPercent);
+    if (percent < 1 || percent > 90) {
+        log_error("memory_percent must be between 1 and 90, got %d", percent);
+        delete t;
+        return EXIT_FAILURE;
+    }
+    t->memory_size = default_memory_size(percent) & ~(BlockSize - 1);
+    t->scrub_interval = std::chrono::milliseconds(
+                get_testspecific_knob_value_uint(test, "scrub_interval_ms", DefaultScrubIntervalMs));
+    test->data = t;
+    return EXIT_SUCCESS;
+}
+
+static int retention_run(struct test *test, int cpu)
+{
+    auto t = static_cast<RetentionTest *>(test->data);
+    size_t cache_size = cpu_info[cpu].cache[1].cache_data > 0 ? cpu_info[cpu].cache[1].cache_data / 2 : 0;
+    cache_size = std::max(cache_size, MinCacheSize) & ~(BlockSize - 1);
+
+    // the CPU number is in the top bits, so no two threads share a pattern
+    uint64_t seed = (random64() >> 16) | (uint64_t(cpu_info[cpu].cpu_number) << 48);
+    Region cache_region, memory_region;
+    fill_region(cache_region, cache_size, seed, "Cache-resident buffer");
+    fill_region(memory_region, t->memory_size, ~seed, "Memory buffer");
+
+    // a full pass over the memory buffer takes memory_region.blocks / chunk
+    // iterations, so each sleeps that fraction of the scrub interval
+    size_t chunk = std::min(memory_region.blocks, ScrubBlocksPerLoop);
+    auto sleep_time = std::chrono::microseconds(t->scrub_interval) * chunk / memory_region.blocks;
+
+    auto filled = std::chrono::steady_clock::now();
+    uint64_t scans = 0;
+    size_t next_block = 0;
+    TEST_LOOP(test, 1) {
+        std::this_thread::sleep_for(sleep_time);
+        auto age = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now() - filled);
+        scrub_blocks(cache_region, 0, cache_region.blocks, age);
+
+        size_t count = std::min(chunk, memory_region.blocks - next_block);
+        scrub_blocks(memory_region, next_block, count, age);
+        next_block += count;
+        if (next_block == memory_region.blocks) {
+            next_block = 0;
+            ++scans;
+        }
+    }
+
+    log_info("%" PRIu64 " full scans of %zu kB in cache and %zu MB in memory, data retained for %.1f s", scans,
+             cache_size / 1024, t->memory_size / (1024 * 1024),
+             std::chrono::duration<double>(std::chrono::steady_clock::now() - filled).count());
+    free_region(memory_region);
+    free_region(cache_region);
+    return EXIT_SUCCESS;
+}
+
+static int retention_cleanup(struct test *test)
+{
+    delete static_cast<RetentionTest *>(test->data);
+    return EXIT_SUCCESS;
+}
+
+DECLARE_TEST(data_retention, "Fills memory and caches once, then periodically verifies the data was retained")
+    .test_init = retention_init,
+    .test_run = retention_run,
+    .test_cleanup = retention_cleanup,
+    .desired_duration = 5000,
+    .quality_level = TEST_QUALITY_BETA,
+    .flags = test_flag_ignore_memory_use,
+END_DECLARE_TEST
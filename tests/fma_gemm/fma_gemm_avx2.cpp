@@ -0,0 +1,58 @@
+/**
+ * @file
+ *
+ * @copyright
+ * Copyright 2024 Intel Corporation.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * @test @b fma_gemm_avx2
+ * @parblock
+ * This test keeps the FMA units busy with a register-blocked single
+ * precision matrix multiplication microkernel written with AVX2
+ * intrinsics, independent of the kernels Eigen selects. A 6x16 block of
+ * the result stays in 12 YMM registers while it accumulates 64 passes
+ * over a 6x128 panel of A and a 128x16 panel of B, both resident in the
+ * L1 cache.
+ *
+ * The expected result is computed in test_init with scalar fused
+ * multiply-adds in the same order, so every result is compared bit for
+ * bit. Each thread logs the GFLOPS it achieved and the FLOP per TSC cycle
+ * compared to the theoretical peak of two 256-bit FMA units.
+ * @endparblock
+ */
+
+#include "fma_gemm_common.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+
+namespace {
+struct Avx2Traits
+{
+    using Vector = __m256;
+    static constexpr int Lanes = 8;
+    static constexpr int Rows = 6;
+    static constexpr int Cols = 2;
+    static constexpr int PeakFlopsPerCycle = 2 * 2 * Lanes;  // 2 FMA units
+    static constexpr const char *Name = "AVX2";
+
+    static Vector zero()                                { return _mm256_setzero_ps(); }
+    static Vector broadcast(float f)                    { return _mm256_set1_ps(f); }
+    static Vector load(const float *p)                  { return _mm256_load_ps(p); }
+    static void store(float *p, Vector v)               { _mm256_store_ps(p, v); }
+    static Vector fma(Vector a, Vector b, Vector c)     { return _mm256_fmadd_ps(a, b, c); }
+};
+} // unnamed namespace
+
+using fma_gemm_avx2_test = FmaGemmTest<Avx2Traits>;
+DECLARE_TEST(fma_gemm_avx2, "Register-blocked FMA matrix multiplication microkernel (AVX2)")
+  .groups = DECLARE_TEST_GROUPS(&group_math),
+  .test_init = fma_gemm_avx2_test::init,
+  .test_run = fma_gemm_avx2_test::run,
+  .test_cleanup = fma_gemm_avx2_test::cleanup,
+  .minimum_cpu = cpu_feature_avx2 | cpu_feature_fma,
+  .desired_duration = 1000,
+  .quality_level = TEST_QUALITY_BETA,
+END_DECLARE_TEST
+
+#endif // __x86_64__
@@ -0,0 +1,49 @@
+/**
+ * @file
+ *
+ * @copyright
+ * Copyright 2024 Intel Corporation.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * @test @b fma_gemm_avx512
+ * @parblock
+ * This is the AVX-512 version of fma_gemm_avx2: a 12x32 block of the
+ * result stays in 24 ZMM registers while it accumulates 64 passes over a
+ * 12x128 panel of A and a 128x32 panel of B. The theoretical peak used
+ * for the logged efficiency assumes two 512-bit FMA units; parts with one
+ * will report at most 50%.
+ * @endparblock
+ */
+
+#include "fma_gemm_common.h"
+
+#include <immintrin.h>
+
+namespace {
+struct Avx512Traits
+{
+    using Vector = __m512;
+    static constexpr int Lanes = 16;
+    static constexpr int Rows = 12;
+    static constexpr int Cols = 2;
+    static constexpr int PeakFlopsPerCycle = 2 * 2 * Lanes;  // 2 FMA units
+    static constexpr const char *Name = "AVX-512";
+
+    static Vector zero()                                { return _mm512_setzero_ps(); }
+    static Vector broadcast(float f)                    { return _mm512_set1_ps(f); }
+    static Vector load(const float *p)                  { return _mm512_load_ps(p); }
+    static void store(float *p, Vector v)               { _mm512_store_ps(p, v); }
+    static Vector fma(Vector a, Vector b, Vector c)     { return _mm512_fmadd_ps(a, b, c); }
+};
+} // unnamed namespace
+
+using fma_gemm_avx512_test = FmaGemmTest<Avx512Traits>;
+DECLARE_TEST(fma_gemm_avx512, "Register-blocked FMA matrix multiplication microkernel (AVX-512)")
+  .groups = DECLARE_TEST_GROUPS(&group_math),
+  .test_init = fma_gemm_avx512_test::init,
+  .test_run = fma_gemm_avx512_test::run,
+  .test_cleanup = fma_gemm_avx512_test::cleanup,
+  .minimum_cpu = cpu_skylake_avx512,
+  .desired_duration = 1000,
+  .quality_level = TEST_QUALITY_BETA,
+END_DECLARE_TEST
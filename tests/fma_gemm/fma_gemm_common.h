@@ -0,0 +1,156 @@
+/**
+ * @file
+ *
+ * @copyright
+ * Copyright 2024 Intel Corporation.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef SANDSTONE_FMA_GEMM_COMMON_H
+#define SANDSTONE_FMA_GEMM_COMMON_H
+
+#include <sandstone.h>
+
+#if defined(__x86_64__)
+#include <chrono>
+#include <type_traits>
+
+#include <math.h>
+#include <x86intrin.h>
+
+namespace {
+// A register-blocked single precision GEMM microkernel: a Rows x (Cols *
+// Lanes) block of C stays in vector registers while it accumulates the
+// products of a Rows x K panel of A (broadcast one element at a time) and
+// a K x (Cols * Lanes) panel of B.
+//
+// The Traits class provides the vector type and operations:
+//   Vector, Lanes, Rows, Cols, PeakFlopsPerCycle, Name,
+//   zero(), broadcast(), load(), store(), fma()
+template <typename Traits> struct FmaGemmTest
+{
+    using Vector = typename Traits::Vector;
+    static constexpr int Rows = Traits::Rows;
+    static constexpr int Cols = Traits::Cols;
+    static constexpr int NR = Cols * Traits::Lanes;
+    static constexpr int K = 128;           // A and B panels fit in L1
+    static constexpr int Passes = 64;       // over the panels, before storing C
+    static constexpr int CallsPerLoop = 16;
+    static constexpr double FlopsPerCall = 2.0 * Rows * NR * K * Passes;
+
+    struct fma_gemm_data {
+        alignas(64) float a[K][Rows];       // packed: one column of A per k
+        alignas(64) float b[K][NR];
+        alignas(64) float golden[Rows][NR];
+        struct {
+            uint64_t calls;
+            uint64_t tsc_cycles;
+            std::chrono::nanoseconds elapsed;
+        } *per_thread;
+    };
+
+    [[gnu::noinline]] static void microkernel(const fma_gemm_data *d, float (&c)[Rows][NR])
+    {
+        Vector acc[Rows][Cols];
+#pragma GCC unroll 16
+        for (int i = 0; i < Rows; ++i) {
+#pragma GCC unroll 4
+            for (int j = 0; j < Cols; ++j)
+                acc[i][j] = Traits::zero();
+        }
+
+        for (int pass = 0; pass < Passes; ++pass) {
+            for (int k = 0; k < K; ++k) {
+                Vector b[Cols];
+#pragma GCC unroll 4
+                for (int j = 0; j < Cols; ++j)
+                    b[j] = Traits::load(&d->b[k][j * Traits::Lanes]);
+#pragma GCC unroll 16
+                for (int i = 0; i < Rows; ++i) {
+                    Vector a = Traits::broadcast(d->a[k][i]);
+#pragma GCC unroll 4
+                    for (int j = 0; j < Cols; ++j)
+                        acc[i][j] = Traits::fma(a, b[j], acc[i][j]);
+                }
+            }
+        }
+
+#pragma GCC unroll 16
+        for (int i = 0; i < Rows; ++i) {
+#pragma GCC unroll 4
+            for (int j = 0; j < Cols; ++j)
+                Traits::store(&c[i][j * Traits::Lanes], acc[i][j]);
+        }
+    }
+
+    static int init(struct test *test)
+    {
+        auto d = new fma_gemm_data;
+        for (int k = 0; k < K; ++k) {
+            for (int i = 0; i < Rows; ++i)
+                d->a[k][i] = frandomf_scale(2.0f) - 1.0f;
+            for (int j = 0; j < NR; ++j)
+                d->b[k][j] = frandomf_scale(2.0f) - 1.0f;
+        }
+
+        // scalar reference, fused multiply-adds in the same order as the
+        // microkernel so the result is bit-exact
+        for (int i = 0; i < Rows; ++i) {
+            for (int j = 0; j < NR; ++j) {
+                float sum = 0;
+                for (int pass = 0; pass < Passes; ++pass) {
+                    for (int k = 0; k < K; ++k)
+                        sum = fmaf(d->a[k][i], d->b[k][j], sum);
+                }
+                d->golden[i][j] = sum;
+            }
+        }
+
+        d->per_thread = new std::remove_pointer_t<decltype(d->per_thread)>[num_cpus()]();
+        test->data = d;
+        return EXIT_SUCCESS;
+    }
+
+    static int cleanup(struct test *test)
+    {
+        auto d = static_cast<fma_gemm_data *>(test->data);
+        if (d) {
+            delete[] d->per_thread;
+            delete d;
+        }
+        return EXIT_SUCCESS;
+    }
+
+    static int run(struct test *test, int cpu)
+    {
+        auto d = static_cast<fma_gemm_data *>(test->data);
+        auto &stats = d->per_thread[cpu];
+        alignas(64) float c[Rows][NR];
+
+        TEST_LOOP_AUTO(test, 1, 1 << 10) {
+            auto start = std::chrono::steady_clock::now();
+            uint64_t tsc_start = __rdtsc();
+            for (int i = 0; i < CallsPerLoop; ++i) {
+                microkernel(d, c);
+                memcmp_or_fail(&c[0][0], &d->golden[0][0], Rows * NR, "%s microkernel result", Traits::Name);
+            }
+            stats.tsc_cycles += __rdtsc() - tsc_start;
+            stats.elapsed += std::chrono::steady_clock::now() - start;
+            stats.calls += CallsPerLoop;
+        };
+
+        if (stats.elapsed.count() && stats.tsc_cycles) {
+            double flops = FlopsPerCall * stats.calls;
+            double per_cycle = flops / stats.tsc_cycles;
+            log_info("%s: %.1f GFLOPS, %.1f FLOP per TSC cycle (%.0f%% of the theoretical %d)",
+                     Traits::Name, flops / stats.elapsed.count(), per_cycle,
+                     100.0 * per_cycle / Traits::PeakFlopsPerCycle, Traits::PeakFlopsPerCycle);
+        }
+        return EXIT_SUCCESS;
+    }
+};
+} // unnamed namespace
+
+#endif // __x86_64__
+
+#endif // SANDSTONE_FMA_GEMM_COMMON_H
@@ -0,0 +1,180 @@
+/**
+ * @file
+ *
+ * @copyright
+ * Copyright 2024 Intel Corporation.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * @test @b fp16_conversion
+ * @parblock
+ * This test stresses the half-precision conversion units. It converts all
+ * 65536 FP16 encodings to single precision and a large set of FP32 values
+ * (random bit patterns, values in the FP16 range and the framework's
+ * static floating point vectors) to FP16 and BF16, with every hardware
+ * implementation the CPU supports: F16C, AVX-512 FP16 and AVX-512 BF16.
+ * The results must be bit-identical to the framework's emulated
+ * conversions, which are computed in test_init.
+ *
+ * Each conversion starts at a random offset and has a random length, so
+ * the implementations' unaligned accesses and tails are exercised. Each
+ * thread logs the conversion rate of each implementation.
+ * @endparblock
+ */
+
+#include <sandstone.h>
+#include "fp_vectors/static_vectors.h"
+
+#include <chrono>
+#include <iterator>
+
+namespace {
+constexpr size_t EncodingCount = 65536;
+constexpr size_t FloatCount = 65536;
+constexpr size_t MaxOffset = 16;
+constexpr int ConversionsPerLoop = 4;   // of each kind, per implementation
+
+struct Implementation
+{
+    const char *name;
+    uint64_t features;
+    void (*tofp16)(Float16 *dst, const float *src, size_t count);
+    void (*fromfp16)(float *dst, const Float16 *src, size_t count);
+    void (*tobf16)(BFloat16 *dst, const float *src, size_t count);
+};
+
+const Implementation implementations[] = {
+    { "F16C", cpu_feature_f16c, tofp16_bulk_f16c, fromfp16_bulk_f16c, nullptr },
+    { "AVX512-FP16", cpu_feature_avx512fp16 | cpu_feature_avx512bw | cpu_feature_avx512vl,
+      tofp16_bulk_avx512fp16, fromfp16_bulk_avx512fp16, nullptr },
+    { "AVX512-BF16", cpu_feature_avx512bf16 | cpu_feature_avx512bw | cpu_feature_avx512vl,
+      nullptr, nullptr, tobf16_bulk_avx512bf16 },
+};
+constexpr int ImplementationCount = std::size(implementations);
+
+struct fp16_conversion_test
+{
+    Float16 encodings[EncodingCount];       // 0 to 65535
+    float floats[FloatCount];
+    float from_fp16[EncodingCount];
+    Float16 to_fp16[FloatCount];
+    BFloat16 to_bf16[FloatCount];
+};
+
+struct Stats
+{
+    uint64_t values = 0;
+    std::chrono::nanoseconds elapsed = {};
+};
+
+float random_input(int i)
+{
+    switch (i % 4) {
+    case 0:
+        // anywhere in the FP16 range, including its denormals
+        return randomize_sign_and_exponent_in_range_float32(new_random_float32(),
+                                                            FLOAT32_EXPONENT_BIAS - 25,
+                                                            FLOAT32_EXPONENT_BIAS + 16).as_float;
+    case 1:
+        return pick_randomized_float32_vector().as_float;
+    default:
+        return new_random_float32().as_float;
+    }
+}
+
+// a random sub-range of [0, size)
+void random_range(size_t size, size_t &offset, size_t &count)
+{
+    offset = random32() % MaxOffset;
+    count = size - offset - random32() % MaxOffset;
+}
+
+// times the conversion only, not the verification of its result
+template <typename Convert> void timed_conversion(Stats &stats, size_t count, Convert &&convert)
+{
+    auto start = std::chrono::steady_clock::now();
+    convert();
+    stats.elapsed += std::chrono::steady_clock::now() - start;
+    stats.values += count;
+}
+} // unnamed namespace
+
+static int fp16_conversion_init(struct test *test)
+{
+    auto t = new fp16_conversion_test;
+    for (size_t i = 0; i < EncodingCount; ++i)
+        t->encodings[i].as_hex = i;
+    for (size_t i = 0; i < FloatCount; ++i)
+        t->floats[i] = random_input(i);
+
+    fromfp16_bulk_emulated(t->from_fp16, t->encodings, EncodingCount);
+    tofp16_bulk_emulated(t->to_fp16, t->floats, FloatCount);
+    tobf16_bulk_emulated(t->to_bf16, t->floats, FloatCount);
+
+    test->data = t;
+    return EXIT_SUCCESS;
+}
+
+static int fp16_conversion_cleanup(struct test *test)
+{
+    delete static_cast<fp16_conversion_test *>(test->data);
+    return EXIT_SUCCESS;
+}
+
+static int fp16_conversion_run(struct test *test, int cpu)
+{
+    auto t = static_cast<fp16_conversion_test *>(test->data);
+    Stats stats[ImplementationCount];
+    auto floats = static_cast<float *>(aligned_alloc_safe(64, sizeof(float) * EncodingCount));
+    auto halves = static_cast<uint16_t *>(aligned_alloc_safe(64, sizeof(uint16_t) * FloatCount));
+
+    TEST_LOOP_AUTO(test, 1, 1 << 10) {
+        for (int i = 0; i < ImplementationCount; ++i) {
+            const Implementation &impl = implementations[i];
+            if (!cpu_has_feature(impl.features))
+                continue;
+
+            for (int n = 0; n < ConversionsPerLoop; ++n) {
+                size_t offset, count;
+                if (impl.fromfp16) {
+                    random_range(EncodingCount, offset, count);
+                    timed_conversion(stats[i], count, [&] {
+                        impl.fromfp16(floats, t->encodings + offset, count);
+                    });
+                    memcmp_or_fail(floats, t->from_fp16 + offset, count,
+                                   "%s conversion of FP16 0x%04zx-0x%04zx", impl.name, offset, offset + count - 1);
+                }
+                if (impl.tofp16) {
+                    auto out = reinterpret_cast<Float16 *>(halves);
+                    random_range(FloatCount, offset, count);
+                    timed_conversion(stats[i], count, [&] { impl.tofp16(out, t->floats + offset, count); });
+                    memcmp_or_fail(out, t->to_fp16 + offset, count, "%s conversion to FP16", impl.name);
+                }
+                if (impl.tobf16) {
+                    auto out = reinterpret_cast<BFloat16 *>(halves);
+                    random_range(FloatCount, offset, count);
+                    timed_conversion(stats[i], count, [&] { impl.tobf16(out, t->floats + offset, count); });
+                    memcmp_or_fail(out, t->to_bf16 + offset, count, "%s conversion to BF16", impl.name);
+                }
+            }
+        }
+    };
+
+    free(halves);
+    free(floats);
+
+    for (int i = 0; i < ImplementationCount; ++i) {
+        if (stats[i].elapsed.count())
+            log_info("%s: %.1f M conversions/s", implementations[i].name,
+                     1000.0 * stats[i].values / stats[i].elapsed.count());
+    }
+    return EXIT_SUCCESS;
+}
+
+DECLARE_TEST(fp16_conversion, "FP16 and BF16 conversions with F16C, AVX-512 FP16 and AVX-512 BF16")
+    .test_init = fp16_conversion_init,
+    .test_run = fp16_conversion_run,
+    .test_cleanup = fp16_conversion_cleanup,
+    .minimum_cpu = cpu_feature_f16c,
+    .desired_duration = 1000,
+    .quality_level = TEST_QUALITY_BETA,
+END_DECLARE_TEST
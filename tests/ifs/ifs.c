@@ -39,6 +39,8 @@
 #include <limits.h>
 #include <paths.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 #include "sandstone_ifs.h"
@@ -116,6 +118,7 @@ static int scan_common_init(struct test *test)
 {
         /* Get info struct */
         ifs_test_t *ifs_info = (ifs_test_t *) test->data;
+        ifs_info->prefetch_started = false;
 
         /* see if driver is loaded */
         char sys_path[PATH_MAX];
@@ -182,6 +185,13 @@ static int scan_common_init(struct test *test)
                     strncpy(ifs_info->image_version, "unknown", BUFLEN);
             }
             log_info("Test image ID: %s version: %s", ifs_info->image_id, ifs_info->image_version);
+
+            /* The driver has a single image loaded for all cores and a
+             * single status file, so neither loading the next batch nor
+             * scanning more than one core at a time can overlap with
+             * the scans. What we can do is read the next image from disk
+             * while they run, so the next load doesn't wait for I/O. */
+            ifs_start_prefetch(ifs_info, (int) strtoul(ifs_info->image_id, NULL, 16) + 1);
         }
 
         close(ifs_fd);
@@ -276,6 +286,24 @@ static int scan_run(struct test *test, int cpu)
         return EXIT_SUCCESS;
 }
 
+static int scan_cleanup(struct test *test)
+{
+    ifs_test_t *ifs_info = (ifs_test_t *) test->data;
+    if (ifs_info && ifs_info->prefetch_started) {
+        ifs_finish_prefetch(ifs_info);
+        if (ifs_info->prefetch_size > 0)
+            log_debug("Read ahead next test image %s (%zd bytes)", ifs_info->next_image_path,
+                      ifs_info->prefetch_size);
+        else if (ifs_info->prefetch_size == -ENOENT)
+            log_debug("Next test image %s does not exist, the next run will start over",
+                      ifs_info->next_image_path);
+        else
+            log_debug("Could not read ahead next test image %s: %s", ifs_info->next_image_path,
+                      strerror(-ifs_info->prefetch_size));
+    }
+    return EXIT_SUCCESS;
+}
+
 static int scan_preinit(struct test *test)
 {
     /*
@@ -323,6 +351,11 @@ static int scan_run(struct test *test, int cpu)
     __builtin_unreachable();
 }
 
+static int scan_cleanup(struct test *test)
+{
+    return EXIT_SUCCESS;
+}
+
 static int scan_array_init(struct test *test)
 {
     log_skip(OsNotSupportedSkipCategory, "Not supported on this OS");
@@ -335,6 +368,7 @@ DECLARE_TEST(ifs, "Intel In-Field Scan (IFS) hardware selftest")
     .test_preinit = scan_preinit,
     .test_init = scan_saf_init,
     .test_run = scan_run,
+    .test_cleanup = scan_cleanup,
     .desired_duration = -1,
     .fracture_loop_count = -1,
     .quality_level = TEST_QUALITY_PROD,
@@ -345,6 +379,7 @@ DECLARE_TEST(ifs_array_bist, "Array BIST: Intel In-Field Scan (IFS) hardware sel
     .test_preinit = scan_preinit,
     .test_init = scan_array_init,
     .test_run = scan_run,
+    .test_cleanup = scan_cleanup,
     .desired_duration = -1,
     .fracture_loop_count = -1,
     .quality_level = TEST_QUALITY_PROD,
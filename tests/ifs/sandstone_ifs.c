@@ -12,6 +12,8 @@
 #include <fcntl.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
 #include <sys/wait.h>
@@ -64,6 +66,62 @@ ssize_t read_file(int dfd, const char *filename, char buf[BUFLEN])
         return read_file_fd(fd, buf);
 }
 
+/*
+ * The kernel requests intel/ifs_<n>/<family>-<model>-<stepping>-<batch>.scan
+ * from the firmware directory when current_batch is written.
+ */
+bool ifs_image_path(char *buf, size_t size, const char *sys_dir, int batch)
+{
+        const char *ifs = strstr(sys_dir, "intel_ifs_");
+        if (!ifs)
+                return false;
+        int ifs_num = atoi(ifs + strlen("intel_ifs_"));
+
+        int n = snprintf(buf, size, PATH_IFS_FIRMWARE_BASE "ifs_%d/%02x-%02x-%02x-%02x.scan",
+                         ifs_num, cpu_info[0].family, cpu_info[0].model, cpu_info[0].stepping, batch);
+        return n > 0 && (size_t) n < size;
+}
+
+static void *prefetch_image(void *ptr)
+{
+        ifs_test_t *ifs_info = (ifs_test_t *) ptr;
+        int fd = open(ifs_info->next_image_path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+                ifs_info->prefetch_size = -errno;
+                return NULL;
+        }
+
+        /* read it all, so it's in the page cache when the kernel loads it */
+        static const size_t ChunkSize = 64 * 1024;
+        char *chunk = (char *) malloc(ChunkSize);
+        ssize_t total = 0, n;
+        while ((n = read(fd, chunk, ChunkSize)) > 0)
+                total += n;
+        ifs_info->prefetch_size = n < 0 ? -errno : total;
+        free(chunk);
+        close(fd);
+        return NULL;
+}
+
+void ifs_start_prefetch(ifs_test_t *ifs_info, int batch)
+{
+        ifs_info->prefetch_started = false;
+        if (!ifs_image_path(ifs_info->next_image_path, sizeof(ifs_info->next_image_path),
+                            ifs_info->sys_dir, batch))
+                return;
+        ifs_info->prefetch_size = 0;
+        ifs_info->prefetch_started =
+                pthread_create(&ifs_info->prefetch_thread, NULL, prefetch_image, ifs_info) == 0;
+}
+
+void ifs_finish_prefetch(ifs_test_t *ifs_info)
+{
+        if (!ifs_info->prefetch_started)
+                return;
+        pthread_join(ifs_info->prefetch_thread, NULL);
+        ifs_info->prefetch_started = false;
+}
+
 int open_sysfs_ifs_base(const char *sys_path)
 {
         /* see if driver is loaded, otherwise try to load it */
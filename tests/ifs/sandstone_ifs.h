@@ -6,7 +6,13 @@
 #ifndef SANDSTONE_IFS_H_INCLUDED
 #define SANDSTONE_IFS_H_INCLUDED
 
+#include <limits.h>
+#include <pthread.h>
+
 #define PATH_SYS_IFS_BASE "/sys/devices/virtual/misc/"
+#ifndef PATH_IFS_FIRMWARE_BASE
+#  define PATH_IFS_FIRMWARE_BASE "/lib/firmware/intel/"
+#endif
 #define DEFAULT_TEST_ID   1
 
 #define BUFLEN 256 // kernel module prints at most a 64bit value
@@ -26,6 +32,12 @@ typedef struct {
     bool image_support;
     char image_id[BUFLEN];
     char image_version[BUFLEN];
+
+    /* the next image is read ahead while the current one is scanning */
+    pthread_t prefetch_thread;
+    bool prefetch_started;
+    ssize_t prefetch_size;          /* -errno on failure */
+    char next_image_path[PATH_MAX];
 } ifs_test_t;
 
 bool compare_error_codes(unsigned long long code, unsigned long long expected);
@@ -33,5 +45,8 @@ bool write_file(int dfd, const char *filename, const char* value);
 int open_sysfs_ifs_base(const char *sys_path);
 ssize_t read_file(int dfd, const char *filename, char buf[BUFLEN]);
 ssize_t read_file_fd(int fd, char buf[BUFLEN]);
+bool ifs_image_path(char *buf, size_t size, const char *sys_dir, int batch);
+void ifs_start_prefetch(ifs_test_t *ifs_info, int batch);
+void ifs_finish_prefetch(ifs_test_t *ifs_info);
 
 #endif /* SANDSTONE_IFS_H_INCLUDED */
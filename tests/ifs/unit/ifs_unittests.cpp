@@ -8,6 +8,7 @@
 #include "gtest/gtest.h"
 #include "sandstone_unittests_utils.h"
 
+#define PATH_IFS_FIRMWARE_BASE "ifs_unittest_firmware/"
 #include "../sandstone_ifs.c"
 #undef PATH_SYS_IFS_BASE
 #define PATH_SYS_IFS_BASE
@@ -96,6 +97,9 @@ TEST(IFSRequirements, CurrentBatchFound)
     test *test_t = (test *) test_setup(reqs_test2);
     ifs_test_t *ifs_info = (ifs_test_t *) test_t->data;
 
+    // Setup dummy cpu_info array, for the image file name
+    cpu_info = new struct cpu_info[1]{};
+
     // Clean errno, before running
     errno = 0;
 
@@ -104,6 +108,13 @@ TEST(IFSRequirements, CurrentBatchFound)
     EXPECT_STREQ(ifs_info->image_id, "0x2");
     EXPECT_STREQ(ifs_info->image_version, reqs_test2.files[2].contents);
 
+    // The image after the one just loaded is being read ahead
+    EXPECT_TRUE(ifs_info->prefetch_started);
+    EXPECT_STREQ(ifs_info->next_image_path, PATH_IFS_FIRMWARE_BASE "ifs_0/00-00-00-03.scan");
+    EXPECT_EQ(scan_cleanup(test_t), EXIT_SUCCESS);
+    EXPECT_FALSE(ifs_info->prefetch_started);
+
+    delete [] cpu_info;
     test_cleanup(test_t, ifs_info, reqs_test2);
 }
 
@@ -262,6 +273,45 @@ TEST(IFSLoadImage, LoadNextImage)
     test_cleanup(test_t, ifs_info, load_test5);
 }
 
+/*
+ * @test The next image is read ahead from the firmware directory.
+ */
+TEST(IFSLoadImage, PrefetchNextImage)
+{
+    ifs_test_t *ifs_info = (ifs_test_t *) calloc(1, sizeof(ifs_test_t));
+    ifs_info->sys_dir = "intel_ifs_0";
+
+    // Setup dummy cpu_info array
+    cpu_info = new struct cpu_info[1];
+    cpu_info[0].family = 6;
+    cpu_info[0].model = 0x8f;
+    cpu_info[0].stepping = 8;
+
+    // Setup dummy firmware directory with batch 0x2 only
+    mkdir(PATH_IFS_FIRMWARE_BASE, 0755);
+    mkdir(PATH_IFS_FIRMWARE_BASE "ifs_0", 0755);
+    setup_sysfs_file(PATH_IFS_FIRMWARE_BASE "ifs_0", "06-8f-08-02.scan", "scan image");
+
+    ifs_start_prefetch(ifs_info, 2);
+    ASSERT_TRUE(ifs_info->prefetch_started);
+    EXPECT_STREQ(ifs_info->next_image_path, PATH_IFS_FIRMWARE_BASE "ifs_0/06-8f-08-02.scan");
+    ifs_finish_prefetch(ifs_info);
+    EXPECT_EQ(ifs_info->prefetch_size, strlen("scan image\n"));
+
+    // Missing image is reported, so the caller knows it will start over
+    ifs_start_prefetch(ifs_info, 3);
+    ASSERT_TRUE(ifs_info->prefetch_started);
+    ifs_finish_prefetch(ifs_info);
+    EXPECT_EQ(ifs_info->prefetch_size, -ENOENT);
+    EXPECT_FALSE(ifs_info->prefetch_started);
+
+    remove(PATH_IFS_FIRMWARE_BASE "ifs_0/06-8f-08-02.scan");
+    rmdir(PATH_IFS_FIRMWARE_BASE "ifs_0");
+    rmdir(PATH_IFS_FIRMWARE_BASE);
+    delete [] cpu_info;
+    free(ifs_info);
+}
+
 
 /*
  * @test Trigger IFS on all cores available and all cores succeed.
@@ -0,0 +1,436 @@
+/**
+ * @file
+ *
+ * @copyright
+ * Copyright 2024 Intel Corporation.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * @test @b jit_random
+ * @parblock
+ * This test generates random sequences of integer, AVX2 vector and FMA
+ * floating point instructions, assembles them with a small x86-64 encoder
+ * into a ManagedCodeBuffer and runs them from all threads.
+ *
+ * The instructions operate on 8 general-purpose registers, 6 integer and 6
+ * double-precision YMM registers and 16 quadwords of memory. Each source
+ * operand is the register most recently written with the probability set
+ * by the "dependency_percent" knob (default 50), so the sequences mix long
+ * dependency chains with independent work. Floating point results are
+ * kept in [1, 2) by masking the exponent after every operation, so they
+ * never overflow.
+ *
+ * test_init interprets each sequence in C++ from a random initial state
+ * to get the golden registers and memory, and checks that the assembled
+ * code produces the same results. Each thread then runs the assembled
+ * sequences over and over, comparing against the golden values. The
+ * "instructions" knob sets the length of the sequences (default 1024).
+ * @endparblock
+ */
+
+#include <sandstone.h>
+#include <sandstone_test_utils.h>
+
+#if defined(__x86_64__)
+#include <stddef.h>
+#include <string.h>
+
+#include <immintrin.h>
+#include <inttypes.h>
+
+#include <iterator>
+#include <vector>
+
+namespace {
+constexpr int SequenceCount = 4;
+constexpr int DefaultInstructions = 1024;
+constexpr int DefaultDependencyPercent = 50;
+constexpr int GprCount = 8;             // r8 to r15
+constexpr int VintCount = 6;            // ymm0 to ymm5
+constexpr int VfpCount = 6;             // ymm6 to ymm11
+constexpr int VfpBase = 6;
+constexpr int MaskReg = 14;             // ymm14: mantissa mask
+constexpr int OneReg = 15;              // ymm15: 1.0
+constexpr int MemWords = 16;
+constexpr uint64_t MantissaMask = (UINT64_C(1) << 52) - 1;
+constexpr uint64_t DoubleOne = UINT64_C(0x3ff0000000000000);
+
+struct alignas(32) JitState
+{
+    uint64_t gpr[GprCount];
+    uint64_t vint[VintCount][4];
+    uint64_t vfp[VfpCount][4];
+    uint64_t mask[4];
+    uint64_t one[4];
+};
+
+enum Op : uint8_t {
+    Add, Sub, Xor, And, Or, Imul, Rol, LoadAdd, Store,
+    Vpaddq, Vpxor, Vpmulld, Vpshufb,
+    Vaddpd, Vmulpd, Vfmadd231pd,
+};
+
+enum OpClass { Integer, Memory, VectorInteger, FloatingPoint };
+
+struct Insn
+{
+    Op op;
+    uint8_t dst;
+    uint8_t src1;
+    uint8_t src2;
+    uint8_t imm;                // rotate count or memory word
+};
+
+struct Sequence
+{
+    std::vector<Insn> insns;
+    ManagedCodeBuffer code;
+    JitState initial;
+    JitState golden;
+    uint64_t initial_mem[MemWords];
+    uint64_t golden_mem[MemWords];
+};
+
+struct JitTest
+{
+    Sequence sequences[SequenceCount];
+};
+
+// the generated code takes its arguments in RDI and RSI and uses all the
+// vector registers freely, so it needs the SysV calling convention even
+// on Windows
+using JitFunction = void (__attribute__((sysv_abi)) *)(JitState *, uint64_t *);
+
+class Emitter
+{
+public:
+    std::vector<uint8_t> code;
+
+    void bytes(std::initializer_list<uint8_t> list)
+    {
+        code.insert(code.end(), list);
+    }
+    void imm32(int32_t value)
+    {
+        for (int i = 0; i < 4; ++i)
+            code.push_back(uint32_t(value) >> (8 * i));
+    }
+
+    // REX.W, with the high bits of the ModRM reg and rm fields
+    void rex_w(int reg, int rm)
+    {
+        code.push_back(0x48 | (reg >> 3) << 2 | (rm >> 3));
+    }
+    static uint8_t modrm(int mod, int reg, int rm)
+    {
+        return mod << 6 | (reg & 7) << 3 | (rm & 7);
+    }
+
+    // op r/m64, r64 with both in registers
+    void alu(uint8_t opcode, int dst, int src)
+    {
+        rex_w(src, dst);
+        bytes({ opcode, modrm(3, src, dst) });
+    }
+    void imul(int dst, int src)
+    {
+        rex_w(dst, src);
+        bytes({ 0x0f, 0xaf, modrm(3, dst, src) });
+    }
+    void rol(int dst, uint8_t count)
+    {
+        rex_w(0, dst);
+        bytes({ 0xc1, modrm(3, 0, dst), count });
+    }
+
+    // op with a [rsi + disp8] or [rdi + disp32] operand
+    void rsi_mem(uint8_t opcode, int reg, int8_t disp)
+    {
+        rex_w(reg, 0);
+        bytes({ opcode, modrm(1, reg, 6), uint8_t(disp) });
+    }
+    void rdi_mem(uint8_t opcode, int reg, int32_t disp)
+    {
+        rex_w(reg, 0);
+        bytes({ opcode, modrm(2, reg, 7) });
+        imm32(disp);
+    }
+
+    // three-byte VEX, 256-bit; map 1 is 0F and 2 is 0F38; pp 1 is 66 and 2 is F3
+    void vex(int map, int pp, int w, uint8_t opcode, int reg, int vvvv, int rm, int mod = 3)
+    {
+        bytes({ 0xc4, uint8_t((~reg >> 3 & 1) << 7 | 1 << 6 | (~rm >> 3 & 1) << 5 | map),
+                uint8_t(w << 7 | (~vvvv & 15) << 3 | 1 << 2 | pp), opcode, modrm(mod, reg, rm) });
+    }
+    void vex_rdi_mem(int pp, uint8_t opcode, int reg, int32_t disp)
+    {
+        vex(1, pp, 0, opcode, reg, 0, 7, 2);
+        imm32(disp);
+    }
+};
+
+uint8_t gpr(int i)  { return 8 + i; }
+uint8_t vfp(int i)  { return VfpBase + i; }
+
+void assemble(Emitter &e, const std::vector<Insn> &insns)
+{
+    // prologue: save r12-r15 and load the registers from the state in rdi
+    e.bytes({ 0x41, 0x54, 0x41, 0x55, 0x41, 0x56, 0x41, 0x57 });
+    for (int i = 0; i < GprCount; ++i)
+        e.rdi_mem(0x8b, gpr(i), offsetof(JitState, gpr) + i * sizeof(uint64_t));
+    for (int i = 0; i < VintCount; ++i)
+        e.vex_rdi_mem(2, 0x6f, i, offsetof(JitState, vint) + i * sizeof(JitState::vint[0]));
+    for (int i = 0; i < VfpCount; ++i)
+        e.vex_rdi_mem(2, 0x6f, vfp(i), offsetof(JitState, vfp) + i * sizeof(JitState::vfp[0]));
+    e.vex_rdi_mem(2, 0x6f, MaskReg, offsetof(JitState, mask));
+    e.vex_rdi_mem(2, 0x6f, OneReg, offsetof(JitState, one));
+
+    for (const Insn &in : insns) {
+        switch (in.op) {
+        case Add:   e.alu(0x01, gpr(in.dst), gpr(in.src1)); break;
+        case Sub:   e.alu(0x29, gpr(in.dst), gpr(in.src1)); break;
+        case Xor:   e.alu(0x31, gpr(in.dst), gpr(in.src1)); break;
+        case And:   e.alu(0x21, gpr(in.dst), gpr(in.src1)); break;
+        case Or:    e.alu(0x09, gpr(in.dst), gpr(in.src1)); break;
+        case Imul:  e.imul(gpr(in.dst), gpr(in.src1)); break;
+        case Rol:   e.rol(gpr(in.dst), in.imm); break;
+        case LoadAdd: e.rsi_mem(0x03, gpr(in.dst), in.imm * 8); break;
+        case Store: e.rsi_mem(0x89, gpr(in.src1), in.imm * 8); break;
+
+        case Vpaddq:  e.vex(1, 1, 0, 0xd4, in.dst, in.src1, in.src2); break;
+        case Vpxor:   e.vex(1, 1, 0, 0xef, in.dst, in.src1, in.src2); break;
+        case Vpmulld: e.vex(2, 1, 0, 0x40, in.dst, in.src1, in.src2); break;
+        case Vpshufb: e.vex(2, 1, 0, 0x00, in.dst, in.src1, in.src2); break;
+
+        case Vaddpd:
+        case Vmulpd:
+        case Vfmadd231pd:
+            if (in.op == Vaddpd)
+                e.vex(1, 1, 0, 0x58, vfp(in.dst), vfp(in.src1), vfp(in.src2));
+            else if (in.op == Vmulpd)
+                e.vex(1, 1, 0, 0x59, vfp(in.dst), vfp(in.src1), vfp(in.src2));
+            else
+                e.vex(2, 1, 1, 0xb8, vfp(in.dst), vfp(in.src1), vfp(in.src2));
+            // vandpd dst, dst, mask; vorpd dst, dst, one
+            e.vex(1, 1, 0, 0x54, vfp(in.dst), vfp(in.dst), MaskReg);
+            e.vex(1, 1, 0, 0x56, vfp(in.dst), vfp(in.dst), OneReg);
+            break;
+        }
+    }
+
+    // epilogue: store the registers back
+    for (int i = 0; i < GprCount; ++i)
+        e.rdi_mem(0x89, gpr(i), offsetof(JitState, gpr) + i * sizeof(uint64_t));
+    for (int i = 0; i < VintCount; ++i)
+        e.vex_rdi_mem(2, 0x7f, i, offsetof(JitState, vint) + i * sizeof(JitState::vint[0]));
+    for (int i = 0; i < VfpCount; ++i)
+        e.vex_rdi_mem(2, 0x7f, vfp(i), offsetof(JitState, vfp) + i * sizeof(JitState::vfp[0]));
+    e.bytes({ 0xc5, 0xf8, 0x77 });                                  // vzeroupper
+    e.bytes({ 0x41, 0x5f, 0x41, 0x5e, 0x41, 0x5d, 0x41, 0x5c });    // pop r15-r12
+    e.bytes({ 0xc3 });
+}
+
+__m256i load(const uint64_t *v)         { return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(v)); }
+void store(uint64_t *v, __m256i x)      { _mm256_storeu_si256(reinterpret_cast<__m256i *>(v), x); }
+__m256d loadpd(const uint64_t *v)       { return _mm256_castsi256_pd(load(v)); }
+
+void interpret(const std::vector<Insn> &insns, JitState &s, uint64_t *mem)
+{
+    __m256d mask = loadpd(s.mask);
+    __m256d one = loadpd(s.one);
+    for (const Insn &in : insns) {
+        uint64_t &d = s.gpr[in.dst];
+        uint64_t src = s.gpr[in.src1];
+        __m256d fp;
+        switch (in.op) {
+        case Add:   d += src; break;
+        case Sub:   d -= src; break;
+        case Xor:   d ^= src; break;
+        case And:   d &= src; break;
+        case Or:    d |= src; break;
+        case Imul:  d *= src; break;
+        case Rol:   d = d << in.imm | d >> (64 - in.imm); break;
+        case LoadAdd: d += mem[in.imm]; break;
+        case Store: mem[in.imm] = src; break;
+
+        case Vpaddq:  store(s.vint[in.dst], _mm256_add_epi64(load(s.vint[in.src1]), load(s.vint[in.src2]))); break;
+        case Vpxor:   store(s.vint[in.dst], _mm256_xor_si256(load(s.vint[in.src1]), load(s.vint[in.src2]))); break;
+        case Vpmulld: store(s.vint[in.dst], _mm256_mullo_epi32(load(s.vint[in.src1]), load(s.vint[in.src2]))); break;
+        case Vpshufb: store(s.vint[in.dst], _mm256_shuffle_epi8(load(s.vint[in.src1]), load(s.vint[in.src2]))); break;
+
+        case Vaddpd:
+        case Vmulpd:
+        case Vfmadd231pd:
+            if (in.op == Vaddpd)
+                fp = _mm256_add_pd(loadpd(s.vfp[in.src1]), loadpd(s.vfp[in.src2]));
+            else if (in.op == Vmulpd)
+                fp = _mm256_mul_pd(loadpd(s.vfp[in.src1]), loadpd(s.vfp[in.src2]));
+            else
+                fp = _mm256_fmadd_pd(loadpd(s.vfp[in.src1]), loadpd(s.vfp[in.src2]), loadpd(s.vfp[in.dst]));
+            fp = _mm256_or_pd(_mm256_and_pd(fp, mask), one);
+            store(s.vfp[in.dst], _mm256_castpd_si256(fp));
+            break;
+        }
+    }
+}
+
+// picks the register last written with the given probability, else any
+struct RegisterPicker
+{
+    int count;
+    int last = 0;
+    int dependency_percent;
+
+    int pick()
+    {
+        if (int(random32() % 100) < dependency_percent)
+            return last;
+        return random32() % count;
+    }
+    int write()
+    {
+        return last = random32() % count;
+    }
+};
+
+std::vector<Insn> generate(int count, int dependency_percent)
+{
+    static constexpr Op integer_ops[] = { Add, Sub, Xor, And, Or, Imul, Rol };
+    static constexpr Op vint_ops[] = { Vpaddq, Vpxor, Vpmulld, Vpshufb };
+    static constexpr Op fp_ops[] = { Vaddpd, Vmulpd, Vfmadd231pd };
+    WeightedPicker<OpClass> classes({
+        { Integer, 4 },
+        { Memory, 1 },
+        { VectorInteger, 3 },
+        { FloatingPoint, 3 },
+    });
+    RegisterPicker g = { GprCount, 0, dependency_percent };
+    RegisterPicker v = { VintCount, 0, dependency_percent };
+    RegisterPicker f = { VfpCount, 0, dependency_percent };
+
+    std::vector<Insn> insns(count);
+    for (Insn &in : insns) {
+        switch (classes.pick()) {
+        case Integer:
+            in.op = integer_ops[random32() % std::size(integer_ops)];
+            in.src1 = g.pick();
+            in.dst = g.write();
+            in.imm = 1 + random32() % 63;
+            break;
+        case Memory:
+            in.op = random32() & 1 ? LoadAdd : Store;
+            in.src1 = g.pick();
+            in.dst = in.op == Store ? in.src1 : g.write();
+            in.imm = random32() % MemWords;
+            break;
+        case VectorInteger:
+            in.op = vint_ops[random32() % std::size(vint_ops)];
+            in.src1 = v.pick();
+            in.src2 = v.pick();
+            in.dst = v.write();
+            break;
+        case FloatingPoint:
+            in.op = fp_ops[random32() % std::size(fp_ops)];
+            in.src1 = f.pick();
+            in.src2 = f.pick();
+            in.dst = f.write();
+            break;
+        }
+    }
+    return insns;
+}
+
+void random_state(JitState &s, uint64_t *mem)
+{
+    memset_random(s.gpr, sizeof(s.gpr));
+    memset_random(s.vint, sizeof(s.vint));
+    for (auto &reg : s.vfp) {
+        for (uint64_t &lane : reg)
+            lane = (random64() & MantissaMask) | DoubleOne;
+    }
+    for (int i = 0; i < 4; ++i) {
+        s.mask[i] = MantissaMask;
+        s.one[i] = DoubleOne;
+    }
+    memset_random(mem, MemWords * sizeof(uint64_t));
+}
+} // unnamed namespace
+
+static int jit_init(struct test *test)
+{
+    int count = get_testspecific_knob_value_uint(test, "instructions", DefaultInstructions);
+    int dependency_percent = get_testspecific_knob_value_uint(test, "dependency_percent", DefaultDependencyPercent);
+    auto t = new JitTest;
+    test->data = t;
+
+    for (int i = 0; i < SequenceCount; ++i) {
+        Sequence &seq = t->sequences[i];
+        seq.insns = generate(count, dependency_percent);
+        random_state(seq.initial, seq.initial_mem);
+        seq.golden = seq.initial;
+        memcpy(seq.golden_mem, seq.initial_mem, sizeof(seq.golden_mem));
+        interpret(seq.insns, seq.golden, seq.golden_mem);
+
+        Emitter e;
+        assemble(e, seq.insns);
+        if (!seq.code.allocate(e.code.size())) {
+            log_error("Could not allocate %zu bytes for the code", e.code.size());
+            return EXIT_FAILURE;
+        }
+        memcpy(seq.code.ptr(), e.code.data(), e.code.size());
+        seq.code.set_executable();
+
+        // the assembled code must match the interpreter
+        JitState state = seq.initial;
+        uint64_t mem[MemWords];
+        memcpy(mem, seq.initial_mem, sizeof(mem));
+        reinterpret_cast<JitFunction>(seq.code.ptr())(&state, mem);
+        if (memcmp(&state, &seq.golden, sizeof(state)) != 0 || memcmp(mem, seq.golden_mem, sizeof(mem)) != 0) {
+            log_error("Sequence %d of %d instructions does not match the reference interpretation", i, count);
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+static int jit_run(struct test *test, int cpu)
+{
+    auto t = static_cast<JitTest *>(test->data);
+    int i = 0;
+    TEST_LOOP_AUTO(test, 1 << 6, 1 << 20) {
+        const Sequence &seq = t->sequences[i];
+        JitState state = seq.initial;
+        uint64_t mem[MemWords];
+        memcpy(mem, seq.initial_mem, sizeof(mem));
+        reinterpret_cast<JitFunction>(seq.code.ptr())(&state, mem);
+
+        memcmp_or_fail(state.gpr, seq.golden.gpr, GprCount,
+                       "Sequence %d: general-purpose registers", i);
+        memcmp_or_fail(&state.vint[0][0], &seq.golden.vint[0][0], VintCount * 4,
+                       "Sequence %d: integer vector registers", i);
+        memcmp_or_fail(reinterpret_cast<double *>(&state.vfp[0][0]),
+                       reinterpret_cast<const double *>(&seq.golden.vfp[0][0]), VfpCount * 4,
+                       "Sequence %d: floating point vector registers", i);
+        memcmp_or_fail(mem, seq.golden_mem, MemWords, "Sequence %d: memory", i);
+
+        if (++i == SequenceCount)
+            i = 0;
+    };
+    return EXIT_SUCCESS;
+}
+
+static int jit_cleanup(struct test *test)
+{
+    delete static_cast<JitTest *>(test->data);
+    return EXIT_SUCCESS;
+}
+
+DECLARE_TEST(jit_random, "Randomly generated sequences of integer, vector and FP instructions, assembled at runtime")
+    .test_init = jit_init,
+    .test_run = jit_run,
+    .test_cleanup = jit_cleanup,
+    .minimum_cpu = cpu_feature_avx2 | cpu_feature_fma,
+    .desired_duration = 1000,
+    .quality_level = TEST_QUALITY_BETA,
+END_DECLARE_TEST
+
+#endif // __x86_64__
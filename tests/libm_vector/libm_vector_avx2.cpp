@@ -0,0 +1,63 @@
+/**
+ * @file
+ *
+ * @copyright
+ * Copyright 2024 Intel Corporation.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * @test @b libm_vector_avx2
+ * @parblock
+ * This is the AVX2 version of libm_vector_sse: the same exp, log, sin and
+ * pow kernels evaluate four values at a time in YMM registers and the
+ * polynomials use fused multiply-adds.
+ * @endparblock
+ */
+
+#include "libm_vector_common.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+
+namespace {
+struct Avx2Traits
+{
+    using Vector = __m256d;
+    using IVector = __m256i;
+    static constexpr int Lanes = 4;
+    static constexpr const char *Name = "AVX2";
+
+    static Vector set1(double d)                        { return _mm256_set1_pd(d); }
+    static IVector set1i(uint64_t i)                    { return _mm256_set1_epi64x(i); }
+    static Vector load(const double *p)                 { return _mm256_load_pd(p); }
+    static void store(double *p, Vector v)              { _mm256_store_pd(p, v); }
+    static Vector add(Vector a, Vector b)               { return _mm256_add_pd(a, b); }
+    static Vector sub(Vector a, Vector b)               { return _mm256_sub_pd(a, b); }
+    static Vector mul(Vector a, Vector b)               { return _mm256_mul_pd(a, b); }
+    static Vector div(Vector a, Vector b)               { return _mm256_div_pd(a, b); }
+    static Vector fma(Vector a, Vector b, Vector c)     { return _mm256_fmadd_pd(a, b, c); }
+    static IVector as_int(Vector v)                     { return _mm256_castpd_si256(v); }
+    static Vector as_double(IVector v)                  { return _mm256_castsi256_pd(v); }
+    static IVector and_(IVector a, IVector b)           { return _mm256_and_si256(a, b); }
+    static IVector andnot(IVector a, IVector b)         { return _mm256_andnot_si256(a, b); }
+    static IVector or_(IVector a, IVector b)            { return _mm256_or_si256(a, b); }
+    static IVector xor_(IVector a, IVector b)           { return _mm256_xor_si256(a, b); }
+    static IVector add64(IVector a, IVector b)          { return _mm256_add_epi64(a, b); }
+    static IVector sub64(IVector a, IVector b)          { return _mm256_sub_epi64(a, b); }
+    template <int N> static IVector slli64(IVector v)   { return _mm256_slli_epi64(v, N); }
+    template <int N> static IVector srli64(IVector v)   { return _mm256_srli_epi64(v, N); }
+    static IVector nan_mask(Vector v)                   { return _mm256_castpd_si256(_mm256_cmp_pd(v, v, _CMP_UNORD_Q)); }
+};
+} // unnamed namespace
+
+using libm_vector_avx2_test = LibmVectorTest<Avx2Traits>;
+DECLARE_TEST(libm_vector_avx2, "Vectorized exp, log, sin and pow accuracy sweep (AVX2)")
+  .groups = DECLARE_TEST_GROUPS(&group_math),
+  .test_init = libm_vector_avx2_test::init,
+  .test_run = libm_vector_avx2_test::run,
+  .test_cleanup = libm_vector_avx2_test::cleanup,
+  .minimum_cpu = cpu_feature_avx2 | cpu_feature_fma,
+  .desired_duration = 1000,
+  .quality_level = TEST_QUALITY_BETA,
+END_DECLARE_TEST
+
+#endif // __x86_64__
@@ -0,0 +1,64 @@
+/**
+ * @file
+ *
+ * @copyright
+ * Copyright 2024 Intel Corporation.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * @test @b libm_vector_avx512
+ * @parblock
+ * This is the AVX-512 version of libm_vector_sse: the same exp, log, sin
+ * and pow kernels evaluate eight values at a time in ZMM registers and the
+ * polynomials use fused multiply-adds.
+ * @endparblock
+ */
+
+#include "libm_vector_common.h"
+
+#include <immintrin.h>
+
+namespace {
+struct Avx512Traits
+{
+    using Vector = __m512d;
+    using IVector = __m512i;
+    static constexpr int Lanes = 8;
+    static constexpr const char *Name = "AVX-512";
+
+    static Vector set1(double d)                        { return _mm512_set1_pd(d); }
+    static IVector set1i(uint64_t i)                    { return _mm512_set1_epi64(i); }
+    static Vector load(const double *p)                 { return _mm512_load_pd(p); }
+    static void store(double *p, Vector v)              { _mm512_store_pd(p, v); }
+    static Vector add(Vector a, Vector b)               { return _mm512_add_pd(a, b); }
+    static Vector sub(Vector a, Vector b)               { return _mm512_sub_pd(a, b); }
+    static Vector mul(Vector a, Vector b)               { return _mm512_mul_pd(a, b); }
+    static Vector div(Vector a, Vector b)               { return _mm512_div_pd(a, b); }
+    static Vector fma(Vector a, Vector b, Vector c)     { return _mm512_fmadd_pd(a, b, c); }
+    static IVector as_int(Vector v)                     { return _mm512_castpd_si512(v); }
+    static Vector as_double(IVector v)                  { return _mm512_castsi512_pd(v); }
+    static IVector and_(IVector a, IVector b)           { return _mm512_and_si512(a, b); }
+    static IVector andnot(IVector a, IVector b)         { return _mm512_andnot_si512(a, b); }
+    static IVector or_(IVector a, IVector b)            { return _mm512_or_si512(a, b); }
+    static IVector xor_(IVector a, IVector b)           { return _mm512_xor_si512(a, b); }
+    static IVector add64(IVector a, IVector b)          { return _mm512_add_epi64(a, b); }
+    static IVector sub64(IVector a, IVector b)          { return _mm512_sub_epi64(a, b); }
+    template <int N> static IVector slli64(IVector v)   { return _mm512_slli_epi64(v, N); }
+    template <int N> static IVector srli64(IVector v)   { return _mm512_srli_epi64(v, N); }
+    static IVector nan_mask(Vector v)
+    {
+        __mmask8 k = _mm512_cmp_pd_mask(v, v, _CMP_UNORD_Q);
+        return _mm512_maskz_mov_epi64(k, _mm512_set1_epi64(-1));
+    }
+};
+} // unnamed namespace
+
+using libm_vector_avx512_test = LibmVectorTest<Avx512Traits>;
+DECLARE_TEST(libm_vector_avx512, "Vectorized exp, log, sin and pow accuracy sweep (AVX-512)")
+  .groups = DECLARE_TEST_GROUPS(&group_math),
+  .test_init = libm_vector_avx512_test::init,
+  .test_run = libm_vector_avx512_test::run,
+  .test_cleanup = libm_vector_avx512_test::cleanup,
+  .minimum_cpu = cpu_skylake_avx512,
+  .desired_duration = 1000,
+  .quality_level = TEST_QUALITY_BETA,
+END_DECLARE_TEST
@@ -0,0 +1,353 @@
+/**
+ * @file
+ *
+ * @copyright
+ * Copyright 2024 Intel Corporation.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef SANDSTONE_LIBM_VECTOR_COMMON_H
+#define SANDSTONE_LIBM_VECTOR_COMMON_H
+
+#include <sandstone.h>
+#include "fp_vectors/static_vectors.h"
+
+#include <chrono>
+
+#include <math.h>
+#include <string.h>
+
+namespace {
+enum Function { Exp, Log, Sin, Pow, FunctionCount };
+
+struct FunctionInfo
+{
+    const char *name;
+    double max_ulps;
+    int low_exponent, high_exponent;    // biased exponents of the generated inputs
+    bool positive;
+};
+
+// The input domains are chosen so the kernels need no special cases other
+// than NaN propagation: no overflow, underflow, denormals or huge arguments
+// to reduce. pow is evaluated as exp(y * log(x)) in double precision, so its
+// error grows with |y * log(x)| and its bound is scaled by that (see
+// max_ulps() below).
+constexpr int Bias = FLOAT64_EXPONENT_BIAS;
+constexpr FunctionInfo functions[FunctionCount] = {
+    { "exp", 2, Bias - 30, Bias + 8, false },       // |x| < 512
+    { "log", 2, 1, 2 * Bias, true },                // any positive normal
+    { "sin", 2, Bias - 30, Bias + 9, false },       // |x| < 1024
+    { "pow", 2, Bias - 20, Bias + 19, true },       // 2^-20 <= x < 2^20
+};
+constexpr int PowYLowExponent = Bias - 10;
+constexpr int PowYHighExponent = Bias + 4;
+constexpr double PowMaxLogResult = 16;              // |y * log(x)|
+
+// A vectorized implementation of exp, log, sin and pow in double precision
+// in the style of a vector math library: branch-free, with the special
+// cases handled by masking. The algorithms and polynomial coefficients are
+// those of FreeBSD's msun (originally Sun's fdlibm), which are accurate to
+// better than 1 ULP in the reduced ranges.
+//
+// The Traits class provides the vector types and operations:
+//   Vector, IVector (64-bit integer lanes), Lanes, Name,
+//   set1(), set1i(), load(), store(), add(), sub(), mul(), div(), fma(),
+//   as_int(), as_double(), and_(), andnot(), or_(), xor_(), add64(), sub64(),
+//   slli64<N>(), srli64<N>(), nan_mask()
+template <typename Traits> struct LibmVectorTest
+{
+    using Vector = typename Traits::Vector;
+    using IVector = typename Traits::IVector;
+    using T = Traits;
+    static constexpr int Lanes = Traits::Lanes;
+    static constexpr int Inputs = 4096;     // per function
+    static constexpr int PassesPerLoop = 16;
+
+    struct Stats {
+        uint64_t values;
+        std::chrono::nanoseconds elapsed;
+    };
+
+    struct libm_vector_data {
+        alignas(64) double x[FunctionCount][Inputs];
+        alignas(64) double y[Inputs];       // pow's exponents
+        alignas(64) double golden[FunctionCount][Inputs];
+    };
+
+    static constexpr double Ln2Hi = 6.93147180369123816490e-01;    // 0x3fe62e42fee00000
+    static constexpr double Ln2Lo = 1.90821492927058770002e-10;    // 0x3dea39ef35793c76
+
+    static Vector c(double d)               { return T::set1(d); }
+    static IVector ci(uint64_t i)           { return T::set1i(i); }
+
+    // Rounds v to the nearest integer by adding and subtracting 1.5 * 2^52,
+    // which leaves the integer in the low bits of the intermediate sum.
+    // Valid for |v| < 2^51.
+    static Vector round(Vector v, IVector &k)
+    {
+        const Vector shift = c(0x1.8p52);
+        Vector t = T::add(v, shift);
+        k = T::sub64(T::as_int(t), T::as_int(shift));
+        return T::sub(t, shift);
+    }
+
+    // NaN inputs produce the same NaN, quieted
+    static Vector propagate_nan(Vector x, Vector result)
+    {
+        IVector mask = T::nan_mask(x);
+        IVector nan = T::as_int(T::add(x, x));
+        return T::as_double(T::or_(T::and_(mask, nan), T::andnot(mask, T::as_int(result))));
+    }
+
+    static Vector exp_core(Vector x)
+    {
+        // x = k * ln2 + r, |r| <= 0.5 * ln2
+        IVector k;
+        Vector kd = round(T::mul(x, c(0x1.71547652b82fep0)), k);
+        Vector hi = T::sub(x, T::mul(kd, c(Ln2Hi)));       // exact
+        Vector lo = T::mul(kd, c(Ln2Lo));
+        Vector r = T::sub(hi, lo);
+
+        // exp(r) = 1 + r + r * c / (2 - c), with c a Remez approximation
+        Vector z = T::mul(r, r);
+        Vector p = T::fma(z, c(4.13813679705723846039e-08), c(-1.65339022054652515390e-06));
+        p = T::fma(z, p, c(6.61375632143793436117e-05));
+        p = T::fma(z, p, c(-2.77777777770155933842e-03));
+        p = T::fma(z, p, c(1.66666666666666019037e-01));
+        Vector cr = T::sub(r, T::mul(z, p));
+        Vector y = T::div(T::mul(r, cr), T::sub(c(2), cr));
+        y = T::sub(c(1), T::sub(T::sub(lo, y), hi));
+
+        // multiply by 2^k, built directly in the exponent field
+        IVector scale = T::template slli64<52>(T::add64(k, ci(Bias)));
+        return T::mul(y, T::as_double(scale));
+    }
+
+    static Vector log_core(Vector x)
+    {
+        // x = 2^k * m, sqrt(2)/2 <= m < sqrt(2)
+        IVector bits = T::as_int(x);
+        IVector u = T::add64(bits, ci(0x3ff0000000000000 - 0x3fe6a09e667f3bcd));
+        IVector kbits = T::sub64(T::and_(u, ci(0xfff0000000000000)), ci(0x3ff0000000000000));
+        Vector m = T::as_double(T::sub64(bits, kbits));
+        Vector kd = T::as_double(T::or_(T::template srli64<52>(u), ci(0x4330000000000000)));
+        kd = T::sub(kd, c(0x1p52 + Bias));
+
+        // log(1 + f) = f - f^2 / 2 + s * (f^2 / 2 + R(s)), s = f / (2 + f)
+        Vector f = T::sub(m, c(1));                         // exact
+        Vector s = T::div(f, T::add(c(2), f));
+        Vector z = T::mul(s, s);
+        Vector w = T::mul(z, z);
+        Vector t1 = T::fma(w, c(1.531383769920937332e-01), c(2.222219843214978396e-01));
+        t1 = T::mul(w, T::fma(w, t1, c(3.999999999940941908e-01)));
+        Vector t2 = T::fma(w, c(1.479819860511658591e-01), c(1.818357216161805012e-01));
+        t2 = T::fma(w, t2, c(2.857142874366239149e-01));
+        t2 = T::mul(z, T::fma(w, t2, c(6.666666666666735130e-01)));
+        Vector R = T::add(t2, t1);
+        Vector hfsq = T::mul(c(0.5), T::mul(f, f));
+
+        Vector r = T::add(T::mul(s, T::add(hfsq, R)), T::mul(kd, c(Ln2Lo)));
+        r = T::sub(T::sub(hfsq, r), f);
+        return T::sub(T::mul(kd, c(Ln2Hi)), r);
+    }
+
+    static Vector exp(Vector x)
+    {
+        return propagate_nan(x, exp_core(x));
+    }
+
+    static Vector log(Vector x)
+    {
+        return propagate_nan(x, log_core(x));
+    }
+
+    static Vector sin(Vector x)
+    {
+        // x = k * pi/2 + r, |r| <= pi/4; pi/2 is split in three parts of 33
+        // bits so the first two products are exact for |k| < 2^20
+        IVector k;
+        Vector kd = round(T::mul(x, c(6.36619772367581382433e-01)), k);
+        Vector r = T::sub(x, T::mul(kd, c(1.57079632673412561417e+00)));
+        r = T::sub(r, T::mul(kd, c(6.07710050630396597660e-11)));
+        r = T::sub(r, T::mul(kd, c(2.02226624871116645580e-21)));
+        Vector z = T::mul(r, r);
+
+        // sin(r) = r + r^3 * S(r^2)
+        Vector p = T::fma(z, c(1.58969099521155010221e-10), c(-2.50507602534068634195e-08));
+        p = T::fma(z, p, c(2.75573137070700676789e-06));
+        p = T::fma(z, p, c(-1.98412698298579493134e-04));
+        p = T::fma(z, p, c(8.33333333332248946124e-03));
+        p = T::fma(z, p, c(-1.66666666666666324348e-01));
+        Vector sinr = T::fma(T::mul(z, r), p, r);
+
+        // cos(r) = 1 - r^2 / 2 + r^4 * C(r^2)
+        Vector q = T::fma(z, c(-1.13596475577881948265e-11), c(2.08757232129817482790e-09));
+        q = T::fma(z, q, c(-2.75573143513906633035e-07));
+        q = T::fma(z, q, c(2.48015872894767294178e-05));
+        q = T::fma(z, q, c(-1.38888888888741095749e-03));
+        q = T::fma(z, q, c(4.16666666666666019037e-02));
+        Vector hz = T::mul(c(0.5), z);
+        Vector w = T::sub(c(1), hz);
+        Vector cosr = T::add(w, T::add(T::sub(T::sub(c(1), w), hz), T::mul(T::mul(z, z), q)));
+
+        // odd quadrants take the cosine, the upper two negate it
+        IVector odd = T::sub64(ci(0), T::and_(k, ci(1)));
+        IVector result = T::or_(T::and_(odd, T::as_int(cosr)), T::andnot(odd, T::as_int(sinr)));
+        result = T::xor_(result, T::template slli64<62>(T::and_(k, ci(2))));
+        return propagate_nan(x, T::as_double(result));
+    }
+
+    static Vector pow(Vector x, Vector y)
+    {
+        // x + y is a NaN if either is, with the payload of x's if both are
+        return propagate_nan(T::add(x, y), exp_core(T::mul(y, log_core(x))));
+    }
+
+    [[gnu::noinline]] static void evaluate(const libm_vector_data *d, Function f, double *out)
+    {
+        const double *x = d->x[f];
+        for (int i = 0; i < Inputs; i += Lanes) {
+            Vector v = T::load(x + i);
+            switch (f) {
+            case Exp:   v = exp(v); break;
+            case Log:   v = log(v); break;
+            case Sin:   v = sin(v); break;
+            case Pow:   v = pow(v, T::load(d->y + i)); break;
+            case FunctionCount: __builtin_unreachable();
+            }
+            T::store(out + i, v);
+        }
+    }
+
+    static long double reference(Function f, double x, double y)
+    {
+        switch (f) {
+        case Exp:   return expl(x);
+        case Log:   return logl(x);
+        case Sin:   return sinl(x);
+        case Pow:   return powl(x, y);
+        case FunctionCount: break;
+        }
+        __builtin_unreachable();
+    }
+
+    static double max_ulps(Function f, double x, double y)
+    {
+        if (f == Pow)
+            return functions[f].max_ulps + 4 * fabsl(y * logl(x));
+        return functions[f].max_ulps;
+    }
+
+    // error of result in units in the last place of the double closest to ref
+    static double ulp_error(double result, long double ref)
+    {
+        int e;
+        frexpl(ref, &e);
+        return fabsl(result - ref) / ldexpl(1, e - 53);
+    }
+
+    static Float64 generate(const FunctionInfo &info, int low_exponent, int high_exponent, int i)
+    {
+        Float64 f;
+        switch (i % 8) {
+        case 0:
+            // a NaN with one of the static vectors' mantissas as payload
+            do {
+                f = pick_float64_vector();
+            } while (f.mantissa == 0);
+            f.exponent = FLOAT64_NAN_EXPONENT;
+            break;
+        case 1:
+        case 2:
+        case 3:
+            f = randomize_sign_and_exponent_in_range_float64(pick_float64_vector(), low_exponent, high_exponent);
+            break;
+        default:
+            f = randomize_sign_and_exponent_in_range_float64(new_random_float64(), low_exponent, high_exponent);
+            break;
+        }
+        if (info.positive)
+            f.sign = 0;
+        return f;
+    }
+
+    static int init(struct test *test)
+    {
+        auto d = new libm_vector_data;
+        for (int f = 0; f < FunctionCount; ++f) {
+            const FunctionInfo &info = functions[f];
+            for (int i = 0; i < Inputs; ++i)
+                d->x[f][i] = generate(info, info.low_exponent, info.high_exponent, i).as_float;
+        }
+        for (int i = 0; i < Inputs; ++i) {
+            double x = d->x[Pow][i];
+            // offset so x and y are not NaN on the same inputs
+            double y = generate(functions[Pow], PowYLowExponent, PowYHighExponent, i + 4).as_float;
+            while (fabsl(y * logl(x)) > PowMaxLogResult)
+                y /= 2;
+            d->y[i] = y;
+        }
+
+        // the results become the golden values for the test threads, once
+        // verified against the long double implementation
+        for (int f = 0; f < FunctionCount; ++f) {
+            evaluate(d, Function(f), d->golden[f]);
+            for (int i = 0; i < Inputs; ++i) {
+                double x = d->x[f][i], y = d->y[i];
+                double result = d->golden[f][i];
+                double nan = (f == Pow) ? x + y : x + x;
+                if (isnan(nan)) {
+                    if (memcmp(&result, &nan, sizeof(result)) == 0)
+                        continue;
+                } else {
+                    long double ref = reference(Function(f), x, y);
+                    if (ulp_error(result, ref) <= max_ulps(Function(f), x, y))
+                        continue;
+                }
+                log_error("%s %s(%a, %a) = %a, expected %La", Traits::Name, functions[f].name, x, y,
+                          result, reference(Function(f), x, y));
+                delete d;
+                return EXIT_FAILURE;
+            }
+        }
+
+        test->data = d;
+        return EXIT_SUCCESS;
+    }
+
+    static int cleanup(struct test *test)
+    {
+        delete static_cast<libm_vector_data *>(test->data);
+        return EXIT_SUCCESS;
+    }
+
+    static int run(struct test *test, int cpu)
+    {
+        auto d = static_cast<libm_vector_data *>(test->data);
+        Stats stats[FunctionCount] = {};
+        alignas(64) double out[Inputs];
+
+        TEST_LOOP_AUTO(test, 1, 1 << 10) {
+            for (int f = 0; f < FunctionCount; ++f) {
+                auto start = std::chrono::steady_clock::now();
+                for (int pass = 0; pass < PassesPerLoop; ++pass) {
+                    evaluate(d, Function(f), out);
+                    memcmp_or_fail(out, d->golden[f], Inputs, "%s %s", Traits::Name, functions[f].name);
+                }
+                stats[f].elapsed += std::chrono::steady_clock::now() - start;
+                stats[f].values += PassesPerLoop * Inputs;
+            }
+        };
+
+        for (int f = 0; f < FunctionCount; ++f) {
+            if (stats[f].elapsed.count())
+                log_info("%s: %.1f M values/s", functions[f].name,
+                         1000.0 * stats[f].values / stats[f].elapsed.count());
+        }
+        return EXIT_SUCCESS;
+    }
+};
+} // unnamed namespace
+
+#endif // SANDSTONE_LIBM_VECTOR_COMMON_H
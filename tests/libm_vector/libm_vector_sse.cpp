@@ -0,0 +1,76 @@
+/**
+ * @file
+ *
+ * @copyright
+ * Copyright 2024 Intel Corporation.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * @test @b libm_vector_sse
+ * @parblock
+ * This test evaluates vectorized implementations of exp, log, sin and pow
+ * in double precision, the way a vector math library would, on 128-bit
+ * registers two values at a time. The inputs are a mix of dense random
+ * values and the framework's static floating point vectors (walking ones
+ * and zeros, marches) with random exponents in each function's domain,
+ * plus NaNs whose payloads come from the same vectors.
+ *
+ * In test_init, every result is verified to be within a bound in ULPs of
+ * the long double libm result, or to be the input NaN quieted; then the
+ * test threads compare their results bit for bit to those. The kernels use
+ * the floating point adder, multiplier and divider and integer bit
+ * manipulation of the exponent fields. This version multiplies and adds
+ * separately; libm_vector_avx2 and libm_vector_avx512 use fused
+ * multiply-adds.
+ *
+ * Each thread logs the number of values per second it evaluated for each
+ * function.
+ * @endparblock
+ */
+
+#include "libm_vector_common.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+
+namespace {
+struct SseTraits
+{
+    using Vector = __m128d;
+    using IVector = __m128i;
+    static constexpr int Lanes = 2;
+    static constexpr const char *Name = "SSE";
+
+    static Vector set1(double d)                        { return _mm_set1_pd(d); }
+    static IVector set1i(uint64_t i)                    { return _mm_set1_epi64x(i); }
+    static Vector load(const double *p)                 { return _mm_load_pd(p); }
+    static void store(double *p, Vector v)              { _mm_store_pd(p, v); }
+    static Vector add(Vector a, Vector b)               { return _mm_add_pd(a, b); }
+    static Vector sub(Vector a, Vector b)               { return _mm_sub_pd(a, b); }
+    static Vector mul(Vector a, Vector b)               { return _mm_mul_pd(a, b); }
+    static Vector div(Vector a, Vector b)               { return _mm_div_pd(a, b); }
+    static Vector fma(Vector a, Vector b, Vector c)     { return _mm_add_pd(_mm_mul_pd(a, b), c); }
+    static IVector as_int(Vector v)                     { return _mm_castpd_si128(v); }
+    static Vector as_double(IVector v)                  { return _mm_castsi128_pd(v); }
+    static IVector and_(IVector a, IVector b)           { return _mm_and_si128(a, b); }
+    static IVector andnot(IVector a, IVector b)         { return _mm_andnot_si128(a, b); }
+    static IVector or_(IVector a, IVector b)            { return _mm_or_si128(a, b); }
+    static IVector xor_(IVector a, IVector b)           { return _mm_xor_si128(a, b); }
+    static IVector add64(IVector a, IVector b)          { return _mm_add_epi64(a, b); }
+    static IVector sub64(IVector a, IVector b)          { return _mm_sub_epi64(a, b); }
+    template <int N> static IVector slli64(IVector v)   { return _mm_slli_epi64(v, N); }
+    template <int N> static IVector srli64(IVector v)   { return _mm_srli_epi64(v, N); }
+    static IVector nan_mask(Vector v)                   { return _mm_castpd_si128(_mm_cmpunord_pd(v, v)); }
+};
+} // unnamed namespace
+
+using libm_vector_sse_test = LibmVectorTest<SseTraits>;
+DECLARE_TEST(libm_vector_sse, "Vectorized exp, log, sin and pow accuracy sweep (SSE)")
+  .groups = DECLARE_TEST_GROUPS(&group_math),
+  .test_init = libm_vector_sse_test::init,
+  .test_run = libm_vector_sse_test::run,
+  .test_cleanup = libm_vector_sse_test::cleanup,
+  .desired_duration = 1000,
+  .quality_level = TEST_QUALITY_BETA,
+END_DECLARE_TEST
+
+#endif // __x86_64__
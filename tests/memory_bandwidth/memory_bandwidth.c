@@ -0,0 +1,548 @@
+/**
+ * @file
+ *
+ * @copyright
+ * Copyright 2024 Intel Corporation.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * @test @b mem_bandwidth_read
+ * @test @b mem_bandwidth_write
+ * @test @b mem_bandwidth_write_nt
+ * @test @b mem_bandwidth_copy
+ * @test @b mem_bandwidth_copy_nt
+ * @test @b mem_bandwidth_triad
+ * @test @b mem_bandwidth_triad_nt
+ * @test @b mem_latency
+ * @parblock
+ * These tests saturate the memory subsystem from all threads at once, with
+ * the STREAM-like kernels read, write, copy and triad (a[i] = b[i] + k *
+ * c[i], in integer arithmetic so the result is exact). The _nt variants
+ * use non-temporal stores that bypass the caches. The mem_latency test
+ * follows a random chain of cache lines, so each load depends on the
+ * previous one.
+ *
+ * Each thread allocates and first touches its own buffers, so on Linux
+ * they come from the NUMA node local to the thread's logical processor.
+ * The buffers are sized to be a multiple of the last level cache, up to
+ * 48 MB per thread shared by the arrays the kernel uses (see the
+ * "buffer_size" knob to override). All data moved is verified
+ * against the expected contents, which is the point of these tests:
+ * finding memory corruption under full memory load.
+ *
+ * The bandwidth or latency achieved is reported per socket and for the
+ * whole slice at the end of each run, when verbose logging is enabled.
+ * @endparblock
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef __x86_64__
+#  include <immintrin.h>
+#endif
+
+#include <sandstone.h>
+
+#define TRIAD_SCALAR            3
+#define LLC_MULTIPLIER          2       /* per socket, per array */
+#define L2_MULTIPLIER           8       /* per thread */
+#define MIN_BUFFER_SIZE         (1024 * 1024)
+#define MAX_THREAD_MEMORY       (48 * 1024 * 1024)      /* all arrays together */
+#define CHASE_STEPS_PER_LOOP    (64 * 1024)
+#define CACHE_LINE_SIZE         64
+
+enum mem_kernel {
+    MEM_READ,
+    MEM_WRITE,
+    MEM_COPY,
+    MEM_TRIAD,
+    MEM_LATENCY,
+};
+
+struct mem_thread_result {
+    uint64_t bytes;             /* or loads, for latency */
+    uint64_t elapsed_ns;
+};
+
+struct mem_test {
+    enum mem_kernel kernel;
+    bool non_temporal;
+    size_t buffer_size;         /* per thread, per array */
+    struct mem_thread_result *results;
+};
+
+struct mem_chase_line {
+    size_t next;
+    uint64_t padding[CACHE_LINE_SIZE / sizeof(uint64_t) - 1];
+};
+
+/* position in the chain, carried over from one TEST_LOOP iteration to the next */
+struct mem_chase_state {
+    size_t idx;
+    size_t step;                /* steps taken in the current cycle */
+    uint64_t index_sum;
+};
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* every element's value depends on its position and the pass's seed */
+static inline uint64_t pattern(uint64_t seed, size_t i)
+{
+    return (i * UINT64_C(0x9e3779b97f4a7c15)) ^ seed;
+}
+
+static inline void store(uint64_t *ptr, uint64_t value, bool non_temporal)
+{
+#ifdef __x86_64__
+    if (non_temporal) {
+        _mm_stream_si64((long long *)ptr, (long long)value);
+        return;
+    }
+#endif
+    *ptr = value;
+}
+
+static inline void store_fence(bool non_temporal)
+{
+#ifdef __x86_64__
+    if (non_temporal)
+        _mm_sfence();
+#endif
+}
+
+static void __attribute__((cold, noreturn))
+report_mismatch(const char *what, const uint64_t *buf, size_t i, uint64_t expected)
+{
+    uint64_t actual = buf[i];
+    report_fail_msg("%s mismatch at offset %#zx (physical address %#" PRIx64 "): "
+                    "expected %#018" PRIx64 ", got %#018" PRIx64 " (xor %#018" PRIx64 ")",
+                    what, i * sizeof(uint64_t), retrieve_physical_address(&buf[i]),
+                    expected, actual, expected ^ actual);
+}
+
+static void verify_pattern(const char *what, const uint64_t *buf, size_t count, uint64_t seed)
+{
+    for (size_t i = 0; i < count; ++i) {
+        if (__builtin_expect(buf[i] != pattern(seed, i), false))
+            report_mismatch(what, buf, i, pattern(seed, i));
+    }
+}
+
+static void fill_pattern(uint64_t *buf, size_t count, uint64_t seed, bool non_temporal)
+{
+    for (size_t i = 0; i < count; ++i)
+        store(&buf[i], pattern(seed, i), non_temporal);
+    store_fence(non_temporal);
+}
+
+static uint64_t run_read(const uint64_t *a, size_t count)
+{
+    /* fold with a rotate so that swapped or duplicated words are caught */
+    uint64_t sum = 0;
+    for (size_t i = 0; i < count; ++i)
+        sum = ((sum << 1) | (sum >> 63)) ^ a[i];
+    return sum;
+}
+
+static void run_copy(uint64_t *restrict dst, const uint64_t *restrict src, size_t count,
+                     bool non_temporal)
+{
+    for (size_t i = 0; i < count; ++i)
+        store(&dst[i], src[i], non_temporal);
+    store_fence(non_temporal);
+}
+
+static void run_triad(uint64_t *restrict a, const uint64_t *restrict b, const uint64_t *restrict c,
+                      size_t count, bool non_temporal)
+{
+    for (size_t i = 0; i < count; ++i)
+        store(&a[i], b[i] + TRIAD_SCALAR * c[i], non_temporal);
+    store_fence(non_temporal);
+}
+
+/* Sattolo's algorithm: a random permutation that is a single cycle */
+static void build_chase(struct mem_chase_line *lines, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+        lines[i].next = i;
+    for (size_t i = count - 1; i > 0; --i) {
+        size_t j = random64() % i;
+        size_t tmp = lines[i].next;
+        lines[i].next = lines[j].next;
+        lines[j].next = tmp;
+    }
+}
+
+static void run_chase(const struct mem_chase_line *lines, size_t count,
+                      struct mem_chase_state *state, size_t steps)
+{
+    /* a full cycle visits every line once and ends where it started */
+    size_t idx = state->idx;
+    uint64_t index_sum = state->index_sum;
+    size_t step = state->step;
+    for ( ; steps; --steps) {
+        idx = lines[idx].next;
+        if (__builtin_expect(idx >= count, false))
+            report_fail_msg("Pointer chase went out of bounds at step %zu: index %#zx, line count %#zx",
+                            step, idx, count);
+        index_sum += idx;
+        if (++step < count)
+            continue;
+
+        if (idx != 0 || index_sum != (uint64_t)count * (count - 1) / 2)
+            report_fail_msg("Pointer chase did not visit every line once: ended at %#zx, "
+                            "index sum %#" PRIx64 ", expected %#" PRIx64,
+                            idx, index_sum, (uint64_t)count * (count - 1) / 2);
+        index_sum = 0;
+        step = 0;
+    }
+    state->idx = idx;
+    state->index_sum = index_sum;
+    state->step = step;
+}
+
+static int array_count(enum mem_kernel kernel)
+{
+    switch (kernel) {
+    case MEM_READ:
+    case MEM_WRITE:
+    case MEM_LATENCY:
+        return 1;
+    case MEM_COPY:
+        return 2;
+    case MEM_TRIAD:
+        return 3;
+    }
+    __builtin_unreachable();
+}
+
+static size_t default_buffer_size(enum mem_kernel kernel)
+{
+    /* enough that the slice's threads on one socket can't fit in the LLC */
+    int threads_in_package = 0;
+    for (int i = 0; i < num_cpus(); ++i)
+        threads_in_package += cpu_info[i].package_id == cpu_info[0].package_id;
+
+    /* unknown cache sizes are negative */
+    int llc = cpu_info[0].cache[2].cache_data > 0 ? cpu_info[0].cache[2].cache_data : 0;
+    int l2 = cpu_info[0].cache[1].cache_data > 0 ? cpu_info[0].cache[1].cache_data : 0;
+    size_t size = (size_t)llc * LLC_MULTIPLIER / threads_in_package;
+    if (size < (size_t)l2 * L2_MULTIPLIER)
+        size = (size_t)l2 * L2_MULTIPLIER;
+    if (size < MIN_BUFFER_SIZE)
+        size = MIN_BUFFER_SIZE;
+    if (size > MAX_THREAD_MEMORY / array_count(kernel))
+        size = MAX_THREAD_MEMORY / array_count(kernel);
+    return size & ~(size_t)(CACHE_LINE_SIZE - 1);
+}
+
+static int mem_init_common(struct test *test, enum mem_kernel kernel, bool non_temporal)
+{
+    struct mem_test *t = malloc(sizeof(*t));
+    t->kernel = kernel;
+    t->non_temporal = non_temporal;
+    t->buffer_size = get_testspecific_knob_value_uint(test, "buffer_size", default_buffer_size(kernel));
+    t->buffer_size &= ~(size_t)(CACHE_LINE_SIZE - 1);
+    if (t->buffer_size < CACHE_LINE_SIZE)
+        t->buffer_size = CACHE_LINE_SIZE;
+    t->results = calloc(num_cpus(), sizeof(struct mem_thread_result));
+    test->data = t;
+    return EXIT_SUCCESS;
+}
+
+static int mem_read_init(struct test *test)
+{
+    return mem_init_common(test, MEM_READ, false);
+}
+
+static int mem_write_init(struct test *test)
+{
+    return mem_init_common(test, MEM_WRITE, false);
+}
+
+static int mem_write_nt_init(struct test *test)
+{
+    return mem_init_common(test, MEM_WRITE, true);
+}
+
+static int mem_copy_init(struct test *test)
+{
+    return mem_init_common(test, MEM_COPY, false);
+}
+
+static int mem_copy_nt_init(struct test *test)
+{
+    return mem_init_common(test, MEM_COPY, true);
+}
+
+static int mem_triad_init(struct test *test)
+{
+    return mem_init_common(test, MEM_TRIAD, false);
+}
+
+static int mem_triad_nt_init(struct test *test)
+{
+    return mem_init_common(test, MEM_TRIAD, true);
+}
+
+static int mem_latency_init(struct test *test)
+{
+    return mem_init_common(test, MEM_LATENCY, false);
+}
+
+static int mem_latency_run(struct test *test, int cpu)
+{
+    struct mem_test *t = test->data;
+    struct mem_thread_result *result = &t->results[cpu];
+    size_t count = t->buffer_size / sizeof(struct mem_chase_line);
+    struct mem_chase_state state = {};
+    struct mem_chase_line *lines = aligned_alloc(CACHE_LINE_SIZE, count * sizeof(*lines));
+    if (!lines)
+        return -ENOMEM;
+    build_chase(lines, count);
+
+    TEST_LOOP(test, 1) {
+        uint64_t start = now_ns();
+        run_chase(lines, count, &state, CHASE_STEPS_PER_LOOP);
+        result->elapsed_ns += now_ns() - start;
+        result->bytes += CHASE_STEPS_PER_LOOP;
+    }
+
+    free(lines);
+    return EXIT_SUCCESS;
+}
+
+static int mem_bandwidth_run(struct test *test, int cpu)
+{
+    struct mem_test *t = test->data;
+    struct mem_thread_result *result = &t->results[cpu];
+    size_t count = t->buffer_size / sizeof(uint64_t);
+
+    /* allocated and touched here, so they're local to this thread; reads
+     * only use b, writes only a, copies a and b and triads all three */
+    bool need_a = t->kernel != MEM_READ;
+    bool need_b = t->kernel != MEM_WRITE;
+    bool need_c = t->kernel == MEM_TRIAD;
+    uint64_t *a = need_a ? aligned_alloc(CACHE_LINE_SIZE, t->buffer_size) : NULL;
+    uint64_t *b = need_b ? aligned_alloc(CACHE_LINE_SIZE, t->buffer_size) : NULL;
+    uint64_t *c = need_c ? aligned_alloc(CACHE_LINE_SIZE, t->buffer_size) : NULL;
+    if ((need_a && !a) || (need_b && !b) || (need_c && !c)) {
+        free(c);
+        free(b);
+        free(a);
+        return -ENOMEM;
+    }
+    if (a)
+        memset(a, 0, t->buffer_size);
+
+    TEST_LOOP(test, 1) {
+        uint64_t seed = random64();
+        uint64_t start, elapsed = 0;
+        size_t bytes = 0;
+
+        switch (t->kernel) {
+        case MEM_READ: {
+            fill_pattern(b, count, seed, false);
+            uint64_t expected = 0;
+            for (size_t i = 0; i < count; ++i)
+                expected = ((expected << 1) | (expected >> 63)) ^ pattern(seed, i);
+
+            start = now_ns();
+            uint64_t sum = run_read(b, count);
+            elapsed = now_ns() - start;
+            bytes = t->buffer_size;
+            if (sum != expected) {
+                verify_pattern("Read buffer", b, count, seed);
+                report_fail_msg("Read checksum mismatch: expected %#018" PRIx64 ", got %#018" PRIx64,
+                                expected, sum);
+            }
+            break;
+        }
+
+        case MEM_WRITE:
+            start = now_ns();
+            fill_pattern(a, count, seed, t->non_temporal);
+            elapsed = now_ns() - start;
+            bytes = t->buffer_size;
+            verify_pattern("Written buffer", a, count, seed);
+            break;
+
+        case MEM_COPY:
+            fill_pattern(b, count, seed, false);
+            start = now_ns();
+            run_copy(a, b, count, t->non_temporal);
+            elapsed = now_ns() - start;
+            bytes = 2 * t->buffer_size;
+            verify_pattern("Copy destination", a, count, seed);
+            verify_pattern("Copy source", b, count, seed);
+            break;
+
+        case MEM_TRIAD:
+            fill_pattern(b, count, seed, false);
+            fill_pattern(c, count, ~seed, false);
+            start = now_ns();
+            run_triad(a, b, c, count, t->non_temporal);
+            elapsed = now_ns() - start;
+            bytes = 3 * t->buffer_size;
+            for (size_t i = 0; i < count; ++i) {
+                uint64_t expected = pattern(seed, i) + TRIAD_SCALAR * pattern(~seed, i);
+                if (__builtin_expect(a[i] != expected, false))
+                    report_mismatch("Triad result", a, i, expected);
+            }
+            break;
+
+        case MEM_LATENCY:
+            __builtin_unreachable();
+        }
+
+        result->elapsed_ns += elapsed;
+        result->bytes += bytes;
+    }
+
+    free(c);
+    free(b);
+    free(a);
+    return EXIT_SUCCESS;
+}
+
+static int mem_cleanup(struct test *test)
+{
+    struct mem_test *t = test->data;
+    if (!t)
+        return EXIT_SUCCESS;
+
+    /* the threads ran concurrently, so their rates add up */
+    double slice_total = 0;
+    int slice_threads = 0;
+    for (int first = 0; first < num_cpus(); ++first) {
+        int package = cpu_info[first].package_id;
+        bool seen = false;
+        for (int i = 0; i < first && !seen; ++i)
+            seen = cpu_info[i].package_id == package;
+        if (seen)
+            continue;
+
+        double total = 0;
+        int threads = 0;
+        for (int i = first; i < num_cpus(); ++i) {
+            if (cpu_info[i].package_id != package || t->results[i].elapsed_ns == 0)
+                continue;
+            if (t->kernel == MEM_LATENCY)
+                total += (double)t->results[i].elapsed_ns / t->results[i].bytes;
+            else
+                total += (double)t->results[i].bytes / t->results[i].elapsed_ns;
+            ++threads;
+        }
+        if (threads == 0)
+            continue;
+
+        if (t->kernel == MEM_LATENCY)
+            log_info("Socket %d: %.1f ns average load latency (%d threads)", package,
+                     total / threads, threads);
+        else
+            log_info("Socket %d: %.2f GB/s (%d threads)", package, total, threads);
+        slice_total += total;
+        slice_threads += threads;
+    }
+
+    if (slice_threads) {
+        if (t->kernel == MEM_LATENCY)
+            log_info("Slice: %.1f ns average load latency, %zu-byte buffer per thread",
+                     slice_total / slice_threads, t->buffer_size);
+        else
+            log_info("Slice: %.2f GB/s, %zu-byte buffers per thread", slice_total, t->buffer_size);
+    }
+
+    free(t->results);
+    free(t);
+    return EXIT_SUCCESS;
+}
+
+DECLARE_TEST(mem_bandwidth_read, "Memory bandwidth test - streaming reads with checksum")
+        .groups = DECLARE_TEST_GROUPS(&group_memory),
+        .quality_level = TEST_QUALITY_BETA,
+        .test_init = mem_read_init,
+        .test_run = mem_bandwidth_run,
+        .test_cleanup = mem_cleanup,
+        .desired_duration = 2000,
+        .fracture_loop_count = -1,
+END_DECLARE_TEST
+
+DECLARE_TEST(mem_bandwidth_write, "Memory bandwidth test - streaming writes")
+        .groups = DECLARE_TEST_GROUPS(&group_memory),
+        .quality_level = TEST_QUALITY_BETA,
+        .test_init = mem_write_init,
+        .test_run = mem_bandwidth_run,
+        .test_cleanup = mem_cleanup,
+        .desired_duration = 2000,
+        .fracture_loop_count = -1,
+END_DECLARE_TEST
+
+DECLARE_TEST(mem_bandwidth_write_nt, "Memory bandwidth test - streaming non-temporal writes")
+        .groups = DECLARE_TEST_GROUPS(&group_memory),
+        .quality_level = TEST_QUALITY_BETA,
+        .test_init = mem_write_nt_init,
+        .test_run = mem_bandwidth_run,
+        .test_cleanup = mem_cleanup,
+        .desired_duration = 2000,
+        .fracture_loop_count = -1,
+END_DECLARE_TEST
+
+DECLARE_TEST(mem_bandwidth_copy, "Memory bandwidth test - copy")
+        .groups = DECLARE_TEST_GROUPS(&group_memory),
+        .quality_level = TEST_QUALITY_BETA,
+        .test_init = mem_copy_init,
+        .test_run = mem_bandwidth_run,
+        .test_cleanup = mem_cleanup,
+        .desired_duration = 2000,
+        .fracture_loop_count = -1,
+END_DECLARE_TEST
+
+DECLARE_TEST(mem_bandwidth_copy_nt, "Memory bandwidth test - copy with non-temporal stores")
+        .groups = DECLARE_TEST_GROUPS(&group_memory),
+        .quality_level = TEST_QUALITY_BETA,
+        .test_init = mem_copy_nt_init,
+        .test_run = mem_bandwidth_run,
+        .test_cleanup = mem_cleanup,
+        .desired_duration = 2000,
+        .fracture_loop_count = -1,
+END_DECLARE_TEST
+
+DECLARE_TEST(mem_bandwidth_triad, "Memory bandwidth test - triad")
+        .groups = DECLARE_TEST_GROUPS(&group_memory),
+        .quality_level = TEST_QUALITY_BETA,
+        .test_init = mem_triad_init,
+        .test_run = mem_bandwidth_run,
+        .test_cleanup = mem_cleanup,
+        .desired_duration = 2000,
+        .fracture_loop_count = -1,
+END_DECLARE_TEST
+
+DECLARE_TEST(mem_bandwidth_triad_nt, "Memory bandwidth test - triad with non-temporal stores")
+        .groups = DECLARE_TEST_GROUPS(&group_memory),
+        .quality_level = TEST_QUALITY_BETA,
+        .test_init = mem_triad_nt_init,
+        .test_run = mem_bandwidth_run,
+        .test_cleanup = mem_cleanup,
+        .desired_duration = 2000,
+        .fracture_loop_count = -1,
+END_DECLARE_TEST
+
+DECLARE_TEST(mem_latency, "Memory latency test - dependent loads over a random chain of cache lines")
+        .groups = DECLARE_TEST_GROUPS(&group_memory),
+        .quality_level = TEST_QUALITY_BETA,
+        .test_init = mem_latency_init,
+        .test_run = mem_latency_run,
+        .test_cleanup = mem_cleanup,
+        .desired_duration = 2000,
+        .fracture_loop_count = -1,
+END_DECLARE_TEST
@@ -0,0 +1,283 @@
+/**
+ *
+ * @copyright
+ * Copyright 2024 Intel Corporation.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * @test openssl_aes_gcm
+ * @test openssl_chacha20_poly1305
+ *
+ * These tests encrypt random-generated buffers of several sizes (64 bytes
+ * to 64 kB) with an authenticated cipher, AES-256-GCM or
+ * ChaCha20-Poly1305, and compare the ciphertext and the authentication
+ * tag against golden values calculated in test_init. The ciphertext is
+ * then decrypted and the tag verified, and the result must match the
+ * original plaintext.
+ *
+ * The cipher is fetched once in test_init and each thread reuses one
+ * encryption and one decryption context for the whole run, only changing
+ * the key and IV for each message. Each thread logs the encryption
+ * throughput at each buffer size.
+ *
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+#include <chrono>
+#include <string>
+
+#include "sandstone.h"
+#include "sandstone_ssl.h"
+
+#define AEAD_GOLDEN_ELEMS           (16UL)
+#define AEAD_MAX_OFFSET             (512UL)
+#define AEAD_KEY_SIZE               (32)
+#define AEAD_IV_SIZE                (12)
+#define AEAD_AAD_SIZE               (16)
+#define AEAD_TAG_SIZE               (16)
+
+static constexpr size_t plaintext_sizes[] = { 64, 512, 4096, 65536 };
+static constexpr int plaintext_size_count = sizeof(plaintext_sizes) / sizeof(plaintext_sizes[0]);
+static constexpr size_t max_plaintext_size = plaintext_sizes[plaintext_size_count - 1];
+
+struct aead_elem
+{
+    uint8_t key[AEAD_KEY_SIZE];
+    uint8_t iv[AEAD_IV_SIZE];
+    uint8_t aad[AEAD_AAD_SIZE];
+    uint8_t tag[AEAD_TAG_SIZE];
+    uint8_t *plain_text;
+    uint8_t *cipher_text;
+};
+
+struct aead_test
+{
+    const char *cipher_name;
+    EVP_CIPHER *cipher;
+    uint8_t *arena;
+    size_t arena_size;
+    aead_elem golden_elements[plaintext_size_count][AEAD_GOLDEN_ELEMS];
+};
+
+struct aead_stats
+{
+    uint64_t bytes = 0;
+    std::chrono::nanoseconds elapsed = {};
+};
+
+static bool aead_encrypt(EVP_CIPHER_CTX *ctx, const aead_elem *elem, const uint8_t *in, size_t size,
+                         uint8_t *out, uint8_t *tag)
+{
+    int len;
+    if (s_EVP_EncryptInit_ex(ctx, NULL, NULL, elem->key, elem->iv) != 1)
+        return false;
+    if (s_EVP_EncryptUpdate(ctx, NULL, &len, elem->aad, AEAD_AAD_SIZE) != 1)
+        return false;
+    if (s_EVP_EncryptUpdate(ctx, out, &len, in, size) != 1)
+        return false;
+    if (s_EVP_EncryptFinal_ex(ctx, out + len, &len) != 1)
+        return false;
+    return s_EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_GET_TAG, AEAD_TAG_SIZE, tag) == 1;
+}
+
+static bool aead_decrypt(EVP_CIPHER_CTX *ctx, const aead_elem *elem, const uint8_t *in, size_t size,
+                         uint8_t *out)
+{
+    int len;
+    if (s_EVP_DecryptInit_ex(ctx, NULL, NULL, elem->key, elem->iv) != 1)
+        return false;
+    if (s_EVP_DecryptUpdate(ctx, NULL, &len, elem->aad, AEAD_AAD_SIZE) != 1)
+        return false;
+    if (s_EVP_DecryptUpdate(ctx, out, &len, in, size) != 1)
+        return false;
+    if (s_EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_TAG, AEAD_TAG_SIZE, const_cast<uint8_t *>(elem->tag)) != 1)
+        return false;
+
+    /* Fails if the tag doesn't authenticate the ciphertext */
+    return s_EVP_DecryptFinal_ex(ctx, out + len, &len) == 1;
+}
+
+static EVP_CIPHER_CTX *aead_new_context(const EVP_CIPHER *cipher, bool encrypt)
+{
+    EVP_CIPHER_CTX *ctx = s_EVP_CIPHER_CTX_new();
+    int ret = encrypt ? s_EVP_EncryptInit_ex(ctx, cipher, NULL, NULL, NULL) :
+                        s_EVP_DecryptInit_ex(ctx, cipher, NULL, NULL, NULL);
+    if (ret != 1 || s_EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_IVLEN, AEAD_IV_SIZE, NULL) != 1) {
+        s_EVP_CIPHER_CTX_free(ctx);
+        return NULL;
+    }
+    return ctx;
+}
+
+static int aead_cleanup(struct test *test)
+{
+    aead_test *t = (aead_test *) test->data;
+    if (t) {
+        s_EVP_CIPHER_free(t->cipher);
+        if (t->arena)
+            munmap(t->arena, t->arena_size);
+        delete t;
+    }
+    return EXIT_SUCCESS;
+}
+
+static int aead_init(struct test *test, const char *cipher_name)
+{
+    if (!(s_EVP_CIPHER_fetch && s_EVP_CIPHER_free && s_EVP_CIPHER_CTX_new && s_EVP_CIPHER_CTX_free
+          && s_EVP_CIPHER_CTX_ctrl && s_EVP_EncryptInit_ex && s_EVP_EncryptUpdate && s_EVP_EncryptFinal_ex
+          && s_EVP_DecryptInit_ex && s_EVP_DecryptUpdate && s_EVP_DecryptFinal_ex)) {
+        log_skip(TestResourceIssueSkipCategory, "OpenSSL library is not available or the current version is not supported");
+        return EXIT_SKIP;
+    }
+
+    aead_test *t = new aead_test();
+    test->data = t;
+    t->cipher_name = cipher_name;
+
+    /* Fetch algorithm */
+    t->cipher = s_EVP_CIPHER_fetch(NULL, cipher_name, NULL);
+    if (!t->cipher) {
+        log_skip(TestResourceIssueSkipCategory, "OpenSSL does not provide %s", cipher_name);
+        aead_cleanup(test);
+        test->data = NULL;
+        return EXIT_SKIP;
+    }
+
+    /* Plaintext and ciphertext for every golden element */
+    for (int s = 0; s < plaintext_size_count; s++)
+        t->arena_size += 2 * AEAD_GOLDEN_ELEMS * plaintext_sizes[s];
+    t->arena = (uint8_t *) mmap(NULL, t->arena_size, PROT_READ|PROT_WRITE, MAP_ANONYMOUS|MAP_PRIVATE, -1, 0);
+    if (t->arena == MAP_FAILED) {
+        log_skip(OSResourceIssueSkipCategory, "could not allocate %zu bytes for the golden values", t->arena_size);
+        t->arena = nullptr;
+        aead_cleanup(test);
+        test->data = NULL;
+        return EXIT_SKIP;
+    }
+
+    EVP_CIPHER_CTX *ctx = aead_new_context(t->cipher, true);
+    uint8_t *cursor = t->arena;
+    for (int s = 0; s < plaintext_size_count; s++) {
+        for (size_t i = 0; i < AEAD_GOLDEN_ELEMS; i++) {
+            aead_elem *elem = &t->golden_elements[s][i];
+            memset_random(elem->key, sizeof(elem->key));
+            memset_random(elem->iv, sizeof(elem->iv));
+            memset_random(elem->aad, sizeof(elem->aad));
+            elem->plain_text = cursor;
+            cursor += plaintext_sizes[s];
+            elem->cipher_text = cursor;
+            cursor += plaintext_sizes[s];
+            memset_random(elem->plain_text, plaintext_sizes[s]);
+
+            if (!ctx || !aead_encrypt(ctx, elem, elem->plain_text, plaintext_sizes[s], elem->cipher_text, elem->tag)) {
+                log_skip(TestResourceIssueSkipCategory, "OpenSSL failed to encrypt with %s", cipher_name);
+                s_EVP_CIPHER_CTX_free(ctx);
+                aead_cleanup(test);
+                test->data = NULL;
+                return EXIT_SKIP;
+            }
+        }
+    }
+    s_EVP_CIPHER_CTX_free(ctx);
+
+    return EXIT_SUCCESS;
+}
+
+static int aead_run(struct test *test, int cpu)
+{
+    aead_test *t = (aead_test *) test->data;
+    aead_stats stats[plaintext_size_count];
+
+    /* Room for a plaintext and a ciphertext, each at a random misalignment */
+    const size_t our_arena_size = 2 * (AEAD_MAX_OFFSET + max_plaintext_size);
+    uint8_t *our_arena = (uint8_t *) mmap(NULL, our_arena_size, PROT_READ|PROT_WRITE, MAP_ANONYMOUS|MAP_PRIVATE, -1, 0);
+    if (our_arena == MAP_FAILED) {
+        log_skip(OSResourceIssueSkipCategory, "could not allocate %zu bytes", our_arena_size);
+        return EXIT_SKIP;
+    }
+    EVP_CIPHER_CTX *enc_ctx = aead_new_context(t->cipher, true);
+    EVP_CIPHER_CTX *dec_ctx = aead_new_context(t->cipher, false);
+    if (!enc_ctx || !dec_ctx)
+        report_fail_msg("Could not create the %s contexts", t->cipher_name);
+    uint8_t tag[AEAD_TAG_SIZE];
+    int s = 0;
+
+    /* one message takes from under a microsecond to tens of microseconds,
+     * depending on its size and the instructions available */
+    TEST_LOOP_AUTO(test, 4, 1 << 11) {
+        const size_t size = plaintext_sizes[s];
+        const size_t golden_idx = random64() & (AEAD_GOLDEN_ELEMS - 1);
+        const aead_elem *golden_elem = &t->golden_elements[s][golden_idx];
+
+        uint8_t *our_plain_text = &our_arena[(random64() & 0x1ff) | 1];
+        uint8_t *our_cipher_text = &our_arena[AEAD_MAX_OFFSET + max_plaintext_size + ((random64() & 0x1ff) | 1)];
+        memcpy(our_plain_text, golden_elem->plain_text, size);
+
+        /* Encrypt and check against golden values */
+        auto start = std::chrono::steady_clock::now();
+        bool ok = aead_encrypt(enc_ctx, golden_elem, our_plain_text, size, our_cipher_text, tag);
+        stats[s].elapsed += std::chrono::steady_clock::now() - start;
+        stats[s].bytes += size;
+        if (!ok)
+            report_fail_msg("%s encryption of %zu bytes failed", t->cipher_name, size);
+        memcmp_or_fail(our_cipher_text, golden_elem->cipher_text, size,
+                       "%s ciphertext does not match for %zu bytes.", t->cipher_name, size);
+        memcmp_or_fail(tag, golden_elem->tag, AEAD_TAG_SIZE,
+                       "%s tag does not match for %zu bytes.", t->cipher_name, size);
+
+        /* Decrypt, authenticating with the golden tag */
+        memset(our_plain_text, 0, size);
+        if (!aead_decrypt(dec_ctx, golden_elem, our_cipher_text, size, our_plain_text))
+            report_fail_msg("%s decryption of %zu bytes failed to authenticate", t->cipher_name, size);
+        memcmp_or_fail(our_plain_text, golden_elem->plain_text, size,
+                       "%s decrypted text does not match for %zu bytes.", t->cipher_name, size);
+
+        if (++s == plaintext_size_count)
+            s = 0;
+    };
+
+    s_EVP_CIPHER_CTX_free(dec_ctx);
+    s_EVP_CIPHER_CTX_free(enc_ctx);
+    munmap(our_arena, our_arena_size);
+
+    std::string msg;
+    for (int s = 0; s < plaintext_size_count; s++) {
+        if (!stats[s].elapsed.count())
+            continue;
+        char buf[64];
+        snprintf(buf, sizeof(buf), "%s%zu B: %.1f MB/s", msg.empty() ? "" : ", ", plaintext_sizes[s],
+                 1000.0 * stats[s].bytes / stats[s].elapsed.count());
+        msg += buf;
+    }
+    if (!msg.empty())
+        log_info("%s encryption: %s", t->cipher_name, msg.c_str());
+    return EXIT_SUCCESS;
+}
+
+static int aes_gcm_init(struct test *test)
+{
+    return aead_init(test, "AES-256-GCM");
+}
+
+static int chacha20_poly1305_init(struct test *test)
+{
+    return aead_init(test, "ChaCha20-Poly1305");
+}
+
+DECLARE_TEST(openssl_aes_gcm, "Test AES-256-GCM authenticated encryption and decryption")
+    .groups = DECLARE_TEST_GROUPS(&group_crypto),
+    .test_init = aes_gcm_init,
+    .test_run = aead_run,
+    .test_cleanup = aead_cleanup,
+    .quality_level = TEST_QUALITY_BETA,
+END_DECLARE_TEST
+
+DECLARE_TEST(openssl_chacha20_poly1305, "Test ChaCha20-Poly1305 authenticated encryption and decryption")
+    .groups = DECLARE_TEST_GROUPS(&group_crypto),
+    .test_init = chacha20_poly1305_init,
+    .test_run = aead_run,
+    .test_cleanup = aead_cleanup,
+    .quality_level = TEST_QUALITY_BETA,
+END_DECLARE_TEST
@@ -6,9 +6,14 @@
  *
  * @test ssl_sha
  *
- * The test calculates 3 different checksums (sha256, sha384 and sha512) for a
- * given random-generated buffer and compares the results against
- * pre-calculated golden values.
+ * The test calculates 3 different checksums (sha256, sha384 and sha512) for
+ * random-generated buffers of several sizes (64 bytes to 64 kB) and compares
+ * the results against pre-calculated golden values.
+ *
+ * The digest algorithms are fetched once in test_init and each thread
+ * reuses a single digest context for the whole run, so the time is spent
+ * hashing and not allocating or looking up algorithms by name. Each thread
+ * logs the throughput of each algorithm at each buffer size.
  *
  */
 
@@ -18,140 +23,179 @@
 #include <stdbool.h>
 #include <sys/mman.h>
 
+#include <chrono>
+#include <string>
+
 #include "sandstone.h"
 #include "sandstone_ssl.h"
 
-#define PLAINTEXT_SIZE              (512UL)
-#define SHA_GOLDEN_ELEMS            (1024UL)
+#define SHA_POOL_SIZE               (256 * 1024UL)
+#define SHA_GOLDEN_ELEMS            (64UL)
 #define SHA_MAX_OFFSET              (512UL)
+#define SHA_ALGORITHMS              (3)
+
+static constexpr size_t plaintext_sizes[] = { 64, 512, 4096, 65536 };
+static constexpr int plaintext_size_count = sizeof(plaintext_sizes) / sizeof(plaintext_sizes[0]);
+static constexpr size_t max_plaintext_size = plaintext_sizes[plaintext_size_count - 1];
+
+static const char *const sha_names[SHA_ALGORITHMS] = { "sha256", "sha384", "sha512" };
 
 struct sha_elem
 {
-    uint8_t plain_text[PLAINTEXT_SIZE];
-    uint8_t sha256sum[SHA256_DIGEST_LENGTH];
-    uint8_t sha384sum[SHA384_DIGEST_LENGTH];
-    uint8_t sha512sum[SHA512_DIGEST_LENGTH];
+    size_t pool_offset;
+    uint8_t digest[SHA_ALGORITHMS][EVP_MAX_MD_SIZE];
 };
 
 struct sha_test
 {
-    uint8_t *arena;
-    uint8_t arena_size;
-    sha_elem golden_elements[SHA_GOLDEN_ELEMS];
+    EVP_MD *md[SHA_ALGORITHMS];
+    unsigned int md_len[SHA_ALGORITHMS];
+    uint8_t *pool;
+    sha_elem golden_elements[plaintext_size_count][SHA_GOLDEN_ELEMS];
 };
 
-static void ssl_sha256(sha_elem *target)
+struct sha_stats
 {
-    /* Create Context */
-    EVP_MD_CTX *mdctx = s_EVP_MD_CTX_new();
-
-    /* Fetch algorithm */
-    const EVP_MD *md = s_EVP_get_digestbyname("sha256");
-
-    /* Digest */
-    unsigned int md_len = 0;
-    s_EVP_DigestInit_ex(mdctx, md, NULL);
-    s_EVP_DigestUpdate(mdctx, &target->plain_text[0], PLAINTEXT_SIZE);
-    s_EVP_DigestFinal_ex(mdctx, &target->sha256sum[0], &md_len);
-}
+    uint64_t bytes = 0;
+    std::chrono::nanoseconds elapsed = {};
+};
 
-static void ssl_sha384(sha_elem *target)
+static void ssl_sha(EVP_MD_CTX *mdctx, const EVP_MD *md, const uint8_t *plain_text, size_t size, uint8_t *digest)
 {
-    /* Create Context */
-    EVP_MD_CTX *mdctx = s_EVP_MD_CTX_new();
-
-    /* Fetch algorithm */
-    const EVP_MD *md = s_EVP_get_digestbyname("sha384");
-
-    /* Digest */
+    /* Reinitializing with the same algorithm reuses the context's state */
     unsigned int md_len = 0;
     s_EVP_DigestInit_ex(mdctx, md, NULL);
-    s_EVP_DigestUpdate(mdctx, &target->plain_text[0], PLAINTEXT_SIZE);
-    s_EVP_DigestFinal_ex(mdctx, &target->sha384sum[0], &md_len);
+    s_EVP_DigestUpdate(mdctx, plain_text, size);
+    s_EVP_DigestFinal_ex(mdctx, digest, &md_len);
 }
 
-static void ssl_sha512(sha_elem *target)
+static int ssl_sha_cleanup(struct test *test)
 {
-    /* Create Context */
-    EVP_MD_CTX *mdctx = s_EVP_MD_CTX_new();
-
-    /* Fetch algorithm */
-    const EVP_MD *md = s_EVP_get_digestbyname("sha512");
-
-    /* Digest */
-    unsigned int md_len = 0;
-    s_EVP_DigestInit_ex(mdctx, md, NULL);
-    s_EVP_DigestUpdate(mdctx, &target->plain_text[0], PLAINTEXT_SIZE);
-    s_EVP_DigestFinal_ex(mdctx, &target->sha512sum[0], &md_len);
+    sha_test *sha_test_ptr = (sha_test *) test->data;
+    if (sha_test_ptr) {
+        for (int i = 0; i < SHA_ALGORITHMS; i++)
+            s_EVP_MD_free(sha_test_ptr->md[i]);
+        if (sha_test_ptr->pool)
+            munmap(sha_test_ptr->pool, SHA_POOL_SIZE);
+        delete sha_test_ptr;
+    }
+    return EXIT_SUCCESS;
 }
 
 static int ssl_sha_init(struct test* test)
 {
-    if (s_EVP_DigestInit_ex && s_EVP_DigestUpdate && s_EVP_DigestFinal_ex && s_EVP_get_digestbyname) {
-        const size_t sha_offset = (random64() & 0x1ff) | 1;
-        const size_t sha_arena_size = sha_offset + sizeof(sha_test);
-        uint8_t *sha_arena = (uint8_t *) mmap(NULL, sha_arena_size, PROT_READ|PROT_WRITE, MAP_ANONYMOUS|MAP_PRIVATE, -1, 0);
-
-        sha_test *sha_test_ptr = (sha_test *)(&sha_arena[sha_offset]);
-        test->data = sha_test_ptr;
-
-        sha_test_ptr->arena = sha_arena;
-        sha_test_ptr->arena_size = sha_arena_size;
-
-        for (size_t i=0; i<SHA_GOLDEN_ELEMS; i++)
-        {
-            sha_elem *cursor = &sha_test_ptr->golden_elements[i];
-            memset_random(&cursor->plain_text[0], PLAINTEXT_SIZE);
-
-            /* Calculate sha checksums */
-            ssl_sha256(cursor);
-            ssl_sha384(cursor);
-            ssl_sha512(cursor);
-        }
+    if (!(s_EVP_DigestInit_ex && s_EVP_DigestUpdate && s_EVP_DigestFinal_ex && s_EVP_MD_fetch && s_EVP_MD_free
+          && s_EVP_MD_size && s_EVP_MD_CTX_new && s_EVP_MD_CTX_free)) {
+        log_skip(TestResourceIssueSkipCategory, "OpenSSL library is not available or the current version is not supported");
+        return EXIT_SKIP;
+    }
 
-        return EXIT_SUCCESS;
+    sha_test *sha_test_ptr = new sha_test();
+    test->data = sha_test_ptr;
+
+    /* Fetch algorithms */
+    for (int i = 0; i < SHA_ALGORITHMS; i++) {
+        sha_test_ptr->md[i] = s_EVP_MD_fetch(NULL, sha_names[i], NULL);
+        if (!sha_test_ptr->md[i]) {
+            log_skip(TestResourceIssueSkipCategory, "OpenSSL does not provide %s", sha_names[i]);
+            ssl_sha_cleanup(test);
+            test->data = NULL;
+            return EXIT_SKIP;
+        }
+        sha_test_ptr->md_len[i] = s_EVP_MD_size(sha_test_ptr->md[i]);
     }
-    else {
-        log_skip(TestResourceIssueSkipCategory, "OpenSSL library is not available or the current version is not supported");
+
+    sha_test_ptr->pool = (uint8_t *) mmap(NULL, SHA_POOL_SIZE, PROT_READ|PROT_WRITE, MAP_ANONYMOUS|MAP_PRIVATE, -1, 0);
+    if (sha_test_ptr->pool == MAP_FAILED) {
+        log_skip(OSResourceIssueSkipCategory, "could not allocate %zu bytes for the pool", SHA_POOL_SIZE);
+        sha_test_ptr->pool = nullptr;
+        ssl_sha_cleanup(test);
+        test->data = NULL;
         return EXIT_SKIP;
     }
+    memset_random(sha_test_ptr->pool, SHA_POOL_SIZE);
+
+    /* Calculate sha checksums */
+    EVP_MD_CTX *mdctx = s_EVP_MD_CTX_new();
+    for (int s = 0; s < plaintext_size_count; s++) {
+        for (size_t i = 0; i < SHA_GOLDEN_ELEMS; i++) {
+            sha_elem *cursor = &sha_test_ptr->golden_elements[s][i];
+            cursor->pool_offset = random64() % (SHA_POOL_SIZE - plaintext_sizes[s] + 1);
+            for (int a = 0; a < SHA_ALGORITHMS; a++)
+                ssl_sha(mdctx, sha_test_ptr->md[a], sha_test_ptr->pool + cursor->pool_offset,
+                        plaintext_sizes[s], cursor->digest[a]);
+        }
+    }
+    s_EVP_MD_CTX_free(mdctx);
+
+    return EXIT_SUCCESS;
 }
 
 static int ssl_sha_run(struct test* test, int cpu)
 {
     sha_test *sha_test_ptr = (sha_test *) test->data;
-    sha_elem *golden_elements = &sha_test_ptr->golden_elements[0];
+    sha_stats stats[SHA_ALGORITHMS][plaintext_size_count];
 
-    const size_t our_arena_size = SHA_MAX_OFFSET + sizeof(sha_elem);
+    const size_t our_arena_size = SHA_MAX_OFFSET + max_plaintext_size;
     uint8_t *our_arena = (uint8_t *) mmap(NULL, our_arena_size, PROT_READ|PROT_WRITE, MAP_ANONYMOUS|MAP_PRIVATE, -1, 0);
+    if (our_arena == MAP_FAILED) {
+        log_skip(OSResourceIssueSkipCategory, "could not allocate %zu bytes", our_arena_size);
+        return EXIT_SKIP;
+    }
+    EVP_MD_CTX *mdctx = s_EVP_MD_CTX_new();
+    uint8_t digest[EVP_MAX_MD_SIZE];
+    int s = 0;
 
-
-    TEST_LOOP(test, 256) {
+    /* one buffer takes from under a microsecond to tens of microseconds,
+     * depending on its size and the instructions available */
+    TEST_LOOP_AUTO(test, 4, 1 << 11) {
+        const size_t size = plaintext_sizes[s];
         const size_t our_offset = (random64() & 0x1ff) | 1;
         const size_t golden_idx = random64() & (SHA_GOLDEN_ELEMS - 1);
-        sha_elem *golden_elem = &golden_elements[golden_idx];
-
-        sha_elem *our_elem = (sha_elem *) (&our_arena[our_offset]);
-        memcpy(&our_elem->plain_text, &golden_elem->plain_text[0], PLAINTEXT_SIZE);
-
-        /* Calculate sha checksums */
-        ssl_sha256(our_elem);
-        ssl_sha384(our_elem);
-        ssl_sha512(our_elem);
-
-        /* Check result against golden values */
-        memcmp_or_fail(&our_elem->sha256sum[0], &golden_elem->sha256sum[0], SHA256_DIGEST_LENGTH,
-                "sha256sum values does not match.");
-        memcmp_or_fail(&our_elem->sha384sum[0], &golden_elem->sha384sum[0], SHA256_DIGEST_LENGTH,
-                "sha384sum values does not match.");
-        memcmp_or_fail(&our_elem->sha512sum[0], &golden_elem->sha512sum[0], SHA256_DIGEST_LENGTH,
-                "sha512sum values does not match.");
+        sha_elem *golden_elem = &sha_test_ptr->golden_elements[s][golden_idx];
+
+        uint8_t *our_plain_text = &our_arena[our_offset];
+        memcpy(our_plain_text, sha_test_ptr->pool + golden_elem->pool_offset, size);
+
+        for (int a = 0; a < SHA_ALGORITHMS; a++) {
+            /* Calculate sha checksum */
+            auto start = std::chrono::steady_clock::now();
+            ssl_sha(mdctx, sha_test_ptr->md[a], our_plain_text, size, digest);
+            stats[a][s].elapsed += std::chrono::steady_clock::now() - start;
+            stats[a][s].bytes += size;
+
+            /* Check result against golden value */
+            memcmp_or_fail(digest, golden_elem->digest[a], sha_test_ptr->md_len[a],
+                           "%s values do not match for %zu bytes.", sha_names[a], size);
+        }
+
+        if (++s == plaintext_size_count)
+            s = 0;
+    };
+
+    s_EVP_MD_CTX_free(mdctx);
+    munmap(our_arena, our_arena_size);
+
+    for (int a = 0; a < SHA_ALGORITHMS; a++) {
+        std::string msg;
+        for (int s = 0; s < plaintext_size_count; s++) {
+            if (!stats[a][s].elapsed.count())
+                continue;
+            char buf[64];
+            snprintf(buf, sizeof(buf), "%s%zu B: %.1f MB/s", msg.empty() ? "" : ", ", plaintext_sizes[s],
+                     1000.0 * stats[a][s].bytes / stats[a][s].elapsed.count());
+            msg += buf;
+        }
+        if (!msg.empty())
+            log_info("%s: %s", sha_names[a], msg.c_str());
     }
     return EXIT_SUCCESS;
 }
 
 DECLARE_TEST(openssl_sha, "Test calculating differnt sha checksums")
+    .groups = DECLARE_TEST_GROUPS(&group_crypto),
     .test_init = ssl_sha_init,
     .test_run = ssl_sha_run,
+    .test_cleanup = ssl_sha_cleanup,
     .quality_level = TEST_QUALITY_PROD,
 END_DECLARE_TEST
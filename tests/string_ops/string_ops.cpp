@@ -0,0 +1,355 @@
+/**
+ * @file
+ *
+ * @copyright
+ * Copyright 2024 Intel Corporation.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * @test @b string_ops
+ * @parblock
+ * This test copies and fills buffers with the instructions that the
+ * kernel and the C library use for memcpy() and memset():
+ *  - REP MOVSB and REP STOSB, which are microcoded and take the fast paths
+ *    of ERMS and FSRM when the CPU has them
+ *  - loops of unaligned 256-bit AVX2 loads and stores
+ *  - loops of 512-bit AVX-512 loads and stores with masked tails, if the
+ *    CPU supports AVX-512BW
+ *  - non-temporal (MOVNTDQ) streaming stores, followed by SFENCE
+ *
+ * The sizes go from 1 byte to 4 MB in four size classes, and the source and
+ * destination are at random misalignments. The result of every operation
+ * is verified with a CRC-32C checksum, and the bytes just before and after
+ * the destination must be left untouched. Each thread logs the throughput
+ * of each method at each size class.
+ * @endparblock
+ */
+
+#include <sandstone.h>
+#include <sandstone_checksum.h>
+
+#if defined(__x86_64__)
+#include <chrono>
+#include <iterator>
+#include <string>
+
+#include <cpuid.h>
+#include <immintrin.h>
+#include <string.h>
+
+namespace {
+constexpr size_t MaxSize = 4 * 1024 * 1024;
+constexpr size_t MaxOffset = 64;
+constexpr size_t GuardSize = 64;
+constexpr uint8_t GuardByte = 0xa5;
+constexpr size_t PatternSize = 4096;
+
+struct SizeClass
+{
+    const char *name;
+    size_t min;
+    size_t max;
+};
+
+constexpr SizeClass size_classes[] = {
+    { "1-63 B", 1, 63 },
+    { "64 B-4 kB", 64, 4096 },
+    { "4-256 kB", 4096 + 1, 256 * 1024 },
+    { "256 kB-4 MB", 256 * 1024 + 1, MaxSize },
+};
+constexpr int SizeClassCount = std::size(size_classes);
+
+enum Method {
+    RepMovsb,
+    RepStosb,
+    Avx2Copy,
+    Avx2Fill,
+    Avx512Copy,
+    Avx512Fill,
+    NtCopy,
+    NtFill,
+    MethodCount
+};
+
+struct MethodInfo
+{
+    const char *name;
+    bool is_fill;
+    bool needs_avx512;
+};
+
+constexpr MethodInfo methods[MethodCount] = {
+    { "REP MOVSB", false, false },
+    { "REP STOSB", true, false },
+    { "AVX2 copy", false, false },
+    { "AVX2 fill", true, false },
+    { "AVX-512 copy", false, true },
+    { "AVX-512 fill", true, true },
+    { "Non-temporal copy", false, false },
+    { "Non-temporal fill", true, false },
+};
+
+struct Stats
+{
+    uint64_t bytes = 0;
+    std::chrono::nanoseconds elapsed = {};
+};
+
+void rep_movsb(uint8_t *dst, const uint8_t *src, size_t n)
+{
+    asm volatile("rep movsb" : "+D" (dst), "+S" (src), "+c" (n) : : "memory");
+}
+
+void rep_stosb(uint8_t *dst, uint8_t c, size_t n)
+{
+    asm volatile("rep stosb" : "+D" (dst), "+c" (n) : "a" (c) : "memory");
+}
+
+// for n < 32, with overlapping loads and stores like the C library does
+void copy_small(uint8_t *dst, const uint8_t *src, size_t n)
+{
+    if (n >= 16) {
+        __m128i head = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+        __m128i tail = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + n - 16));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst), head);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + n - 16), tail);
+    } else if (n >= 8) {
+        uint64_t head, tail;
+        memcpy(&head, src, 8);
+        memcpy(&tail, src + n - 8, 8);
+        memcpy(dst, &head, 8);
+        memcpy(dst + n - 8, &tail, 8);
+    } else {
+        for (size_t i = 0; i < n; ++i)
+            dst[i] = src[i];
+    }
+}
+
+void avx2_copy(uint8_t *dst, const uint8_t *src, size_t n)
+{
+    if (n < 32)
+        return copy_small(dst, src, n);
+
+    size_t i = 0;
+    for ( ; i + 32 <= n; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), v);
+    }
+    if (i < n) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + n - 32));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + n - 32), v);
+    }
+}
+
+void avx2_fill(uint8_t *dst, uint8_t c, size_t n)
+{
+    if (n < 32) {
+        for (size_t i = 0; i < n; ++i)
+            dst[i] = c;
+        return;
+    }
+
+    __m256i v = _mm256_set1_epi8(c);
+    size_t i = 0;
+    for ( ; i + 32 <= n; i += 32)
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), v);
+    if (i < n)
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + n - 32), v);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+void avx512_copy(uint8_t *dst, const uint8_t *src, size_t n)
+{
+    size_t i = 0;
+    for ( ; i + 64 <= n; i += 64) {
+        __m512i v = _mm512_loadu_si512(src + i);
+        _mm512_storeu_si512(dst + i, v);
+    }
+    if (i < n) {
+        __mmask64 mask = _bzhi_u64(~UINT64_C(0), n - i);
+        __m512i v = _mm512_maskz_loadu_epi8(mask, src + i);
+        _mm512_mask_storeu_epi8(dst + i, mask, v);
+    }
+}
+
+__attribute__((target("avx512f,avx512bw")))
+void avx512_fill(uint8_t *dst, uint8_t c, size_t n)
+{
+    __m512i v = _mm512_set1_epi8(c);
+    size_t i = 0;
+    for ( ; i + 64 <= n; i += 64)
+        _mm512_storeu_si512(dst + i, v);
+    if (i < n)
+        _mm512_mask_storeu_epi8(dst + i, _bzhi_u64(~UINT64_C(0), n - i), v);
+}
+
+// regular stores up to the first 32-byte boundary of dst and after the last
+void nt_copy(uint8_t *dst, const uint8_t *src, size_t n)
+{
+    size_t head = -uintptr_t(dst) & 31;
+    if (n < head + 32)
+        return avx2_copy(dst, src, n);
+
+    avx2_copy(dst, src, head);
+    size_t i = head;
+    for ( ; i + 32 <= n; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+        _mm256_stream_si256(reinterpret_cast<__m256i *>(dst + i), v);
+    }
+    _mm_sfence();
+    avx2_copy(dst + i, src + i, n - i);
+}
+
+void nt_fill(uint8_t *dst, uint8_t c, size_t n)
+{
+    size_t head = -uintptr_t(dst) & 31;
+    if (n < head + 32)
+        return avx2_fill(dst, c, n);
+
+    avx2_fill(dst, c, head);
+    __m256i v = _mm256_set1_epi8(c);
+    size_t i = head;
+    for ( ; i + 32 <= n; i += 32)
+        _mm256_stream_si256(reinterpret_cast<__m256i *>(dst + i), v);
+    _mm_sfence();
+    avx2_fill(dst + i, c, n - i);
+}
+
+void run_method(Method m, uint8_t *dst, const uint8_t *src, uint8_t c, size_t n)
+{
+    switch (m) {
+    case RepMovsb:      return rep_movsb(dst, src, n);
+    case RepStosb:      return rep_stosb(dst, c, n);
+    case Avx2Copy:      return avx2_copy(dst, src, n);
+    case Avx2Fill:      return avx2_fill(dst, c, n);
+    case Avx512Copy:    return avx512_copy(dst, src, n);
+    case Avx512Fill:    return avx512_fill(dst, c, n);
+    case NtCopy:        return nt_copy(dst, src, n);
+    case NtFill:        return nt_fill(dst, c, n);
+    case MethodCount:   break;
+    }
+    __builtin_unreachable();
+}
+
+// the CRC of n bytes of the pattern, repeating the PatternSize block
+uint32_t pattern_crc(const uint8_t *pattern, size_t n)
+{
+    uint32_t crc = 0;
+    for ( ; n > PatternSize; n -= PatternSize)
+        crc = crc32c(crc, pattern, PatternSize);
+    return crc32c(crc, pattern, n);
+}
+
+void verify_guards(const uint8_t *dst, size_t n, const char *method)
+{
+    for (size_t i = 0; i < GuardSize; ++i) {
+        if (dst[-1 - ssize_t(i)] != GuardByte)
+            report_fail_msg("%s of %zu bytes wrote %zu bytes before the start of the destination",
+                            method, n, i + 1);
+        if (dst[n + i] != GuardByte)
+            report_fail_msg("%s of %zu bytes wrote %zu bytes past the end of the destination",
+                            method, n, i);
+    }
+}
+
+bool cpu_has_erms_fsrm(bool *fsrm)
+{
+    unsigned eax, ebx, ecx, edx;
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+        *fsrm = false;
+        return false;
+    }
+    *fsrm = edx & (1U << 4);
+    return ebx & (1U << 9);
+}
+} // unnamed namespace
+
+static int string_ops_init(struct test *test)
+{
+    bool fsrm;
+    bool erms = cpu_has_erms_fsrm(&fsrm);
+    log_info("REP MOVSB/STOSB: ERMS %s, FSRM %s; AVX-512 %s", erms ? "yes" : "no", fsrm ? "yes" : "no",
+             cpu_has_feature(cpu_feature_avx512f | cpu_feature_avx512bw) ? "yes" : "no");
+    return EXIT_SUCCESS;
+}
+
+static int string_ops_run(struct test *test, int cpu)
+{
+    const bool have_avx512 = cpu_has_feature(cpu_feature_avx512f | cpu_feature_avx512bw);
+    Stats stats[MethodCount][SizeClassCount];
+
+    const size_t src_size = MaxOffset + MaxSize;
+    const size_t dst_size = GuardSize + MaxOffset + MaxSize + GuardSize;
+    auto src_buffer = static_cast<uint8_t *>(aligned_alloc_safe(64, src_size));
+    auto dst_buffer = static_cast<uint8_t *>(aligned_alloc_safe(64, dst_size));
+    uint8_t pattern[PatternSize];
+    memset_random(src_buffer, src_size);
+    memset(dst_buffer, GuardByte, dst_size);
+
+    int combo = 0;
+    TEST_LOOP_AUTO(test, 8, 1 << 8) {
+        Method m = Method(combo % MethodCount);
+        const SizeClass &sc = size_classes[combo / MethodCount];
+        int c = combo / MethodCount;
+        if (++combo == MethodCount * SizeClassCount)
+            combo = 0;
+        if (methods[m].needs_avx512 && !have_avx512)
+            return;
+
+        size_t n = sc.min + random64() % (sc.max - sc.min + 1);
+        const uint8_t *src = src_buffer + random32() % MaxOffset;
+        uint8_t *dst = dst_buffer + GuardSize + random32() % MaxOffset;
+        uint8_t fill = random32();
+        memset(dst - GuardSize, GuardByte, GuardSize);
+        memset(dst + n, GuardByte, GuardSize);
+
+        auto start = std::chrono::steady_clock::now();
+        run_method(m, dst, src, fill, n);
+        stats[m][c].elapsed += std::chrono::steady_clock::now() - start;
+        stats[m][c].bytes += n;
+
+        verify_guards(dst, n, methods[m].name);
+        if (methods[m].is_fill) {
+            memset(pattern, fill, sizeof(pattern));
+            if (crc32c(0, dst, n) != pattern_crc(pattern, n)) {
+                for (size_t i = 0; i < n; ++i) {
+                    if (dst[i] != fill)
+                        report_fail_msg("%s of %zu bytes: byte %zu is %#02x, expected %#02x",
+                                        methods[m].name, n, i, dst[i], fill);
+                }
+                report_fail_msg("%s of %zu bytes: checksum mismatch, but the contents match on re-read",
+                                methods[m].name, n);
+            }
+        } else if (crc32c(0, dst, n) != crc32c(0, src, n)) {
+            memcmp_or_fail(dst, src, n, "%s of %zu bytes: contents do not match", methods[m].name, n);
+            report_fail_msg("%s of %zu bytes: checksum mismatch, but the contents match on re-read",
+                            methods[m].name, n);
+        }
+    };
+
+    free(dst_buffer);
+    free(src_buffer);
+
+    for (int m = 0; m < MethodCount; ++m) {
+        std::string msg;
+        for (int c = 0; c < SizeClassCount; ++c) {
+            if (!stats[m][c].elapsed.count())
+                continue;
+            char buf[64];
+            snprintf(buf, sizeof(buf), "%s%s: %.1f MB/s", msg.empty() ? "" : ", ", size_classes[c].name,
+                     1000.0 * stats[m][c].bytes / stats[m][c].elapsed.count());
+            msg += buf;
+        }
+        if (!msg.empty())
+            log_info("%s: %s", methods[m].name, msg.c_str());
+    }
+    return EXIT_SUCCESS;
+}
+
+DECLARE_TEST(string_ops, "REP MOVSB/STOSB, AVX and non-temporal copies and fills of all sizes and alignments")
+    .test_init = string_ops_init,
+    .test_run = string_ops_run,
+    .desired_duration = 1000,
+    .quality_level = TEST_QUALITY_BETA,
+END_DECLARE_TEST
+
+#endif // __x86_64__
@@ -14,6 +14,17 @@
  *
  * @note This test requires at least 2 threads to run.
  * @endparblock
+ *
+ * @test @b zlib_inflate
+ * @parblock
+ * This test only decompresses. A corpus of GZIP streams of 16 to 256 kB is
+ * compressed once in test_init from three kinds of data (random bytes,
+ * random uppercase letters and repetitive phrases) at levels 1, 6 and 9,
+ * and shared read-only by all threads. Each iteration inflates a random
+ * stream from the corpus and verifies the length and CRC-32C of the output
+ * against the values stored when it was compressed. The inflate throughput
+ * of each thread is logged at the end of the run.
+ * @endparblock
  */
 
 #include <assert.h>
@@ -23,11 +34,19 @@
 #include <unistd.h>
 #include <stdint.h>
 
+#include <sys/mman.h>
+#include <time.h>
+
 #include <sandstone.h>
+#include <sandstone_checksum.h>
 
 #include <zlib.h>
 
 #define BUF_MAX (size_t)(1024 * 1024 * 4)
+#define CORPUS_MIN_SIZE (size_t)(16 * 1024)
+#define CORPUS_MAX_SIZE (size_t)(256 * 1024)
+#define CORPUS_PER_KIND 4
+#define VOCABULARY_SIZE 4096
 
 struct zlib_parameters
 {
@@ -189,6 +208,224 @@ static int zlib_aaa_run(struct test *test, int cpu)
     return EXIT_SUCCESS;
 }
 
+enum zlib_data_kind {
+    ZLIB_DATA_RANDOM,
+    ZLIB_DATA_TEXT,
+    ZLIB_DATA_REPETITIVE,
+    ZLIB_DATA_KIND_COUNT
+};
+
+static const int zlib_corpus_levels[] = { 1, 6, 9 };
+#define ZLIB_CORPUS_LEVELS (int)(sizeof(zlib_corpus_levels) / sizeof(zlib_corpus_levels[0]))
+#define ZLIB_CORPUS_ENTRIES (ZLIB_DATA_KIND_COUNT * ZLIB_CORPUS_LEVELS * CORPUS_PER_KIND)
+
+struct zlib_corpus_entry
+{
+    const uint8_t *compressed;
+    size_t compsz;
+    size_t size;
+    uint32_t crc;
+};
+
+struct zlib_corpus
+{
+    uint8_t *arena;
+    size_t arena_size;
+    size_t max_size;
+    struct zlib_corpus_entry entries[ZLIB_CORPUS_ENTRIES];
+};
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void zlib_gen_corpus_data(uint8_t *buf, size_t bufsz, enum zlib_data_kind kind, const uint8_t *vocabulary)
+{
+    size_t i;
+    switch (kind) {
+    case ZLIB_DATA_RANDOM:
+        memset_random(buf, bufsz);
+        break;
+
+    case ZLIB_DATA_TEXT:
+        /* same as zfuzz: random uppercase letters */
+        for (i = 0; i < bufsz; i++)
+            buf[i] = (uint8_t)((random32() % 26) + 'A');
+        break;
+
+    case ZLIB_DATA_REPETITIVE:
+        /* phrases from a small vocabulary, so there are many long matches */
+        for (i = 0; i < bufsz; ) {
+            size_t len = 16 + random32() % 240;
+            size_t from = random32() % (VOCABULARY_SIZE - len);
+            if (len > bufsz - i)
+                len = bufsz - i;
+            memcpy(buf + i, vocabulary + from, len);
+            i += len;
+        }
+        break;
+
+    case ZLIB_DATA_KIND_COUNT:
+        __builtin_unreachable();
+    }
+}
+
+static size_t zlib_deflate_gzip(int level, const uint8_t *in, size_t insz, uint8_t *out, size_t outsz)
+{
+    int status;
+    z_stream strm;
+    memset(&strm, 0, sizeof(strm));
+
+    status = deflateInit2(&strm, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
+    if (status != Z_OK)
+        print_zlib_error("deflateInit2", status);
+
+    strm.next_in = (uint8_t *)in;
+    strm.avail_in = insz;
+    strm.next_out = out;
+    strm.avail_out = outsz;
+    status = deflate(&strm, Z_FINISH);
+    if (status != Z_STREAM_END)
+        print_zlib_error("deflate", status);
+
+    deflateEnd(&strm);
+    return outsz - strm.avail_out;
+}
+
+static int zlib_inflate_cleanup(struct test *test)
+{
+    struct zlib_corpus *corpus = test->data;
+    if (corpus) {
+        if (corpus->arena)
+            munmap(corpus->arena, corpus->arena_size);
+        free(corpus);
+    }
+    return EXIT_SUCCESS;
+}
+
+static int zlib_inflate_init(struct test *test)
+{
+    struct zlib_corpus *corpus = calloc(1, sizeof(*corpus));
+    uint8_t vocabulary[VOCABULARY_SIZE];
+    uint8_t *buf, *cursor;
+    int n = 0;
+
+    if (!corpus) {
+        log_skip(OSResourceIssueSkipCategory, "could not allocate the corpus");
+        return EXIT_SKIP;
+    }
+
+    corpus->max_size = get_testspecific_knob_value_uint(test, "maxbuffersize", CORPUS_MAX_SIZE);
+    if (corpus->max_size <= CORPUS_MIN_SIZE)
+        corpus->max_size = CORPUS_MIN_SIZE + 1;
+
+    /* pick the sizes first, so the arena can be allocated in one go */
+    for (int kind = 0; kind < ZLIB_DATA_KIND_COUNT; kind++) {
+        for (int l = 0; l < ZLIB_CORPUS_LEVELS; l++) {
+            for (int i = 0; i < CORPUS_PER_KIND; i++, n++) {
+                size_t size = CORPUS_MIN_SIZE + random32() % (corpus->max_size - CORPUS_MIN_SIZE);
+                corpus->entries[n].size = size;
+                corpus->arena_size += compressBound(size) + 32;     /* plus the GZIP header and trailer */
+            }
+        }
+    }
+    corpus->arena = mmap(NULL, corpus->arena_size, PROT_READ|PROT_WRITE, MAP_ANONYMOUS|MAP_PRIVATE, -1, 0);
+    if (corpus->arena == MAP_FAILED) {
+        log_skip(OSResourceIssueSkipCategory, "could not allocate %zu bytes for the corpus", corpus->arena_size);
+        free(corpus);
+        return EXIT_SKIP;
+    }
+
+    buf = malloc(corpus->max_size);
+    if (!buf) {
+        log_skip(OSResourceIssueSkipCategory, "could not allocate %zu bytes", corpus->max_size);
+        munmap(corpus->arena, corpus->arena_size);
+        free(corpus);
+        return EXIT_SKIP;
+    }
+
+    memset_random(vocabulary, sizeof(vocabulary));
+    cursor = corpus->arena;
+    n = 0;
+    for (int kind = 0; kind < ZLIB_DATA_KIND_COUNT; kind++) {
+        for (int l = 0; l < ZLIB_CORPUS_LEVELS; l++) {
+            for (int i = 0; i < CORPUS_PER_KIND; i++, n++) {
+                struct zlib_corpus_entry *e = &corpus->entries[n];
+                zlib_gen_corpus_data(buf, e->size, kind, vocabulary);
+                e->crc = crc32c(0, buf, e->size);
+                e->compressed = cursor;
+                e->compsz = zlib_deflate_gzip(zlib_corpus_levels[l], buf, e->size, cursor,
+                                              compressBound(e->size) + 32);
+                cursor += e->compsz;
+            }
+        }
+    }
+    free(buf);
+
+    /* shared read-only from here on */
+    if (mprotect(corpus->arena, corpus->arena_size, PROT_READ) != 0)
+        log_warning("could not make the corpus read-only: %m");
+    test->data = corpus;
+    return EXIT_SUCCESS;
+}
+
+static int zlib_inflate_run(struct test *test, int cpu)
+{
+    const struct zlib_corpus *corpus = test->data;
+    uint8_t *back = malloc(corpus->max_size);
+    uint64_t bytes = 0, elapsed = 0;
+    z_stream strm;
+    int status;
+
+    if (!back) {
+        log_skip(OSResourceIssueSkipCategory, "could not allocate %zu bytes", corpus->max_size);
+        return EXIT_SKIP;
+    }
+
+    memset(&strm, 0, sizeof(strm));
+    status = inflateInit2(&strm, 15 + 16);
+    if (status != Z_OK)
+        print_zlib_error("inflateInit2", status);
+
+    TEST_LOOP(test, 16) {
+        const struct zlib_corpus_entry *e = &corpus->entries[random32() % ZLIB_CORPUS_ENTRIES];
+        size_t backsz;
+        uint32_t crc;
+        uint64_t start;
+
+        status = inflateReset(&strm);
+        if (status != Z_OK)
+            print_zlib_error("inflateReset", status);
+        strm.next_in = (uint8_t *)e->compressed;
+        strm.avail_in = e->compsz;
+        strm.next_out = back;
+        strm.avail_out = corpus->max_size;
+
+        start = now_ns();
+        status = inflate(&strm, Z_FINISH);
+        elapsed += now_ns() - start;
+        if (status != Z_STREAM_END)
+            print_zlib_error("inflate", status);
+
+        backsz = corpus->max_size - strm.avail_out;
+        bytes += backsz;
+        memcmp_or_fail(&backsz, &e->size, 1, "decompressed data length");
+
+        crc = crc32c(0, back, backsz);
+        memcmp_or_fail(&crc, &e->crc, 1, "decompressed data CRC-32C");
+    }
+
+    inflateEnd(&strm);
+    free(back);
+
+    if (elapsed)
+        log_info("inflate: %.1f MB/s", 1000.0 * bytes / elapsed);
+    return EXIT_SUCCESS;
+}
+
 DECLARE_TEST(zlib_aaa, "Zlib compression test (aaa...) - Zlib compression and decompression with highly compressible data")
         .groups = DECLARE_TEST_GROUPS(&group_compression),
         .quality_level = TEST_QUALITY_PROD,
@@ -221,3 +458,13 @@ DECLARE_TEST(zlib9, "Zlib compression test -  Zlib compression and decompression
         .desired_duration = 2000,
         .fracture_loop_count = 3,
 END_DECLARE_TEST
+
+DECLARE_TEST(zlib_inflate, "Zlib decompression test - inflate only, from a corpus of precompressed streams")
+        .groups = DECLARE_TEST_GROUPS(&group_compression),
+        .quality_level = TEST_QUALITY_BETA,
+        .test_init = zlib_inflate_init,
+        .test_run = zlib_inflate_run,
+        .test_cleanup = zlib_inflate_cleanup,
+        .desired_duration = 1000,
+        .fracture_loop_count = 3,
+END_DECLARE_TEST
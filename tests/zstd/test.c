@@ -11,16 +11,49 @@
  * codepaths compared to the other ZStandard tests.
  *
  * @note This test requires at least 2 threads to run.
+ *
+ * @test @b zstd_ctx
+ * Like zstd, but each thread allocates its buffers and its compression
+ * and decompression contexts once and reuses them for every iteration, so
+ * the time is spent compressing and not allocating and zeroing memory.
+ *
+ * @test @b zstd_stream_ldm
+ * Streaming compression and decompression, fed in ZSTD_CStreamInSize()
+ * chunks, with long-distance matching. The window is the largest that lets
+ * each thread stay within its memory budget (8 MB, see the window_log knob)
+ * and the buffer is as large as the window. The data is made of pieces of a
+ * 1 MB random pool repeated at random distances, most of them further apart
+ * than the default window.
+ *
+ * @test @b zstd_mt
+ * Compression of 16 MB buffers using zstd's own worker threads with 1 MB
+ * jobs. The threads of the slice are split in groups of nb_workers + 1
+ * (knob, default 4 workers). The first thread of each group compresses with
+ * a worker for each of the group's other logical processors, while the
+ * group's other threads wait, leaving their logical processors to the
+ * workers. The groups share the buffers of each round, so a group that
+ * finishes early takes over another's. Failures name all the logical
+ * processors of the group.
+ *
+ * The zstd_ctx, zstd_stream_ldm and zstd_mt tests log the compression and
+ * decompression throughput of each thread.
  */
 
+#ifdef __linux__
+#  define _GNU_SOURCE 1
+#  include <sched.h>
+#endif
+
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <stdint.h>
+#include <time.h>
 
 #include <sandstone.h>
+#include <sandstone_slice.h>
 
 #include <zstd.h>
 #include <zstd_errors.h>
@@ -31,6 +64,13 @@
 
 #define BUF_MAX (size_t)(1024 * 1024 * 32)
 #define BUF_MAX_AAA (size_t)(1024 * 1024 * 4)
+#define BUF_MT (size_t)(1024 * 1024 * 16)
+#define POOL_SIZE (size_t)(1024 * 1024)
+#define LDM_WINDOW_LOG_MIN 20
+#define LDM_WINDOW_LOG_MAX 25
+#define LDM_MEMORY_BUDGET (size_t)(1024 * 1024 * 48)   /* per thread */
+#define LDM_WINDOWS_IN_MEMORY 6     /* 3 buffers, the 2 windows and the tables */
+#define MT_JOB_SIZE (1024 * 1024)
 
 struct zstd_parameters
 {
@@ -169,6 +209,379 @@ static int zstd_aaa_run(struct test *test, int cpu)
     return EXIT_SUCCESS;
 }
 
+enum zstd_ctx_mode {
+    ZSTD_MODE_ONESHOT,
+    ZSTD_MODE_STREAM_LDM,
+    ZSTD_MODE_MT,
+};
+
+struct zstd_ctx_parameters
+{
+    enum zstd_ctx_mode mode;
+    int compression;
+    int nb_workers;
+    int window_log;
+    size_t buffersize;
+};
+
+struct zstd_thread_state
+{
+    ZSTD_CCtx *cctx;
+    ZSTD_DCtx *dctx;
+    uint8_t *buf, *comp_buf, *back_buf, *pool;
+    size_t bnd;
+    uint64_t comp_bytes, comp_ns, decomp_ns;
+};
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void zstd_check_param(const char *name, size_t ret)
+{
+    if (ZSTD_isError(ret))
+        zstd_report_fail(name, ret);
+}
+
+/* compressible data: pieces of the random pool, repeated at random distances */
+static void zstd_gen_repetitive(uint8_t *buf, size_t bufsz, const uint8_t *pool)
+{
+    size_t pos = 0;
+    while (pos < bufsz) {
+        size_t len = 4096 + random32() % (64 * 1024 - 4096);
+        size_t from = random32() % (POOL_SIZE - len);
+        if (len > bufsz - pos)
+            len = bufsz - pos;
+        memcpy(buf + pos, pool + from, len);
+        pos += len;
+    }
+}
+
+static size_t zstd_stream_compress(ZSTD_CCtx *cctx, uint8_t *dst, size_t dstcap, const uint8_t *src, size_t srcsz)
+{
+    const size_t in_chunk = ZSTD_CStreamInSize();
+    const size_t out_chunk = ZSTD_CStreamOutSize();
+    ZSTD_inBuffer in = { src, 0, 0 };
+    ZSTD_outBuffer out = { dst, 0, 0 };
+    ZSTD_EndDirective mode;
+    size_t remaining;
+
+    do {
+        if (in.pos == in.size)
+            in.size = in.size + in_chunk < srcsz ? in.size + in_chunk : srcsz;
+        mode = in.size == srcsz ? ZSTD_e_end : ZSTD_e_continue;
+        out.size = out.pos + out_chunk < dstcap ? out.pos + out_chunk : dstcap;
+
+        remaining = ZSTD_compressStream2(cctx, &out, &in, mode);
+        if (ZSTD_isError(remaining))
+            zstd_report_fail("ZSTD_compressStream2", remaining);
+        if (out.pos == dstcap && remaining)
+            report_fail_msg("ZSTD_compressStream2 output exceeded ZSTD_compressBound()");
+    } while (mode != ZSTD_e_end || remaining);
+    return out.pos;
+}
+
+static size_t zstd_stream_decompress(ZSTD_DCtx *dctx, uint8_t *dst, size_t dstcap, const uint8_t *src, size_t srcsz)
+{
+    const size_t in_chunk = ZSTD_DStreamInSize();
+    const size_t out_chunk = ZSTD_DStreamOutSize();
+    ZSTD_inBuffer in = { src, 0, 0 };
+    ZSTD_outBuffer out = { dst, 0, 0 };
+    size_t ret;
+
+    do {
+        size_t old_in = in.pos, old_out = out.pos;
+        if (in.pos == in.size)
+            in.size = in.size + in_chunk < srcsz ? in.size + in_chunk : srcsz;
+        out.size = out.pos + out_chunk < dstcap ? out.pos + out_chunk : dstcap;
+
+        ret = ZSTD_decompressStream(dctx, &out, &in);
+        if (ZSTD_isError(ret))
+            zstd_report_fail("ZSTD_decompressStream", ret);
+        if (ret && in.pos == old_in && out.pos == old_out)
+            report_fail_msg("ZSTD_decompressStream made no progress (truncated or oversized frame)");
+    } while (ret);
+    return out.pos;
+}
+
+/* the logical processors of the slice whose thread drives zstd_mt's workers */
+struct zstd_mt_group
+{
+    int first;
+    int count;
+};
+
+static struct zstd_mt_group zstd_mt_group_of(int nb_workers, int cpu)
+{
+    int size = nb_workers + 1;
+    struct zstd_mt_group group = { .first = cpu - cpu % size, .count = size };
+    if (group.first + group.count > num_cpus())
+        group.count = num_cpus() - group.first;
+    return group;
+}
+
+static void zstd_mt_group_name(char *buf, size_t size, struct zstd_mt_group group)
+{
+    int n = snprintf(buf, size, "%d", cpu_info[group.first].cpu_number);
+    for (int i = group.first + 1; i < group.first + group.count && n > 0 && (size_t)n < size; ++i)
+        n += snprintf(buf + n, size - n, ",%d", cpu_info[i].cpu_number);
+}
+
+#ifdef __linux__
+typedef cpu_set_t zstd_affinity;
+
+/* ZSTD's worker threads inherit the affinity of the thread that creates
+ * them, which is pinned to a single logical processor. Let them run on any
+ * of the group's instead. */
+static void zstd_widen_affinity(zstd_affinity *saved, struct zstd_mt_group group)
+{
+    cpu_set_t cpus;
+    sched_getaffinity(0, sizeof(*saved), saved);
+    CPU_ZERO(&cpus);
+    for (int i = group.first; i < group.first + group.count; ++i) {
+        if (cpu_info[i].cpu_number < CPU_SETSIZE)
+            CPU_SET(cpu_info[i].cpu_number, &cpus);
+    }
+    sched_setaffinity(0, sizeof(cpus), &cpus);
+}
+
+static void zstd_restore_affinity(const zstd_affinity *saved)
+{
+    sched_setaffinity(0, sizeof(*saved), saved);
+}
+#else
+typedef int zstd_affinity;
+static void zstd_widen_affinity(zstd_affinity *saved, struct zstd_mt_group group) { (void)saved; (void)group; }
+static void zstd_restore_affinity(const zstd_affinity *saved) { (void)saved; }
+#endif
+
+static void zstd_ctx_setup(struct zstd_thread_state *st, const struct zstd_ctx_parameters *p)
+{
+    size_t bufsz = p->buffersize + 16;
+
+    st->cctx = ZSTD_createCCtx();
+    st->dctx = ZSTD_createDCtx();
+    if (!st->cctx || !st->dctx)
+        report_fail_msg("could not create ZSTD contexts");
+
+    zstd_check_param("ZSTD_c_compressionLevel", ZSTD_CCtx_setParameter(st->cctx, ZSTD_c_compressionLevel, p->compression));
+    if (p->mode == ZSTD_MODE_STREAM_LDM) {
+        zstd_check_param("ZSTD_c_enableLongDistanceMatching",
+                         ZSTD_CCtx_setParameter(st->cctx, ZSTD_c_enableLongDistanceMatching, 1));
+        zstd_check_param("ZSTD_c_windowLog", ZSTD_CCtx_setParameter(st->cctx, ZSTD_c_windowLog, p->window_log));
+        zstd_check_param("ZSTD_d_windowLogMax", ZSTD_DCtx_setParameter(st->dctx, ZSTD_d_windowLogMax, p->window_log));
+    } else if (p->mode == ZSTD_MODE_MT) {
+        zstd_check_param("ZSTD_c_nbWorkers", ZSTD_CCtx_setParameter(st->cctx, ZSTD_c_nbWorkers, p->nb_workers));
+        zstd_check_param("ZSTD_c_jobSize", ZSTD_CCtx_setParameter(st->cctx, ZSTD_c_jobSize, MT_JOB_SIZE));
+    }
+
+    st->bnd = ZSTD_compressBound(bufsz);
+    st->buf = malloc(bufsz);
+    st->comp_buf = malloc(st->bnd);
+    st->back_buf = malloc(bufsz);
+    if (p->mode != ZSTD_MODE_ONESHOT) {
+        st->pool = malloc(POOL_SIZE);
+        memset_random(st->pool, POOL_SIZE);
+    }
+}
+
+static void zstd_ctx_teardown(struct zstd_thread_state *st)
+{
+    free(st->pool);
+    free(st->back_buf);
+    free(st->comp_buf);
+    free(st->buf);
+    ZSTD_freeDCtx(st->dctx);
+    ZSTD_freeCCtx(st->cctx);
+}
+
+static int zstd_ctx_init_common(struct test *test, enum zstd_ctx_mode mode, size_t buffersize)
+{
+    struct zstd_ctx_parameters *p = malloc(sizeof(*p));
+    p->mode = mode;
+    p->compression = get_testspecific_knob_value_int(test, "level", ZSTD_CLEVEL_DEFAULT);
+    p->nb_workers = 0;
+    p->window_log = 0;
+    if (mode == ZSTD_MODE_STREAM_LDM) {
+        /* the largest window that keeps the thread within its memory budget */
+        int window_log = LDM_WINDOW_LOG_MAX;
+        while (window_log > LDM_WINDOW_LOG_MIN &&
+               ((size_t)LDM_WINDOWS_IN_MEMORY << window_log) > LDM_MEMORY_BUDGET)
+            --window_log;
+        p->window_log = get_testspecific_knob_value_int(test, "window_log", window_log);
+        if (p->window_log < LDM_WINDOW_LOG_MIN)
+            p->window_log = LDM_WINDOW_LOG_MIN;
+        if (p->window_log > LDM_WINDOW_LOG_MAX)
+            p->window_log = LDM_WINDOW_LOG_MAX;
+        buffersize = (size_t)1 << p->window_log;
+    }
+    p->buffersize = get_testspecific_knob_value_uint(test, "maxbuffersize", buffersize);
+    if (p->buffersize < 4096)
+        p->buffersize = 4096;
+
+    if (mode == ZSTD_MODE_MT) {
+        ZSTD_bounds workers = ZSTD_cParam_getBounds(ZSTD_c_nbWorkers);
+        if (ZSTD_isError(workers.error) || workers.upperBound < 1) {
+            free(p);
+            log_skip(TestResourceIssueSkipCategory, "ZStandard library was built without multithreading support");
+            return EXIT_SKIP;
+        }
+        p->nb_workers = get_testspecific_knob_value_int(test, "nb_workers", 4);
+        if (p->nb_workers < 1)
+            p->nb_workers = 1;
+        if (p->nb_workers > workers.upperBound)
+            p->nb_workers = workers.upperBound;
+    }
+
+    test->data = p;
+    return EXIT_SUCCESS;
+}
+
+static int zstd_ctx_init(struct test *test)
+{
+    return zstd_ctx_init_common(test, ZSTD_MODE_ONESHOT, BUF_MAX / 4);
+}
+
+static int zstd_stream_ldm_init(struct test *test)
+{
+    return zstd_ctx_init_common(test, ZSTD_MODE_STREAM_LDM, 0);
+}
+
+static int zstd_mt_init(struct test *test)
+{
+    return zstd_ctx_init_common(test, ZSTD_MODE_MT, BUF_MT);
+}
+
+static int zstd_ctx_cleanup(struct test *test)
+{
+    free(test->data);
+    return EXIT_SUCCESS;
+}
+
+/* one compression and decompression round; where names the logical
+ * processors that did the work, for zstd_mt */
+static void zstd_ctx_round(struct zstd_thread_state *st, const struct zstd_ctx_parameters *p,
+                           const char *where)
+{
+    size_t bufsz, compsz, backsz;
+    uint64_t start;
+
+    if (p->mode == ZSTD_MODE_ONESHOT) {
+        bufsz = (random32() % p->buffersize) + 4096;
+        if (bufsz > p->buffersize)
+            bufsz = p->buffersize;
+        memset_random(st->buf, bufsz);
+    } else {
+        bufsz = p->buffersize;
+        zstd_gen_repetitive(st->buf, bufsz, st->pool);
+    }
+
+    ZSTD_CCtx_reset(st->cctx, ZSTD_reset_session_only);
+    ZSTD_DCtx_reset(st->dctx, ZSTD_reset_session_only);
+
+    start = now_ns();
+    if (p->mode == ZSTD_MODE_STREAM_LDM) {
+        compsz = zstd_stream_compress(st->cctx, st->comp_buf, st->bnd, st->buf, bufsz);
+    } else {
+        compsz = ZSTD_compress2(st->cctx, st->comp_buf, st->bnd, st->buf, bufsz);
+        if (ZSTD_isError(compsz)) {
+            char name[320];
+            snprintf(name, sizeof(name), "ZSTD_compress2%s", where);
+            zstd_report_fail(name, compsz);
+        }
+    }
+    st->comp_ns += now_ns() - start;
+    st->comp_bytes += bufsz;
+
+    start = now_ns();
+    if (p->mode == ZSTD_MODE_STREAM_LDM) {
+        backsz = zstd_stream_decompress(st->dctx, st->back_buf, bufsz, st->comp_buf, compsz);
+    } else {
+        backsz = ZSTD_decompressDCtx(st->dctx, st->back_buf, bufsz, st->comp_buf, compsz);
+        if (ZSTD_isError(backsz))
+            zstd_report_fail("ZSTD_decompressDCtx", backsz);
+    }
+    st->decomp_ns += now_ns() - start;
+
+    memcmp_or_fail(&backsz, &bufsz, 1, "decompressed data length%s", where);
+    memcmp_or_fail(st->back_buf, st->buf, bufsz, "decompressed data%s", where);
+}
+
+static void zstd_ctx_log_throughput(const struct zstd_thread_state *st)
+{
+    if (st->comp_ns && st->decomp_ns)
+        log_info("compression: %.1f MB/s, decompression: %.1f MB/s",
+                 1000.0 * st->comp_bytes / st->comp_ns, 1000.0 * st->comp_bytes / st->decomp_ns);
+}
+
+static int zstd_ctx_run(struct test *test, int cpu)
+{
+    const struct zstd_ctx_parameters *p = test->data;
+    struct zstd_thread_state st = { 0 };
+
+    zstd_ctx_setup(&st, p);
+
+    TEST_LOOP(test, 1) {
+        zstd_ctx_round(&st, p, "");
+    }
+
+    zstd_ctx_log_throughput(&st);
+    zstd_ctx_teardown(&st);
+    return EXIT_SUCCESS;
+}
+
+static int zstd_mt_run(struct test *test, int cpu)
+{
+    const struct zstd_ctx_parameters *p = test->data;
+    struct zstd_mt_group group = zstd_mt_group_of(p->nb_workers, cpu);
+    int group_count = (num_cpus() + p->nb_workers) / (p->nb_workers + 1);
+    bool driver = cpu == group.first;
+    bool workers_started = false;
+    struct zstd_thread_state st = { 0 };
+    char where[256] = "";
+
+    if (driver) {
+        /* a worker for each of the group's other logical processors */
+        struct zstd_ctx_parameters group_p = *p;
+        group_p.nb_workers = group.count > 1 ? group.count - 1 : 1;
+        zstd_ctx_setup(&st, &group_p);
+
+        char cpus[192];
+        zstd_mt_group_name(cpus, sizeof(cpus), group);
+        snprintf(where, sizeof(where), " (%d workers on logical processors %s)", group_p.nb_workers, cpus);
+    }
+
+    do {
+        /* one buffer per group; groups that finish early take over the
+         * others' */
+        uint64_t begin, end;
+        test_slice_work_begin(group_count, 1);
+        while (driver && test_slice_work_next(&begin, &end)) {
+            for ( ; begin < end; ++begin) {
+                zstd_affinity saved;
+                if (!workers_started)
+                    zstd_widen_affinity(&saved, group);
+                zstd_ctx_round(&st, p, where);
+                if (!workers_started) {
+                    zstd_restore_affinity(&saved);
+                    workers_started = true;
+                }
+            }
+        }
+
+        /* the rest of the group sleeps here, leaving the logical processors
+         * to the workers */
+        test_slice_barrier();
+    } while (test_slice_time_condition(test));
+
+    zstd_ctx_log_throughput(&st);
+    zstd_ctx_teardown(&st);
+    return EXIT_SUCCESS;
+}
+
 DECLARE_TEST(zstd_aaa, "ZStandard compression test (aaa...) - ZStandard compression and decompression with highly compressible data")
         .groups = DECLARE_TEST_GROUPS(&group_compression),
         .quality_level = TEST_QUALITY_PROD,
@@ -202,3 +615,30 @@ DECLARE_TEST(zstd19, "ZStandard compression test - ZStandard compression and dec
         .desired_duration = 3000,
 END_DECLARE_TEST
 
+
+DECLARE_TEST(zstd_ctx, "ZStandard compression test - reused contexts and buffers with random data (default level)")
+        .groups = DECLARE_TEST_GROUPS(&group_compression),
+        .quality_level = TEST_QUALITY_BETA,
+        .test_init = zstd_ctx_init,
+        .test_run = zstd_ctx_run,
+        .test_cleanup = zstd_ctx_cleanup,
+        .fracture_loop_count = 3,
+END_DECLARE_TEST
+
+DECLARE_TEST(zstd_stream_ldm, "ZStandard compression test - streaming with long-distance matching and a large window")
+        .groups = DECLARE_TEST_GROUPS(&group_compression),
+        .quality_level = TEST_QUALITY_BETA,
+        .test_init = zstd_stream_ldm_init,
+        .test_run = zstd_ctx_run,
+        .test_cleanup = zstd_ctx_cleanup,
+        .desired_duration = 3000,
+END_DECLARE_TEST
+
+DECLARE_TEST(zstd_mt, "ZStandard compression test - multithreaded compression with zstd worker threads")
+        .groups = DECLARE_TEST_GROUPS(&group_compression),
+        .quality_level = TEST_QUALITY_BETA,
+        .test_init = zstd_mt_init,
+        .test_run = zstd_mt_run,
+        .test_cleanup = zstd_ctx_cleanup,
+        .desired_duration = 3000,
+END_DECLARE_TEST